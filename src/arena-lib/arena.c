@@ -0,0 +1,234 @@
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define DEFAULT_BLOCK_SIZE (64 * 1024)
+
+/* every allocation is aligned for any type */
+#define ALIGNMENT (alignof (max_align_t))
+#define ALIGN_UP(n) (((n) + (ALIGNMENT - 1)) & ~(ALIGNMENT - 1))
+
+
+typedef struct block
+{
+    struct block *next;
+    size_t size;            /* bytes of data */
+    size_t used;            /* bytes of data handed out */
+    alignas (max_align_t) unsigned char data[];
+} block_t;
+
+/* blocks are kept in a list, and filled in order. the ones after current
+ * are empty, left over from before the last reset or release */
+struct arena
+{
+    block_t *first;
+    block_t *current;       /* the block allocations are taken from */
+    size_t block_size;
+
+    size_t in_use;          /* bytes handed out since the last reset */
+    size_t high_water;      /* the most in_use has ever been */
+    size_t reserved;        /* bytes of blocks, malloc'd */
+};
+
+
+static block_t *block_create (size_t size);
+
+
+/* block_size is the size of each block, 0 for the default. allocations
+ * bigger than a block get one of their own */
+arena_t *
+arena_create (size_t block_size)
+{
+    arena_t *arena = calloc (1, sizeof (arena_t));
+    if (arena == NULL) return NULL;
+
+    arena->block_size = ALIGN_UP (block_size ? block_size : DEFAULT_BLOCK_SIZE);
+
+    return arena;
+}
+
+
+void
+arena_destroy (arena_t *arena)
+{
+    block_t *block;
+    block_t *next;
+
+    if (arena == NULL) return;
+
+    for (block = arena->first; block != NULL; block = next)
+    {
+        next = block->next;
+        free (block);
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+
+    free (arena);
+
+    return;
+}
+
+
+/* give back everything allocated, keeping the blocks for what comes next.
+ * the high water mark is kept */
+void
+arena_reset (arena_t *arena)
+{
+    for (block_t *block = arena->first; block != NULL; block = block->next)
+    {
+        block->used = 0;
+    }
+
+    arena->current = arena->first;
+    arena->in_use = 0;
+
+    return;
+}
+
+
+/* size bytes, uninitialized. NULL if out of memory */
+void *
+arena_alloc (arena_t *arena, size_t size)
+{
+    block_t *block = arena->current;
+    void *ptr;
+
+    if (size > SIZE_MAX - ALIGNMENT) return NULL;
+    size = ALIGN_UP (size ? size : 1);
+
+    if ((block == NULL) || (block->size - block->used < size))
+    {
+        block_t *next = (block ? block->next : arena->first);
+
+        /* reuse the next empty block if it is big enough, otherwise put a
+         * new one in front of it */
+        if ((next == NULL) || (next->size < size))
+        {
+            next = block_create (size > arena->block_size ? size : arena->block_size);
+            if (next == NULL) return NULL;
+
+            arena->reserved += next->size;
+            next->next = (block ? block->next : arena->first);
+            if (block) block->next  = next;
+            else       arena->first = next;
+        }
+
+        block = arena->current = next;
+    }
+
+    ptr = block->data + block->used;
+    block->used += size;
+
+    arena->in_use += size;
+    if (arena->in_use > arena->high_water) arena->high_water = arena->in_use;
+
+    return ptr;
+}
+
+
+/* a terminated copy of the first length bytes of text */
+char *
+arena_strndup (arena_t *arena, const char *text, size_t length)
+{
+    char *copy;
+
+    if (length == SIZE_MAX) return NULL;
+
+    copy = arena_alloc (arena, length + 1);
+    if (copy == NULL) return NULL;
+
+    if (length) memcpy (copy, text, length);
+    copy[length] = '\0';
+
+    return copy;
+}
+
+
+/* the current point, arena_release() gives back everything allocated 
+ * after it */
+arena_mark_t
+arena_mark (const arena_t *arena)
+{
+    arena_mark_t mark;
+
+    mark.block  = arena->current;
+    mark.used   = (arena->current ? arena->current->used : 0);
+    mark.in_use = arena->in_use;
+
+    return mark;
+}
+
+
+void
+arena_release (arena_t *arena, arena_mark_t mark)
+{
+    block_t *block = mark.block;
+
+    if (block == NULL)
+    {
+        arena_reset (arena);
+        return;
+    }
+
+    block->used = mark.used;
+    for (block_t *next = block->next; next != NULL; next = next->next)
+    {
+        next->used = 0;
+    }
+
+    arena->current = block;
+    arena->in_use = mark.in_use;
+
+    return;
+}
+
+
+/* bytes handed out and not yet given back */
+size_t
+arena_in_use (const arena_t *arena)
+{
+    return arena->in_use;
+}
+
+
+/* the most bytes that have been in use at once */
+size_t
+arena_high_water (const arena_t *arena)
+{
+    return arena->high_water;
+}
+
+
+/* bytes malloc'd for blocks */
+size_t
+arena_reserved (const arena_t *arena)
+{
+    return arena->reserved;
+}
+
+
+static block_t *
+block_create (size_t size)
+{
+    block_t *block;
+
+    if (size > SIZE_MAX - sizeof (block_t)) return NULL;
+
+    block = malloc (sizeof (block_t) + size);
+    if (block == NULL) return NULL;
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+
+    return block;
+}
+
+
+/* end of file */
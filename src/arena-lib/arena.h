@@ -0,0 +1,48 @@
+#ifndef INVOICE_ARENA_HEADER
+#define INVOICE_ARENA_HEADER
+
+#include <stddef.h>
+
+
+/* bump allocator. memory is handed out of large blocks and given back all
+ * at once, by arena_reset() which keeps the blocks for reuse, or by 
+ * arena_destroy(). nothing allocated from an arena may be passed to 
+ * free(). not thread safe, an arena must only be used by one thread at a
+ * time.
+ *
+ *   arena_t *arena = arena_create (0);
+ *   for (each batch)
+ *   {
+ *       ... arena_alloc (arena, size) ...
+ *       arena_reset (arena);
+ *   }
+ *   arena_destroy (arena);
+ */
+typedef struct arena arena_t;
+
+/* a point to roll back to, see arena_mark() */
+typedef struct
+{
+    void *block;
+    size_t used;
+    size_t in_use;
+} arena_mark_t;
+
+
+arena_t *arena_create (size_t block_size);
+void     arena_destroy (arena_t *arena);
+void     arena_reset (arena_t *arena);
+
+void *arena_alloc (arena_t *arena, size_t size);
+char *arena_strndup (arena_t *arena, const char *text, size_t length);
+
+arena_mark_t arena_mark (const arena_t *arena);
+void         arena_release (arena_t *arena, arena_mark_t mark);
+
+size_t arena_in_use (const arena_t *arena);
+size_t arena_high_water (const arena_t *arena);
+size_t arena_reserved (const arena_t *arena);
+
+
+#endif /* header guard */
+/* end of file */
@@ -0,0 +1,344 @@
+#include "bench-corpus.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/* how often each kind of name comes up, out of 1000 */
+#define WEIGHT_VALID        800
+#define WEIGHT_BAD_DATE      30
+#define WEIGHT_NO_MATCH     140
+/* the rest are pathological */
+
+#define MAX_CUSTOMER 128
+
+
+static const char *S_SYLLABLES[] = {
+    "ac", "me", "zed", "in", "co", "ma", "ry", "bob", "lan", "der",
+    "son", "ex", "port", "tri", "val", "ley", "nor", "th", "wood", "ing",
+    "gra", "ham", "ol", "sen", "ka", "tz", "mil", "ler", "qu", "ay",
+};
+
+static const char *S_DIRECTORIES[] = {
+    "FILES", "ScannedMaterial", "Archive", "Invoices", "Customers",
+    "2019", "2020", "2021", "old", "incoming", "Accounts Payable",
+};
+
+static const char *S_SUFFIXES[] = {
+    ".txt", ".docx", ".png", ".xlsx",
+};
+
+
+static size_t customer_name (bench_rng_t *rng, char *buf, size_t size);
+static void   valid_date (bench_rng_t *rng, int *year, int *month, int *day);
+static void   bad_date (bench_rng_t *rng, int *year, int *month, int *day);
+static size_t dated_name (bench_rng_t *rng, char *buf, size_t size,
+                          int year, int month, int day, const char *suffix);
+static size_t no_match_name (bench_rng_t *rng, char *buf, size_t size);
+static size_t pathological_name (bench_rng_t *rng, char *buf, size_t size);
+static size_t append (char *buf, size_t size, size_t n, const char *text);
+
+
+/* splitmix64 */
+void
+bench_rng_seed (bench_rng_t *rng, uint64_t seed)
+{
+    rng->state = seed;
+
+    return;
+}
+
+
+uint64_t
+bench_rng_next (bench_rng_t *rng)
+{
+    uint64_t z = (rng->state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
+}
+
+
+/* 0 to n-1, n must not be 0 */
+uint32_t
+bench_rng_below (bench_rng_t *rng, uint32_t n)
+{
+    return (uint32_t)(((bench_rng_next (rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+
+/* write one filename into buf, returning what kind it is */
+bench_name_kind_t
+bench_make_name (bench_rng_t *rng, char *buf, size_t size)
+{
+    uint32_t roll = bench_rng_below (rng, 1000);
+    bench_name_kind_t kind = BENCH_NAME_PATHOLOGICAL;
+
+    if      (roll < WEIGHT_VALID)                                     kind = BENCH_NAME_VALID;
+    else if (roll < WEIGHT_VALID + WEIGHT_BAD_DATE)                   kind = BENCH_NAME_BAD_DATE;
+    else if (roll < WEIGHT_VALID + WEIGHT_BAD_DATE + WEIGHT_NO_MATCH) kind = BENCH_NAME_NO_MATCH;
+
+    bench_make_name_kind (rng, buf, size, kind);
+
+    return kind;
+}
+
+
+/* write one filename of the given kind into buf */
+void
+bench_make_name_kind (bench_rng_t *rng, char *buf, size_t size,
+                      bench_name_kind_t kind)
+{
+    int year, month, day;
+
+    switch (kind)
+    {
+    case BENCH_NAME_VALID:
+        valid_date (rng, &year, &month, &day);
+        (void)dated_name (rng, buf, size, year, month, day, ".pdf");
+        break;
+
+    case BENCH_NAME_BAD_DATE:
+        bad_date (rng, &year, &month, &day);
+        (void)dated_name (rng, buf, size, year, month, day, ".pdf");
+        break;
+
+    case BENCH_NAME_NO_MATCH:
+        (void)no_match_name (rng, buf, size);
+        break;
+
+    case BENCH_NAME_PATHOLOGICAL:
+    case BENCH_NAME_KIND_MAX:
+    default:
+        (void)pathological_name (rng, buf, size);
+        break;
+    }
+
+    return;
+}
+
+
+/* a filename under one to three directories */
+bench_name_kind_t
+bench_make_path (bench_rng_t *rng, char *buf, size_t size)
+{
+    uint32_t depth = 1 + bench_rng_below (rng, 3);
+    size_t n = 0;
+
+    n = append (buf, size, n, "/srv");
+    for (uint32_t i = 0; i < depth; i++)
+    {
+        n = append (buf, size, n, "/");
+        n = append (buf, size, n, S_DIRECTORIES[bench_rng_below (rng,
+                                        (uint32_t)(sizeof (S_DIRECTORIES) /
+                                                   sizeof (S_DIRECTORIES[0])))]);
+    }
+    n = append (buf, size, n, "/");
+
+    return bench_make_name (rng, buf + n, size - n);
+}
+
+
+const char *
+bench_name_kind (bench_name_kind_t kind)
+{
+    switch (kind)
+    {
+    case BENCH_NAME_VALID:        return "valid";
+    case BENCH_NAME_BAD_DATE:     return "bad date";
+    case BENCH_NAME_NO_MATCH:     return "no match";
+    case BENCH_NAME_PATHOLOGICAL: return "pathological";
+    case BENCH_NAME_KIND_MAX:
+    default:                      return "unknown";
+    }
+}
+
+
+/* one to four words, rarely up to ten, split by spaces or underscores.
+ * some get leading underscores or trailing spaces, like real scans */
+static size_t
+customer_name (bench_rng_t *rng, char *buf, size_t size)
+{
+    const uint32_t SYLLABLE_COUNT =
+            (uint32_t)(sizeof (S_SYLLABLES) / sizeof (S_SYLLABLES[0]));
+    uint32_t words = 1 + bench_rng_below (rng, 4);
+    size_t n = 0;
+
+    if (bench_rng_below (rng, 20) == 0) words += 6;
+    if (bench_rng_below (rng, 10) == 0) n = append (buf, size, n, "__");
+
+    for (uint32_t i = 0; i < words; i++)
+    {
+        uint32_t syllables = 1 + bench_rng_below (rng, 3);
+
+        if (i > 0) n = append (buf, size, n, (bench_rng_below (rng, 2) ? "_" : " "));
+
+        for (uint32_t j = 0; j < syllables; j++)
+        {
+            size_t start = n;
+            n = append (buf, size, n, S_SYLLABLES[bench_rng_below (rng, SYLLABLE_COUNT)]);
+            if ((j == 0) && (start < n) && (buf[start] >= 'a') && (buf[start] <= 'z'))
+            {
+                buf[start] = (char)(buf[start] - 'a' + 'A');
+            }
+        }
+    }
+
+    if (bench_rng_below (rng, 10) == 0) n = append (buf, size, n, "  ");
+
+    return n;
+}
+
+
+/* a date in the past, so the parser accepts it */
+static void
+valid_date (bench_rng_t *rng, int *year, int *month, int *day)
+{
+    const int DAYS[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    *year  = 1995 + (int)bench_rng_below (rng, 30);
+    *month = 1 + (int)bench_rng_below (rng, 12);
+    *day   = 1 + (int)bench_rng_below (rng, (uint32_t)DAYS[*month - 1]);
+
+    return;
+}
+
+
+static void
+bad_date (bench_rng_t *rng, int *year, int *month, int *day)
+{
+    valid_date (rng, year, month, day);
+
+    switch (bench_rng_below (rng, 3))
+    {
+    case 0:  *month = 13 + (int)bench_rng_below (rng, 7); break;
+    case 1:  *month = 2; *day = 30 + (int)bench_rng_below (rng, 2); break;
+    default: *day = 32 + (int)bench_rng_below (rng, 8); break;
+    }
+
+    return;
+}
+
+
+/* the customer, then the date in one of the layouts seen in the wild */
+static size_t
+dated_name (bench_rng_t *rng, char *buf, size_t size,
+            int year, int month, int day, const char *suffix)
+{
+    char customer[MAX_CUSTOMER];
+    char date[64];
+    unsigned serial = (unsigned)bench_rng_below (rng, 100000);
+    size_t n = 0;
+
+    (void)customer_name (rng, customer, sizeof (customer));
+
+    switch (bench_rng_below (rng, 5))
+    {
+    case 0:  /* Acme_Corp_20200109_257 */
+        (void)snprintf (date, sizeof (date), "_%04d%02d%02d_%u",
+                        year, month, day, serial);
+        break;
+    case 1:  /* Acme_Corp 0401 2010 13301 */
+        (void)snprintf (date, sizeof (date), " %02d%02d %04d %u",
+                        month, day, year, serial);
+        break;
+    case 2:  /* Acme_Corp-2010-0401 */
+        (void)snprintf (date, sizeof (date), "-%04d-%02d%02d",
+                        year, month, day);
+        break;
+    case 3:  /* Acme_Corp 04012010 */
+        (void)snprintf (date, sizeof (date), " %02d%02d%04d",
+                        month, day, year);
+        break;
+    default: /* Acme_Corp_2010_0401 */
+        (void)snprintf (date, sizeof (date), "_%04d_%02d%02d",
+                        year, month, day);
+        break;
+    }
+
+    n = append (buf, size, n, customer);
+    n = append (buf, size, n, date);
+    n = append (buf, size, n, suffix);
+
+    return n;
+}
+
+
+static size_t
+no_match_name (bench_rng_t *rng, char *buf, size_t size)
+{
+    const uint32_t SUFFIX_COUNT =
+            (uint32_t)(sizeof (S_SUFFIXES) / sizeof (S_SUFFIXES[0]));
+    char customer[MAX_CUSTOMER];
+    char year[16];
+    int y, m, d;
+    size_t n = 0;
+
+    switch (bench_rng_below (rng, 3))
+    {
+    case 0:  /* a dated name, but not a pdf */
+        valid_date (rng, &y, &m, &d);
+        return dated_name (rng, buf, size, y, m, d,
+                           S_SUFFIXES[bench_rng_below (rng, SUFFIX_COUNT)]);
+
+    case 1:  /* no digits at all */
+        (void)customer_name (rng, customer, sizeof (customer));
+        n = append (buf, size, n, "Scan of ");
+        n = append (buf, size, n, customer);
+        n = append (buf, size, n, ".pdf");
+        return n;
+
+    default: /* a year, but no month or day */
+        valid_date (rng, &y, &m, &d);
+        (void)customer_name (rng, customer, sizeof (customer));
+        (void)snprintf (year, sizeof (year), " %04d", y);
+        n = append (buf, size, n, customer);
+        n = append (buf, size, n, year);
+        n = append (buf, size, n, ".pdf");
+        return n;
+    }
+}
+
+
+/* ".pdf" too early, then a long run of digits with an almost pdf 
+ * extension. every pair of splits of the digits is a candidate for the
+ * lazy groups, and each is only refused at the end of the name, so a
+ * backtracking matcher takes cubic time to give up */
+static size_t
+pathological_name (bench_rng_t *rng, char *buf, size_t size)
+{
+    uint32_t digits = 20 + bench_rng_below (rng, 40);
+    size_t n = 0;
+
+    n = customer_name (rng, buf, size);
+    n = append (buf, size, n, ".pdf ");
+    for (uint32_t i = 0; (i < digits) && (n + 1 < size); i++)
+    {
+        buf[n++] = (char)('0' + bench_rng_below (rng, 10));
+        buf[n] = '\0';
+    }
+    n = append (buf, size, n, (bench_rng_below (rng, 2) ? ".pd" : ".pdx"));
+
+    return n;
+}
+
+
+/* append text at buf[n], truncating to fit. returns the new length */
+static size_t
+append (char *buf, size_t size, size_t n, const char *text)
+{
+    size_t length = strlen (text);
+
+    if (n >= size) return n;
+    if (length > size - n - 1) length = size - n - 1;
+
+    memcpy (buf + n, text, length);
+    buf[n + length] = '\0';
+
+    return n + length;
+}
+
+
+/* end of file */
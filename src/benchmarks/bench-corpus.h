@@ -0,0 +1,38 @@
+#ifndef INVOICE_BENCH_CORPUS_HEADER
+#define INVOICE_BENCH_CORPUS_HEADER
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/* synthetic invoice filenames for the benchmarks. the same seed always
+ * gives the same names, on every platform. */
+
+typedef struct
+{
+    uint64_t state;
+} bench_rng_t;
+
+typedef enum
+{
+    BENCH_NAME_VALID,           /* matches, with a real date */
+    BENCH_NAME_BAD_DATE,        /* matches, but the date is impossible */
+    BENCH_NAME_NO_MATCH,        /* wrong extension, too few digits, ... */
+    BENCH_NAME_PATHOLOGICAL,    /* long digit runs that never match */
+    BENCH_NAME_KIND_MAX,
+} bench_name_kind_t;
+
+
+void     bench_rng_seed (bench_rng_t *rng, uint64_t seed);
+uint64_t bench_rng_next (bench_rng_t *rng);
+uint32_t bench_rng_below (bench_rng_t *rng, uint32_t n);
+
+bench_name_kind_t bench_make_name (bench_rng_t *rng, char *buf, size_t size);
+void bench_make_name_kind (bench_rng_t *rng, char *buf, size_t size,
+                           bench_name_kind_t kind);
+bench_name_kind_t bench_make_path (bench_rng_t *rng, char *buf, size_t size);
+const char *bench_name_kind (bench_name_kind_t kind);
+
+
+#endif /* header guard */
+/* end of file */
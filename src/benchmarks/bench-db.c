@@ -0,0 +1,748 @@
+#include "bench-corpus.h"
+#include <database-lib/database.h>
+#include <database-lib/sqlite3-wrapper.h>
+#include <errno.h>
+#include <hemlock-argparser-lib/arguement.h>
+#include <logging-lib/logging.h>
+#include <mystring-lib/mystring.h>
+#include <sqlite3.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/* database-lib benchmark. builds a database of each requested size, then
+ * times single calls to the database-lib functions under every journal
+ * mode, reporting ops/s and the p50 and p99 latency of one call.
+ *
+ * warm runs go over the same keys once untimed first. cold runs reopen
+ * the database before every call, so SQLite's page cache starts empty;
+ * on a tmpfs the kernel never has to read the disk either way. writes are
+ * timed in autocommit mode and batched through db_batch_*(), where the
+ * commit is counted against the call that triggered it. full scans
+ * through a cursor are timed as a whole, and reported per row. */
+
+#define MAX_ROW_PATH 512
+
+/* rows per db_cursor_fetch() in the scan */
+#define SCAN_BATCH 256
+
+/* batches are only ever committed by size */
+#define NO_BATCH_LATENCY (60 * 60 * 1000)
+
+typedef enum
+{
+    OP_INSERT,
+    OP_UPDATE,
+    OP_SEARCH_FILE,
+    OP_SEARCH_ID,
+    OP_EXECUTE,
+} op_t;
+
+typedef enum
+{
+    SCAN_NEXT,
+    SCAN_FETCH,
+    SCAN_VIEW,
+} scan_t;
+
+typedef struct
+{
+    sqlite3 *db;
+    sqlite3_stmt *execute_stmt;     /* for OP_EXECUTE */
+    const char *filepath;
+    const char *journal;
+} bench_db_t;
+
+
+static void  parse_arguements (int argc, char **argv);
+static void  help_page (FILE *stream);
+static long  param_to_long (char *param, long min);
+
+static int   bench_size (size_t rows, const char *journal);
+static int   bench_open (bench_db_t *b);
+static void  bench_close (bench_db_t *b);
+static int   build (bench_db_t *b, size_t rows);
+static long long count_rows (sqlite3 *db);
+static char *next_item (char **iter);
+static void  remove_database (const char *filepath);
+
+static int   run_op (bench_db_t *b, op_t op, size_t key);
+static int   time_op (bench_db_t *b, const char *label, op_t op,
+                      const size_t *keys, size_t n, int cold, int batched);
+static int   time_scan (bench_db_t *b, const char *label, scan_t scan);
+static void  make_row (size_t key, char *path, char *customer,
+                       int *year, int *month, int *day);
+static int   compare_u64 (const void *a, const void *b);
+static uint64_t now_ns (void);
+
+
+static long  s_ops = 10000;
+static long  s_cold_ops = 500;
+static long  s_batch = 1000;
+static int   s_keep = 0;
+static unsigned long long s_seed = 1;
+static char *s_rows = "10000";
+static char *s_journals = "delete,wal";
+#if defined(__linux__)
+static char *s_dir = "/dev/shm";
+#else
+static char *s_dir = ".";
+#endif
+
+
+int
+main (int argc, char **argv)
+{
+    int exitcode = EXIT_SUCCESS;
+    char *rows_list = NULL;
+    char *journal_list = NULL;
+    char *rows_iter = NULL;
+    char *rows = NULL;
+
+    logging_init (LOG_ERRORS_ONLY, NULL);
+    parse_arguements (argc, argv);
+
+    rows_list = malloc (strlen (s_rows) + 1);
+    journal_list = malloc (strlen (s_journals) + 1);
+    if ((rows_list == NULL) || (journal_list == NULL))
+    {
+        (void)fprintf (stderr, "error: out of memory\n");
+        exitcode = EXIT_FAILURE;
+        goto main_exit;
+    }
+    (void)strcpy (rows_list, s_rows);
+
+    /* every size, under every journal mode */
+    rows_iter = rows_list;
+    while ((rows = next_item (&rows_iter)) != NULL)
+    {
+        long count = param_to_long (rows, 1);
+        char *journal_iter = journal_list;
+        char *journal = NULL;
+
+        (void)strcpy (journal_list, s_journals);
+        while ((journal = next_item (&journal_iter)) != NULL)
+        {
+            if (bench_size ((size_t)count, journal)) exitcode = EXIT_FAILURE;
+        }
+    }
+
+main_exit:
+    free (rows_list);
+    free (journal_list);
+    logging_quit ();
+
+    exit (exitcode);
+}
+
+
+static int
+bench_size (size_t rows, const char *journal)
+{
+    char filepath[MAX_ROW_PATH];
+    bench_db_t b = { 0 };
+    size_t n = (size_t)s_ops;
+    size_t cold_n = ((size_t)s_cold_ops < n ? (size_t)s_cold_ops : n);
+    size_t *existing = NULL;
+    size_t *fresh = NULL;
+    bench_rng_t rng;
+    int retcode = 1;
+
+    (void)snprintf (filepath, sizeof (filepath), "%s/invoice-bench-%zu.db",
+                    s_dir, rows);
+    b.filepath = filepath;
+    b.journal = journal;
+
+    existing = malloc (n * sizeof (size_t));
+    fresh = malloc (n * sizeof (size_t));
+    if ((existing == NULL) || (fresh == NULL))
+    {
+        (void)fprintf (stderr, "error: out of memory\n");
+        goto bench_size_exit;
+    }
+
+    /* rows are keyed 1 to rows, new rows come after them */
+    bench_rng_seed (&rng, s_seed);
+    for (size_t i = 0; i < n; i++)
+    {
+        existing[i] = 1 + (size_t)(bench_rng_next (&rng) % rows);
+        fresh[i] = rows + 1 + i;
+    }
+
+    if (build (&b, rows)) goto bench_size_exit;
+
+    (void)printf ("%-24s %-5s %-10s %8s %12s %10s %10s\n",
+                  "operation", "cache", "mode", "ops", "ops/s",
+                  "p50 us", "p99 us");
+
+    if (time_op (&b, "db_insert",         OP_INSERT, fresh, n, 0, 0) ||
+        time_op (&b, "db_insert",         OP_INSERT, fresh, n, 0, 1) ||
+        time_op (&b, "db_update_by_file", OP_UPDATE, existing, n, 0, 0) ||
+        time_op (&b, "db_update_by_file", OP_UPDATE, existing, n, 0, 1) ||
+        time_op (&b, "db_search_by_file", OP_SEARCH_FILE, existing, n, 0, 0) ||
+        time_op (&b, "db_search_by_file", OP_SEARCH_FILE, existing, cold_n, 1, 0) ||
+        time_op (&b, "db_search_by_id",   OP_SEARCH_ID, existing, n, 0, 0) ||
+        time_op (&b, "db_search_by_id",   OP_SEARCH_ID, existing, cold_n, 1, 0) ||
+        time_op (&b, "sqlwrap_execute",   OP_EXECUTE, existing, n, 0, 0) ||
+        time_op (&b, "sqlwrap_execute",   OP_EXECUTE, existing, cold_n, 1, 0) ||
+        time_scan (&b, "db_cursor_next",      SCAN_NEXT) ||
+        time_scan (&b, "db_cursor_fetch",     SCAN_FETCH) ||
+        time_scan (&b, "db_cursor_next_view", SCAN_VIEW))
+    {
+        goto bench_size_exit;
+    }
+    (void)printf ("\n");
+
+    retcode = 0;
+
+bench_size_exit:
+    bench_close (&b);
+    if (!s_keep) remove_database (filepath);
+    free (existing);
+    free (fresh);
+
+    return retcode;
+}
+
+
+static int
+bench_open (bench_db_t *b)
+{
+    char pragma[64];
+    const char *EXECUTE_TEXT =
+            "SELECT customer_name FROM invoices WHERE invoice_id = ?1;";
+
+    b->db = db_init (b->filepath, 0);
+    if (b->db == NULL)
+    {
+        (void)fprintf (stderr, "error: cannot open '%s'\n", b->filepath);
+        return 1;
+    }
+
+    (void)snprintf (pragma, sizeof (pragma), "PRAGMA journal_mode = %s;",
+                    b->journal);
+    if (sqlite3_exec (b->db, pragma, NULL, NULL, NULL) != SQLITE_OK)
+    {
+        (void)fprintf (stderr, "error: cannot use journal mode '%s'\n",
+                       b->journal);
+        bench_close (b);
+        return 1;
+    }
+
+    if (sqlite3_prepare_v2 (b->db, EXECUTE_TEXT, -1, &b->execute_stmt,
+                            NULL) != SQLITE_OK)
+    {
+        sqlwrap_log_error (b->db);
+        bench_close (b);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static void
+bench_close (bench_db_t *b)
+{
+    (void)sqlite3_finalize (b->execute_stmt);
+    b->execute_stmt = NULL;
+
+    db_quit (b->db);
+    b->db = NULL;
+
+    return;
+}
+
+
+/* fill the database with rows 1 to rows. with --keep a database of the
+ * right size left by an earlier run is used as is */
+static int
+build (bench_db_t *b, size_t rows)
+{
+    char path[MAX_ROW_PATH];
+    char customer[64];
+    int year, month, day;
+    uint64_t start;
+    double elapsed;
+
+    if (bench_open (b)) return 1;
+
+    if (count_rows (b->db) == (long long)rows)
+    {
+        (void)printf ("%zu rows, %s journal, reusing '%s'\n",
+                      rows, b->journal, b->filepath);
+        return 0;
+    }
+
+    /* start over from an empty file */
+    bench_close (b);
+    remove_database (b->filepath);
+    if (bench_open (b)) return 1;
+
+    db_batch_init (10000, NO_BATCH_LATENCY);
+    start = now_ns ();
+    for (size_t key = 1; key <= rows; key++)
+    {
+        make_row (key, path, customer, &year, &month, &day);
+
+        if (db_batch_begin (b->db) ||
+            db_insert (b->db, path, customer, year, month, day) ||
+            db_batch_step (b->db))
+        {
+            (void)fprintf (stderr, "error: failed to insert row %zu\n", key);
+            return 1;
+        }
+    }
+    if (db_batch_flush (b->db)) return 1;
+    elapsed = (double)(now_ns () - start) / 1e9;
+
+    (void)printf ("%zu rows, %s journal, built in %.2fs (%.0f rows/s)\n",
+                  rows, b->journal, elapsed, (double)rows / elapsed);
+
+    return 0;
+}
+
+
+static long long
+count_rows (sqlite3 *db)
+{
+    sqlite3_stmt *stmt = NULL;
+    long long count = -1;
+
+    if (sqlite3_prepare_v2 (db, "SELECT count(*) FROM invoices;", -1,
+                            &stmt, NULL) != SQLITE_OK)
+    {
+        return -1;
+    }
+    if (sqlite3_step (stmt) == SQLITE_ROW) count = sqlite3_column_int64 (stmt, 0);
+    (void)sqlite3_finalize (stmt);
+
+    return count;
+}
+
+
+/* the next item of a comma separated list, NULL at the end */
+static char *
+next_item (char **iter)
+{
+    char *item = *iter;
+    char *comma = NULL;
+
+    if ((item == NULL) || (*item == '\0')) return NULL;
+
+    comma = strchr (item, ',');
+    if (comma != NULL) *comma++ = '\0';
+    *iter = comma;
+
+    return item;
+}
+
+
+static void
+remove_database (const char *filepath)
+{
+    const char *SUFFIXES[] = { "", "-journal", "-wal", "-shm" };
+    char name[MAX_ROW_PATH + 16];
+
+    for (size_t i = 0; i < LEN (SUFFIXES); i++)
+    {
+        (void)snprintf (name, sizeof (name), "%s%s", filepath, SUFFIXES[i]);
+        (void)remove (name);
+    }
+
+    return;
+}
+
+
+/* one call of op on the row key, returns non zero on error */
+static int
+run_op (bench_db_t *b, op_t op, size_t key)
+{
+    char path[MAX_ROW_PATH];
+    char customer[64];
+    int year, month, day;
+    invoice_t *invoice = NULL;
+    int retcode;
+
+    switch (op)
+    {
+    case OP_INSERT:
+        make_row (key, path, customer, &year, &month, &day);
+        return db_insert (b->db, path, customer, year, month, day);
+
+    case OP_UPDATE:
+        make_row (key, path, customer, &year, &month, &day);
+        customer[0] = (customer[0] == 'C' ? 'K' : 'C');
+        return db_update_by_file (b->db, path, customer, year, month, day);
+
+    case OP_SEARCH_FILE:
+        make_row (key, path, customer, &year, &month, &day);
+        return !db_search_by_file (b->db, path, &invoice);
+
+    case OP_SEARCH_ID:
+        return !db_search_by_id (b->db, (int)key, &invoice);
+
+    case OP_EXECUTE:
+        (void)sqlite3_bind_int (b->execute_stmt, 1, (int)key);
+        retcode = sqlwrap_execute (b->db, b->execute_stmt, 3, NULL, NULL);
+        (void)sqlite3_reset (b->execute_stmt);
+        return (retcode != SQLITE_ROW);
+
+    default:
+        return 1;
+    }
+}
+
+
+/* time op over n keys, one latency per call */
+static int
+time_op (bench_db_t *b, const char *label, op_t op, const size_t *keys,
+         size_t n, int cold, int batched)
+{
+    uint64_t *latency = malloc (n * sizeof (uint64_t));
+    uint64_t total = 0;
+    int retcode = 1;
+
+    if (latency == NULL) return 1;
+
+    /* warm the page cache with the same rows, new rows have none yet so
+     * their neighbours in the index are read instead */
+    if (!cold)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            (void)run_op (b, ((op == OP_INSERT) ? OP_SEARCH_ID : op == OP_UPDATE
+                              ? OP_SEARCH_FILE : op),
+                          ((op == OP_INSERT) ? (keys[i] % n) + 1 : keys[i]));
+        }
+    }
+
+    db_batch_init ((batched ? (size_t)s_batch : 0), NO_BATCH_LATENCY);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t start;
+
+        if (cold)
+        {
+            bench_close (b);
+            if (bench_open (b)) goto time_op_exit;
+        }
+
+        start = now_ns ();
+        if (db_batch_begin (b->db) || run_op (b, op, keys[i]) ||
+            db_batch_step (b->db))
+        {
+            (void)fprintf (stderr, "error: %s failed on row %zu\n", label, keys[i]);
+            goto time_op_exit;
+        }
+        if ((i + 1 == n) && db_batch_flush (b->db)) goto time_op_exit;
+        latency[i] = now_ns () - start;
+        total += latency[i];
+    }
+
+    qsort (latency, n, sizeof (uint64_t), compare_u64);
+    (void)printf ("%-24s %-5s %-10s %8zu %12.0f %10.2f %10.2f\n",
+                  label, (cold ? "cold" : "warm"),
+                  (batched ? "batched" : "autocommit"), n,
+                  (double)n * 1e9 / (double)(total ? total : 1),
+                  (double)latency[n / 2] / 1e3,
+                  (double)latency[(n * 99) / 100] / 1e3);
+
+    /* put the database back the way it was for the next run */
+    if (op == OP_INSERT)
+    {
+        char path[MAX_ROW_PATH];
+        char customer[64];
+        int year, month, day;
+
+        (void)db_begin (b->db);
+        for (size_t i = 0; i < n; i++)
+        {
+            make_row (keys[i], path, customer, &year, &month, &day);
+            (void)db_delete_by_file (b->db, path);
+        }
+        (void)db_commit (b->db);
+    }
+
+    retcode = 0;
+
+time_op_exit:
+    (void)db_batch_rollback (b->db);
+    free (latency);
+
+    return retcode;
+}
+
+
+/* one pass over every row through a cursor, after an untimed pass to warm
+ * the page cache */
+static int
+time_scan (bench_db_t *b, const char *label, scan_t scan)
+{
+    static invoice_t s_invoices[SCAN_BATCH];
+    const char *QUERY = "SELECT * FROM invoices;";
+
+    invoice_view_t view;
+    db_cursor_t *cursor = NULL;
+    uint64_t start = 0;
+    uint64_t total = 0;
+    size_t rows = 0;
+    size_t bytes = 0;
+    long count = 0;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        cursor = db_cursor_open (b->db, QUERY);
+        if (cursor == NULL) return 1;
+
+        rows = 0;
+        bytes = 0;
+        start = now_ns ();
+        switch (scan)
+        {
+        case SCAN_NEXT:
+            while ((count = db_cursor_next (cursor, &s_invoices[0])) > 0)
+            {
+                bytes += strlen (s_invoices[0].filepath);
+                rows++;
+            }
+            break;
+
+        case SCAN_FETCH:
+            while ((count = db_cursor_fetch (cursor, s_invoices, SCAN_BATCH)) > 0)
+            {
+                for (long i = 0; i < count; i++)
+                {
+                    bytes += strlen (s_invoices[i].filepath);
+                }
+                rows += (size_t)count;
+            }
+            break;
+
+        case SCAN_VIEW:
+            while ((count = db_cursor_next_view (cursor, &view)) > 0)
+            {
+                bytes += view.filepath.length;
+                rows++;
+            }
+            break;
+        }
+        total = now_ns () - start;
+
+        db_cursor_close (cursor); cursor = NULL;
+        if (count < 0)
+        {
+            (void)fprintf (stderr, "error: %s failed after %zu rows\n", label, rows);
+            return 1;
+        }
+    }
+
+    (void)printf ("%-24s %-5s %-10s %8zu %12.0f %10s %10s\n",
+                  label, "warm", "scan", rows,
+                  (double)rows * 1e9 / (double)(total ? total : 1), "-", "-");
+    log_debug ("%s: %zu path bytes\n", label, bytes);
+
+    return 0;
+}
+
+
+/* the same row for the same key and seed. the key leads the path, so
+ * every path is unique */
+static void
+make_row (size_t key, char *path, char *customer,
+          int *year, int *month, int *day)
+{
+    bench_rng_t rng;
+    int n;
+
+    bench_rng_seed (&rng, s_seed ^ ((uint64_t)key * 0x9e3779b97f4a7c15ULL));
+
+    n = snprintf (path, MAX_ROW_PATH, "/%zu", key);
+    (void)bench_make_path (&rng, path + n, MAX_ROW_PATH - (size_t)n);
+
+    (void)snprintf (customer, 64, "Customer %05u", bench_rng_below (&rng, 20000));
+    *year  = 1995 + (int)bench_rng_below (&rng, 30);
+    *month = 1 + (int)bench_rng_below (&rng, 12);
+    *day   = 1 + (int)bench_rng_below (&rng, 28);
+
+    return;
+}
+
+
+static int
+compare_u64 (const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+
+static uint64_t
+now_ns (void)
+{
+    struct timespec ts;
+
+#if defined(CLOCK_MONOTONIC)
+    (void)clock_gettime (CLOCK_MONOTONIC, &ts);
+#else
+    (void)timespec_get (&ts, TIME_UTC);
+#endif
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+
+static void
+parse_arguements (int argc, char **argv)
+{
+    enum
+    {
+        ROWS = CONARG_ID_CUSTOM,
+        JOURNAL,
+        DIRECTORY,
+        OPS,
+        COLD_OPS,
+        BATCH,
+        SEED,
+        KEEP,
+        HELP,
+    };
+    const conarg_t ARG_LIST[] = {
+        { ROWS,      "-r", "--rows",      CONARG_PARAM_REQUIRED },
+        { JOURNAL,   "-j", "--journal",   CONARG_PARAM_REQUIRED },
+        { DIRECTORY, "-d", "--directory", CONARG_PARAM_REQUIRED },
+        { OPS,       "-n", "--ops",       CONARG_PARAM_REQUIRED },
+        { COLD_OPS,  NULL, "--cold-ops",  CONARG_PARAM_REQUIRED },
+        { BATCH,     "-b", "--batch",     CONARG_PARAM_REQUIRED },
+        { SEED,      NULL, "--seed",      CONARG_PARAM_REQUIRED },
+        { KEEP,      NULL, "--keep",      CONARG_PARAM_NONE },
+        { HELP,      "-h", "--help",      CONARG_PARAM_NONE },
+    };
+    const size_t ARG_COUNT = LEN (ARG_LIST);
+
+    int id;
+    conarg_status_t param_stat;
+
+    CONARG_STEP (argc, argv);
+    while (argc > 0)
+    {
+        param_stat = CONARG_STATUS_NA;
+        id = conarg_check (ARG_LIST, ARG_COUNT, argc, argv, &param_stat);
+
+        switch (id)
+        {
+        case ROWS:
+            CONARG_STEP (argc, argv);
+            s_rows = conarg_get_param (argc, argv);
+            break;
+
+        case JOURNAL:
+            CONARG_STEP (argc, argv);
+            s_journals = conarg_get_param (argc, argv);
+            break;
+
+        case DIRECTORY:
+            CONARG_STEP (argc, argv);
+            s_dir = conarg_get_param (argc, argv);
+            break;
+
+        case OPS:
+            CONARG_STEP (argc, argv);
+            s_ops = param_to_long (conarg_get_param (argc, argv), 1);
+            break;
+
+        case COLD_OPS:
+            CONARG_STEP (argc, argv);
+            s_cold_ops = param_to_long (conarg_get_param (argc, argv), 1);
+            break;
+
+        case BATCH:
+            CONARG_STEP (argc, argv);
+            s_batch = param_to_long (conarg_get_param (argc, argv), 1);
+            break;
+
+        case SEED:
+            CONARG_STEP (argc, argv);
+            s_seed = (unsigned long long)param_to_long (conarg_get_param (argc, argv), 0);
+            break;
+
+        case KEEP:
+            s_keep = 1;
+            break;
+
+        case HELP:
+            help_page (stdout);
+            exit (EXIT_SUCCESS);
+
+        /* error states */
+        case CONARG_ID_UNKNOWN:
+        case CONARG_ID_PARAM_ERROR:
+        default:
+            help_page (stderr);
+            exit (EXIT_FAILURE);
+        }
+
+        CONARG_STEP (argc, argv);
+    }
+
+    return;
+}
+
+
+/* convert a numeric parameter, exiting on bad input */
+static long
+param_to_long (char *param, long min)
+{
+    char *end = NULL;
+    long value;
+
+    errno = 0;
+    value = strtol (param, &end, 10);
+    if ((errno != 0) || (end == param) || (*end != '\0') || (value < min))
+    {
+        (void)fprintf (stderr, "error: invalid numeric parameter: '%s'\n", param);
+        help_page (stderr);
+        exit (EXIT_FAILURE);
+    }
+
+    return value;
+}
+
+
+static void
+help_page (FILE *stream)
+{
+    const char *HELP_MSG = {
+        "Usage: invoice-bench-db [OPTION]...\n"
+        "Time single database-lib calls against databases of each size.\n"
+        "\n"
+        "  -r, --rows N[,N]...         database sizes to test (default 10000),\n"
+        "                                e.g. 10000,1000000,10000000\n"
+        "  -j, --journal MODE[,MODE]   SQLite journal modes to test\n"
+        "                                (default delete,wal)\n"
+        "  -d, --directory DIR         where to build the databases, best a\n"
+        "                                tmpfs (default /dev/shm on linux)\n"
+        "  -n, --ops N                 calls timed per operation (default 10000)\n"
+        "      --cold-ops N            calls timed on a cold cache, each one\n"
+        "                                reopens the database (default 500)\n"
+        "  -b, --batch N               writes per batched transaction\n"
+        "                                (default 1000)\n"
+        "      --seed S                seed for the generated rows (default 1)\n"
+        "      --keep                  keep the databases, and reuse them on\n"
+        "                                the next run\n"
+        "  -h, --help                  display this help message and exit\n"
+    };
+
+    (void)fprintf (stream, "%s", HELP_MSG);
+
+    return;
+}
+
+
+/* end of file */
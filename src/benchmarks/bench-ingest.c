@@ -0,0 +1,671 @@
+#include "bench-corpus.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <ftw.h>
+#include <hemlock-argparser-lib/arguement.h>
+#include <mystring-lib/mystring.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/* end to end ingest benchmark, POSIX only. builds a tree of invoice scans
+ * on a tmpfs, laid out like ScannedMaterial, then runs
+ * invoice-update-database --scan over it three times:
+ *
+ *   first ingest         into an empty database
+ *   rescan, no change    nothing to do, every file is in the stat cache
+ *   rescan, 1% change    1% of the files were rewritten since
+ *
+ * each run reports its wall time, CPU time and peak RSS, as seen by
+ * wait4(), and the size of the database after it.
+ *
+ * only what the benchmark makes is ever removed from the work directory:
+ * the tree, the database and the logs. a marker file claims the directory,
+ * one holding a tree or database without it is left alone. */
+
+#ifndef UPDATE_DATABASE_PATH
+#   define UPDATE_DATABASE_PATH "invoice-update-database"
+#endif
+
+#define MAX_BENCH_PATH 1024
+
+#define MARKER_FILE ".invoice-bench-ingest"
+#define TREE_DIR    "ScannedMaterial"
+#define DB_FILE     "invoices.db"
+
+/* every file the benchmark, or the program it runs, leaves behind */
+static const char *S_WORK_FILES[] = {
+    DB_FILE, DB_FILE "-wal", DB_FILE "-shm", DB_FILE "-journal",
+    "ingest.log", "badfiles.log",
+};
+
+typedef struct
+{
+    double wall;
+    double user;
+    double system;
+    long   max_rss_kb;
+    int    status;
+} run_result_t;
+
+
+static void  parse_arguements (int argc, char **argv);
+static void  help_page (FILE *stream);
+static long  param_to_long (char *param, long min);
+
+static int   build_tree (const char *root, size_t *bad_files);
+static int   make_directories (char *path);
+static int   create_file (const char *path);
+static size_t change_files (const char *root, double share);
+static int   change_one (const char *path, const struct stat *st, int type,
+                         struct FTW *ftw);
+static int   run_ingest (const char *root, const char *db, run_result_t *out);
+static void  report (const char *phase, const run_result_t *r, const char *db);
+static int   prepare_work_directory (void);
+static void  clean_work_directory (int remove_marker);
+static void  work_path (char *buf, size_t size, const char *name);
+static int   path_exists (const char *path);
+static int   remove_one (const char *path, const struct stat *st, int type,
+                         struct FTW *ftw);
+static double now_seconds (void);
+
+
+static long  s_files = 100000;
+static long  s_depth = 2;
+static long  s_fanout = 16;
+static long  s_bad_percent = 5;
+static long  s_jobs = 1;
+static long  s_change_per_mille = 10;
+static int   s_keep = 0;
+static unsigned long long s_seed = 1;
+static char *s_program = UPDATE_DATABASE_PATH;
+static char *s_dir = "/dev/shm/invoice-bench-ingest";
+static int   s_created_dir = 0;     /* s_dir did not exist before */
+
+/* change_one() state, nftw() takes no user pointer */
+static bench_rng_t s_change_rng;
+static uint32_t s_change_threshold;
+static size_t s_changed;
+
+
+int
+main (int argc, char **argv)
+{
+    int exitcode = EXIT_SUCCESS;
+    char root[MAX_BENCH_PATH];
+    char db[MAX_BENCH_PATH];
+    size_t bad_files = 0;
+    char program[PATH_MAX];
+    size_t changed = 0;
+    double start;
+    run_result_t result;
+
+    parse_arguements (argc, argv);
+
+    /* the program runs from the work directory */
+    if (realpath (s_program, program) == NULL)
+    {
+        (void)fprintf (stderr, "error: cannot find '%s': %s\n", 
+                       s_program, strerror (errno));
+        exit (EXIT_FAILURE);
+    }
+    s_program = program;
+
+    work_path (root, sizeof (root), TREE_DIR);
+    work_path (db, sizeof (db), DB_FILE);
+
+    /* start from nothing */
+    if (prepare_work_directory ()) exit (EXIT_FAILURE);
+
+    start = now_seconds ();
+    if (build_tree (root, &bad_files))
+    {
+        exitcode = EXIT_FAILURE;
+        goto main_exit;
+    }
+    (void)printf ("%ld files (%zu unparseable), depth %ld, under '%s', "
+                  "built in %.2fs\n", s_files, bad_files, s_depth, root,
+                  now_seconds () - start);
+    (void)printf ("%-20s %10s %10s %10s %10s %12s %10s\n",
+                  "phase", "wall s", "cpu s", "user s", "sys s",
+                  "peak RSS MB", "db MB");
+
+    if (run_ingest (root, db, &result)) exitcode = EXIT_FAILURE;
+    report ("first ingest", &result, db);
+
+    if (run_ingest (root, db, &result)) exitcode = EXIT_FAILURE;
+    report ("rescan, no change", &result, db);
+
+    changed = change_files (root, (double)s_change_per_mille / 1000.0);
+    if (run_ingest (root, db, &result)) exitcode = EXIT_FAILURE;
+    report ("rescan, changed", &result, db);
+    (void)printf ("%zu files changed before the last rescan\n", changed);
+
+main_exit:
+    if (!s_keep) clean_work_directory (1);
+
+    exit (exitcode);
+}
+
+
+/* s_files files spread over s_fanout^s_depth directories. a bad share of
+ * the names can not be parsed, the rest are valid invoices */
+static int
+build_tree (const char *root, size_t *bad_files)
+{
+    const bench_name_kind_t BAD_KINDS[] = {
+        BENCH_NAME_BAD_DATE, BENCH_NAME_NO_MATCH, BENCH_NAME_PATHOLOGICAL,
+    };
+    bench_rng_t rng;
+    char path[MAX_BENCH_PATH];
+    size_t directories = 1;
+    int rc;
+
+    for (long i = 0; i < s_depth; i++) directories *= (size_t)s_fanout;
+
+    bench_rng_seed (&rng, s_seed);
+    *bad_files = 0;
+
+    for (long i = 0; i < s_files; i++)
+    {
+        size_t directory = (size_t)i % directories;
+        size_t n = (size_t)snprintf (path, sizeof (path), "%s", root);
+        bench_name_kind_t kind = BENCH_NAME_VALID;
+
+        /* the directory index, one level per digit in base s_fanout */
+        for (long level = 0; level < s_depth; level++)
+        {
+            n += (size_t)snprintf (path + n, sizeof (path) - n, "/%02zu",
+                                   directory % (size_t)s_fanout);
+            directory /= (size_t)s_fanout;
+        }
+        if ((i < (long)directories) && make_directories (path)) return 1;
+
+        if (bench_rng_below (&rng, 100) < (uint32_t)s_bad_percent)
+        {
+            kind = BAD_KINDS[bench_rng_below (&rng, LEN (BAD_KINDS))];
+            (*bad_files)++;
+        }
+
+        /* try again on the rare name taken twice in a directory */
+        path[n++] = '/';
+        do
+        {
+            bench_make_name_kind (&rng, path + n, sizeof (path) - n, kind);
+            rc = create_file (path);
+        } while (rc == EEXIST);
+
+        if (rc != 0)
+        {
+            (void)fprintf (stderr, "error: cannot create '%s': %s\n",
+                           path, strerror (rc));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* mkdir -p */
+static int
+make_directories (char *path)
+{
+    for (char *iter = path + 1; ; iter++)
+    {
+        if ((*iter != '/') && (*iter != '\0')) continue;
+
+        char saved = *iter;
+        *iter = '\0';
+        if ((mkdir (path, 0755) != 0) && (errno != EEXIST))
+        {
+            (void)fprintf (stderr, "error: cannot create '%s': %s\n",
+                           path, strerror (errno));
+            *iter = saved;
+            return 1;
+        }
+        *iter = saved;
+
+        if (saved == '\0') break;
+    }
+
+    return 0;
+}
+
+
+/* returns 0 on success, otherwise the errno */
+static int
+create_file (const char *path)
+{
+    const char CONTENT[] = "%PDF-1.4\n%%EOF\n";
+    int fd = open (path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    int rc = 0;
+
+    if (fd < 0) return errno;
+
+    if (write (fd, CONTENT, sizeof (CONTENT) - 1) < 0) rc = errno;
+    (void)close (fd);
+
+    return rc;
+}
+
+
+/* append a byte to a share of the files, so both their size and mtime
+ * change. returns how many were changed */
+static size_t
+change_files (const char *root, double share)
+{
+    bench_rng_seed (&s_change_rng, s_seed + 1);
+    s_change_threshold = (uint32_t)(share * 1000000.0);
+    s_changed = 0;
+
+    (void)nftw (root, change_one, 64, FTW_PHYS);
+
+    return s_changed;
+}
+
+
+static int
+change_one (const char *path, const struct stat *st, int type,
+            struct FTW *ftw)
+{
+    int fd;
+
+    (void)st; (void)ftw;
+    if (type != FTW_F) return 0;
+    if (bench_rng_below (&s_change_rng, 1000000) >= s_change_threshold) return 0;
+
+    fd = open (path, O_WRONLY | O_APPEND);
+    if (fd < 0) return 0;
+    if (write (fd, "\n", 1) == 1) s_changed++;
+    (void)close (fd);
+
+    return 0;
+}
+
+
+/* one invoice-update-database --scan, with its output in the work
+ * directory, timed and measured from here */
+static int
+run_ingest (const char *root, const char *db, run_result_t *out)
+{
+    char jobs[32];
+    char *args[] = {
+        s_program, "-t", "--enable-cache", "-j", jobs,
+        "-d", (char *)db, "--scan", (char *)root, NULL,
+    };
+    struct rusage usage;
+    double start = now_seconds ();
+    pid_t pid;
+
+    (void)snprintf (jobs, sizeof (jobs), "%ld", s_jobs);
+    (void)fflush (stdout);
+
+    pid = fork ();
+    if (pid < 0)
+    {
+        (void)fprintf (stderr, "error: fork: %s\n", strerror (errno));
+        return 1;
+    }
+    if (pid == 0)
+    {
+        int log;
+
+        /* badfiles.log and ingest.log end up next to the tree */
+        if ((chdir (s_dir) != 0) ||
+            ((log = open ("ingest.log", O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0))
+        {
+            _exit (127);
+        }
+        (void)dup2 (log, STDOUT_FILENO);
+        (void)dup2 (log, STDERR_FILENO);
+        (void)close (log);
+
+        (void)execv (s_program, args);
+        _exit (127);
+    }
+
+    if (wait4 (pid, &out->status, 0, &usage) < 0)
+    {
+        (void)fprintf (stderr, "error: wait4: %s\n", strerror (errno));
+        return 1;
+    }
+
+    out->wall   = now_seconds () - start;
+    out->user   = (double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec / 1e6;
+    out->system = (double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec / 1e6;
+    out->max_rss_kb = usage.ru_maxrss;
+
+    /* bad names make it exit 1, which is expected here */
+    if (!WIFEXITED (out->status) || (WEXITSTATUS (out->status) > 1))
+    {
+        (void)fprintf (stderr, "error: '%s' failed, see %s/ingest.log\n",
+                       s_program, s_dir);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static void
+report (const char *phase, const run_result_t *r, const char *db)
+{
+    char wal[MAX_BENCH_PATH];
+    struct stat st;
+    double db_mb = 0;
+
+    /* whatever is still in the write ahead log counts too */
+    (void)snprintf (wal, sizeof (wal), "%s-wal", db);
+    if (stat (db, &st) == 0)  db_mb += (double)st.st_size / (1024.0 * 1024.0);
+    if (stat (wal, &st) == 0) db_mb += (double)st.st_size / (1024.0 * 1024.0);
+
+    (void)printf ("%-20s %10.2f %10.2f %10.2f %10.2f %12.1f %10.1f\n",
+                  phase, r->wall, r->user + r->system, r->user, r->system,
+                  (double)r->max_rss_kb / 1024.0, db_mb);
+
+    return;
+}
+
+
+/* create or claim the work directory, and clear out a previous run.
+ * refuses a directory holding a tree or database the benchmark did not
+ * make */
+static int
+prepare_work_directory (void)
+{
+    char path[MAX_BENCH_PATH];
+    int fd;
+
+    if (mkdir (s_dir, 0755) == 0)
+    {
+        s_created_dir = 1;
+    }
+    else if (errno != EEXIST)
+    {
+        (void)fprintf (stderr, "error: cannot create '%s': %s\n",
+                       s_dir, strerror (errno));
+        return 1;
+    }
+
+    work_path (path, sizeof (path), MARKER_FILE);
+    if (!path_exists (path))
+    {
+        int foreign = 0;
+
+        work_path (path, sizeof (path), TREE_DIR);
+        foreign |= path_exists (path);
+        for (size_t i = 0; i < LEN (S_WORK_FILES); i++)
+        {
+            work_path (path, sizeof (path), S_WORK_FILES[i]);
+            foreign |= path_exists (path);
+        }
+
+        if (foreign)
+        {
+            (void)fprintf (stderr, "error: '%s' already holds a %s or %s that "
+                           "invoice-bench-ingest did not make, pick another "
+                           "directory\n", s_dir, TREE_DIR, DB_FILE);
+            return 1;
+        }
+    }
+
+    clean_work_directory (0);
+
+    work_path (path, sizeof (path), MARKER_FILE);
+    fd = open (path, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        (void)fprintf (stderr, "error: cannot create '%s': %s\n",
+                       path, strerror (errno));
+        return 1;
+    }
+    (void)close (fd);
+
+    return 0;
+}
+
+
+/* remove the tree and the work files, nothing else. the directory itself
+ * only goes if this run created it */
+static void
+clean_work_directory (int remove_marker)
+{
+    char path[MAX_BENCH_PATH];
+
+    work_path (path, sizeof (path), TREE_DIR);
+    if (path_exists (path)) (void)nftw (path, remove_one, 64, FTW_DEPTH | FTW_PHYS);
+
+    for (size_t i = 0; i < LEN (S_WORK_FILES); i++)
+    {
+        work_path (path, sizeof (path), S_WORK_FILES[i]);
+        (void)unlink (path);
+    }
+
+    if (!remove_marker) return;
+
+    work_path (path, sizeof (path), MARKER_FILE);
+    (void)unlink (path);
+    if (s_created_dir) (void)rmdir (s_dir);
+
+    return;
+}
+
+
+static void
+work_path (char *buf, size_t size, const char *name)
+{
+    (void)snprintf (buf, size, "%s/%s", s_dir, name);
+
+    return;
+}
+
+
+static int
+path_exists (const char *path)
+{
+    struct stat st;
+
+    return (lstat (path, &st) == 0);
+}
+
+
+static int
+remove_one (const char *path, const struct stat *st, int type,
+            struct FTW *ftw)
+{
+    (void)st; (void)type; (void)ftw;
+    (void)remove (path);
+
+    return 0;
+}
+
+
+static double
+now_seconds (void)
+{
+    struct timespec ts;
+    (void)clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+
+static void
+parse_arguements (int argc, char **argv)
+{
+    enum
+    {
+        FILES = CONARG_ID_CUSTOM,
+        DEPTH,
+        FANOUT,
+        BAD,
+        CHANGE,
+        JOBS,
+        DIRECTORY,
+        PROGRAM,
+        SEED,
+        KEEP,
+        HELP,
+    };
+    const conarg_t ARG_LIST[] = {
+        { FILES,     "-n", "--files",     CONARG_PARAM_REQUIRED },
+        { DEPTH,     NULL, "--depth",     CONARG_PARAM_REQUIRED },
+        { FANOUT,    NULL, "--fanout",    CONARG_PARAM_REQUIRED },
+        { BAD,       NULL, "--bad",       CONARG_PARAM_REQUIRED },
+        { CHANGE,    NULL, "--change",    CONARG_PARAM_REQUIRED },
+        { JOBS,      "-j", "--jobs",      CONARG_PARAM_REQUIRED },
+        { DIRECTORY, "-d", "--directory", CONARG_PARAM_REQUIRED },
+        { PROGRAM,   NULL, "--program",   CONARG_PARAM_REQUIRED },
+        { SEED,      NULL, "--seed",      CONARG_PARAM_REQUIRED },
+        { KEEP,      NULL, "--keep",      CONARG_PARAM_NONE },
+        { HELP,      "-h", "--help",      CONARG_PARAM_NONE },
+    };
+    const size_t ARG_COUNT = LEN (ARG_LIST);
+
+    int id;
+    conarg_status_t param_stat;
+
+    CONARG_STEP (argc, argv);
+    while (argc > 0)
+    {
+        param_stat = CONARG_STATUS_NA;
+        id = conarg_check (ARG_LIST, ARG_COUNT, argc, argv, &param_stat);
+
+        switch (id)
+        {
+        case FILES:
+            CONARG_STEP (argc, argv);
+            s_files = param_to_long (conarg_get_param (argc, argv), 1);
+            break;
+
+        case DEPTH:
+            CONARG_STEP (argc, argv);
+            s_depth = param_to_long (conarg_get_param (argc, argv), 0);
+            break;
+
+        case FANOUT:
+            CONARG_STEP (argc, argv);
+            s_fanout = param_to_long (conarg_get_param (argc, argv), 1);
+            break;
+
+        case BAD:
+            CONARG_STEP (argc, argv);
+            s_bad_percent = param_to_long (conarg_get_param (argc, argv), 0);
+            if (s_bad_percent > 100) s_bad_percent = 100;
+            break;
+
+        case CHANGE:
+            CONARG_STEP (argc, argv);
+            s_change_per_mille = param_to_long (conarg_get_param (argc, argv), 0);
+            if (s_change_per_mille > 1000) s_change_per_mille = 1000;
+            break;
+
+        case JOBS:
+            CONARG_STEP (argc, argv);
+            s_jobs = param_to_long (conarg_get_param (argc, argv), 1);
+            break;
+
+        case DIRECTORY:
+            CONARG_STEP (argc, argv);
+            s_dir = conarg_get_param (argc, argv);
+            break;
+
+        case PROGRAM:
+            CONARG_STEP (argc, argv);
+            s_program = conarg_get_param (argc, argv);
+            break;
+
+        case SEED:
+            CONARG_STEP (argc, argv);
+            s_seed = (unsigned long long)param_to_long (conarg_get_param (argc, argv), 0);
+            break;
+
+        case KEEP:
+            s_keep = 1;
+            break;
+
+        case HELP:
+            help_page (stdout);
+            exit (EXIT_SUCCESS);
+
+        /* error states */
+        case CONARG_ID_UNKNOWN:
+        case CONARG_ID_PARAM_ERROR:
+        default:
+            help_page (stderr);
+            exit (EXIT_FAILURE);
+        }
+
+        CONARG_STEP (argc, argv);
+    }
+
+    return;
+}
+
+
+/* convert a numeric parameter, exiting on bad input */
+static long
+param_to_long (char *param, long min)
+{
+    char *end = NULL;
+    long value;
+
+    errno = 0;
+    value = strtol (param, &end, 10);
+    if ((errno != 0) || (end == param) || (*end != '\0') || (value < min))
+    {
+        (void)fprintf (stderr, "error: invalid numeric parameter: '%s'\n", param);
+        help_page (stderr);
+        exit (EXIT_FAILURE);
+    }
+
+    return value;
+}
+
+
+static void
+help_page (FILE *stream)
+{
+    const char *HELP_MSG = {
+        "Usage: invoice-bench-ingest [OPTION]...\n"
+        "Time invoice-update-database --scan over a generated tree: the first\n"
+        "ingest, a rescan with no changes, and a rescan after some changes.\n"
+        "\n"
+        "  -n, --files N               files in the tree (default 100000)\n"
+        "      --depth N               directory levels under the root\n"
+        "                                (default 2)\n"
+        "      --fanout N              directories per level (default 16)\n"
+        "      --bad PERCENT           share of names that can not be parsed\n"
+        "                                (default 5)\n"
+        "      --change PER_MILLE      files changed before the last rescan,\n"
+        "                                in thousandths (default 10, 1%)\n"
+        "  -j, --jobs N                passed on to invoice-update-database\n"
+        "                                (default 1)\n"
+        "  -d, --directory DIR         work directory, best on a tmpfs. the\n"
+        "                                tree, database and logs of a previous\n"
+        "                                run there are removed first, nothing\n"
+        "                                else is touched (default\n"
+        "                                /dev/shm/invoice-bench-ingest)\n"
+        "      --program PATH          the invoice-update-database to run\n"
+        "      --seed S                seed for the generated names (default 1)\n"
+        "      --keep                  leave the tree and database behind\n"
+        "  -h, --help                  display this help message and exit\n"
+    };
+
+    (void)fprintf (stream, "%s", HELP_MSG);
+
+    return;
+}
+
+
+/* end of file */
@@ -0,0 +1,850 @@
+
+#include "bench-corpus.h"
+#include <errno.h>
+#include <hemlock-argparser-lib/arguement.h>
+#include <logging-lib/logging.h>
+#include <myfileio-lib/myfileio.h>
+#include <mystring-lib/mystring.h>
+#include <parser-lib/parser.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/* parser microbenchmark. reads a list of paths, or generates one from a
+ * seed, then times parser_ctx_parse() over the whole list with the 
+ * interpreter, the JIT, and the hand written scanner. --verify instead 
+ * checks that the scanner and PCRE2 agree on every path, --scaling times 
+ * the combined matcher as the number of naming conventions grows, and 
+ * --micro times each step of a parse on its own. */
+
+enum
+{
+    MODE_INTERPRETER = 1 << 0,
+    MODE_JIT         = 1 << 1,
+    MODE_SCAN        = 1 << 2,
+};
+
+typedef struct
+{
+    char **paths;
+    size_t count;
+    size_t alloc;
+} corpus_t;
+
+/* inputs for the steps timed by --micro, taken from the corpus */
+typedef struct
+{
+    char **names;           /* customer names, as matched */
+    char **spaced;          /* the same, underscores already replaced */
+    char (*groups)[4][MAX_PARSED_GROUP + 1];
+    size_t name_count;
+    size_t group_count;
+    size_t longest;
+} micro_inputs_t;
+
+
+static void  parse_arguements (int argc, char **argv);
+static void  help_page (FILE *stream);
+static long  param_to_long (char *param, long min);
+
+static int   corpus_load (corpus_t *corpus, const char *filepath);
+static int   corpus_generate (corpus_t *corpus, size_t n, uint64_t seed);
+static int   corpus_add (corpus_t *corpus, const char *line, size_t length);
+static void  corpus_free (corpus_t *corpus);
+static int   run (const corpus_t *corpus, int use_jit, parser_matcher_t matcher);
+static int   verify (const corpus_t *corpus);
+static int   scaling (const corpus_t *corpus);
+static int   micro (const corpus_t *corpus);
+static int   micro_inputs_load (micro_inputs_t *in, const corpus_t *corpus);
+static void  micro_inputs_free (micro_inputs_t *in);
+static void  report (const char *label, size_t ops, double elapsed, 
+                     double baseline);
+static int   same_result (const parsed_t *a, const parsed_t *b);
+static double now_seconds (void);
+
+
+static long  s_iterations = 10;
+static int   s_modes = MODE_INTERPRETER | MODE_JIT | MODE_SCAN;
+static int   s_verify = 0;
+static int   s_scaling = 0;
+static long  s_cache = 0;
+static char *s_input = NULL;
+static long  s_generate = 0;
+static unsigned long long s_seed = 1;
+static int   s_dump = 0;
+static int   s_micro = 0;
+
+/* keeps the compiler from dropping the timed calls */
+static volatile size_t s_sink = 0;
+
+
+int
+main (int argc, char **argv)
+{
+    int exitcode = EXIT_SUCCESS;
+    corpus_t corpus = { 0 };
+
+    logging_init (LOG_ERRORS_ONLY, NULL);
+    parse_arguements (argc, argv);
+
+    if (((s_generate > 0) && corpus_generate (&corpus, (size_t)s_generate, s_seed)) ||
+        ((s_generate == 0) && corpus_load (&corpus, s_input)))
+    {
+        exitcode = EXIT_FAILURE;
+        goto main_exit;
+    }
+    if (corpus.count == 0)
+    {
+        (void)fprintf (stderr, "error: no paths to parse\n");
+        exitcode = EXIT_FAILURE;
+        goto main_exit;
+    }
+
+    if (s_dump)
+    {
+        for (size_t i = 0; i < corpus.count; i++) (void)puts (corpus.paths[i]);
+        goto main_exit;
+    }
+
+    if (s_verify)
+    {
+        if (verify (&corpus)) exitcode = EXIT_FAILURE;
+        goto main_exit;
+    }
+
+    (void)printf ("%zu paths, %ld iterations\n", corpus.count, s_iterations);
+
+    if (s_micro)
+    {
+        if (micro (&corpus)) exitcode = EXIT_FAILURE;
+        goto main_exit;
+    }
+
+    if (s_scaling)
+    {
+        if (scaling (&corpus)) exitcode = EXIT_FAILURE;
+        goto main_exit;
+    }
+
+    if ((s_modes & MODE_INTERPRETER) && 
+        run (&corpus, 0, PARSER_MATCHER_REGEX)) exitcode = EXIT_FAILURE;
+    if ((s_modes & MODE_JIT) && 
+        run (&corpus, 1, PARSER_MATCHER_REGEX)) exitcode = EXIT_FAILURE;
+    if ((s_modes & MODE_SCAN) && 
+        run (&corpus, 1, PARSER_MATCHER_SCAN)) exitcode = EXIT_FAILURE;
+
+main_exit:
+    corpus_free (&corpus);
+    logging_quit ();
+
+    exit (exitcode);
+}
+
+
+static int
+run (const corpus_t *corpus, int use_jit, parser_matcher_t matcher)
+{
+    parser_ctx_t *ctx = NULL;
+    size_t matches = 0;
+    double start, elapsed;
+    const char *label = NULL;
+
+    parser_set_jit (use_jit);
+    parser_set_matcher (matcher);
+    parser_set_cache_size ((size_t)s_cache);
+    if (parser_init () != 0)
+    {
+        (void)fprintf (stderr, "error: failed to initialize the parser\n");
+        return 1;
+    }
+
+    ctx = parser_ctx_create ();
+    if (ctx == NULL)
+    {
+        (void)fprintf (stderr, "error: failed to create a parser context\n");
+        parser_quit ();
+        return 1;
+    }
+
+    /* asking for the JIT on a build without it still runs the interpreter */
+    label = (parser_jit_enabled () ? "jit" : "interpreter");
+    if (matcher == PARSER_MATCHER_SCAN) label = "scan";
+    if (use_jit && !parser_jit_enabled ())
+    {
+        (void)fprintf (stderr, "warning: JIT unavailable\n");
+    }
+
+    start = now_seconds ();
+    for (long i = 0; i < s_iterations; i++)
+    {
+        for (size_t j = 0; j < corpus->count; j++)
+        {
+            if (parser_ctx_parse (ctx, corpus->paths[j])) matches++;
+        }
+    }
+    elapsed = now_seconds () - start;
+
+    (void)printf ("%-12s %10zu matches in %8.3fs, %12.0f paths/s\n",
+                  label, matches, elapsed,
+                  (double)corpus->count * (double)s_iterations / elapsed);
+
+    parser_ctx_destroy (ctx);
+    if (s_cache > 0)
+    {
+        size_t hits, misses;
+        parser_cache_stats (&hits, &misses);
+        (void)printf ("%-12s %10zu hits, %zu misses\n", "", hits, misses);
+    }
+    parser_quit ();
+
+    return 0;
+}
+
+
+/* parse every path with both matchers, reporting where they disagree */
+static int
+verify (const corpus_t *corpus)
+{
+    parser_ctx_t *regex_ctx = NULL;
+    parser_ctx_t *scan_ctx = NULL;
+    size_t mismatches = 0;
+    size_t matches = 0;
+
+    if (parser_init () != 0)
+    {
+        (void)fprintf (stderr, "error: failed to initialize the parser\n");
+        return 1;
+    }
+
+    regex_ctx = parser_ctx_create ();
+    scan_ctx = parser_ctx_create ();
+    if ((regex_ctx == NULL) || (scan_ctx == NULL))
+    {
+        (void)fprintf (stderr, "error: failed to create a parser context\n");
+        mismatches = 1;
+        goto verify_exit;
+    }
+
+    for (size_t i = 0; i < corpus->count; i++)
+    {
+        parsed_t *expected = NULL;
+        parsed_t *actual = NULL;
+
+        /* the matcher is read on every parse, so the two can take turns */
+        parser_set_matcher (PARSER_MATCHER_REGEX);
+        expected = parser_ctx_parse (regex_ctx, corpus->paths[i]);
+        parser_set_matcher (PARSER_MATCHER_SCAN);
+        actual = parser_ctx_parse (scan_ctx, corpus->paths[i]);
+
+        if (expected) matches++;
+        if (same_result (expected, actual)) continue;
+
+        mismatches++;
+        (void)printf ("mismatch: '%s'\n", corpus->paths[i]);
+        (void)printf ("  regex: %s\n", expected ? expected->name : "(no match)");
+        (void)printf ("  scan:  %s\n", actual ? actual->name : "(no match)");
+    }
+
+    (void)printf ("%zu paths, %zu matches, %zu mismatches\n",
+                  corpus->count, matches, mismatches);
+
+verify_exit:
+    parser_ctx_destroy (regex_ctx);
+    parser_ctx_destroy (scan_ctx);
+    parser_quit ();
+
+    return (mismatches != 0);
+}
+
+
+/* time the JIT over sets of 2 to 50 conventions. the extra conventions
+ * look like the real one but never match, and come first so every path
+ * has to get past all of them */
+static int
+scaling (const corpus_t *corpus)
+{
+    const size_t SET_SIZES[] = { 2, 5, 10, 20, 50 };
+    const char *INVOICE = 
+            "^(.*?)(\\d{2})(\\d{2}).*?(\\d{2})(\\d{2}).*\\.pdf";
+
+    for (size_t i = 0; i < LEN (SET_SIZES); i++)
+    {
+        size_t n = SET_SIZES[i];
+        char name[32];
+        char pattern[128];
+
+        for (size_t j = 0; j + 1 < n; j++)
+        {
+            (void)snprintf (name, sizeof (name), "department_%02zu", j);
+            (void)snprintf (pattern, sizeof (pattern), 
+                            "^(.*?)D%02zu-(\\d{4})-(\\d{2})(\\d{2})\\.pdf", j);
+            if (parser_add_convention (name, pattern)) goto scaling_error;
+        }
+        if (parser_add_convention ("invoice", INVOICE)) goto scaling_error;
+
+        (void)printf ("%2zu conventions ", n);
+        if (run (corpus, 1, PARSER_MATCHER_REGEX)) return 1;
+    }
+
+    return 0;
+
+scaling_error:
+    (void)fprintf (stderr, "error: failed to add a naming convention\n");
+    parser_quit ();
+    return 1;
+}
+
+
+/* time each step of a parse on its own, then whole parses by kind of
+ * name. the steps that edit their input in place work on a fresh copy 
+ * each time, the cost of the copy is measured first and taken off */
+static int
+micro (const corpus_t *corpus)
+{
+    micro_inputs_t in = { 0 };
+    parser_ctx_t *ctx = NULL;
+    char *scratch = NULL;
+    double start, elapsed, copy_ns;
+    size_t ops, sink = 0;
+    int retcode = 1;
+
+    /* the scanner unless one of the PCRE2 modes was picked */
+    parser_set_jit (s_modes != MODE_INTERPRETER);
+    parser_set_matcher ((s_modes & MODE_SCAN) ? PARSER_MATCHER_SCAN 
+                                              : PARSER_MATCHER_REGEX);
+    parser_set_cache_size (0);
+    if (parser_init () != 0)
+    {
+        (void)fprintf (stderr, "error: failed to initialize the parser\n");
+        return 1;
+    }
+    ctx = parser_ctx_create ();
+    if ((ctx == NULL) || micro_inputs_load (&in, corpus))
+    {
+        (void)fprintf (stderr, "error: failed to prepare the inputs\n");
+        goto micro_exit;
+    }
+    scratch = malloc (in.longest + 1);
+    if (scratch == NULL) goto micro_exit;
+
+    (void)printf ("%zu names, %zu dates, %s matcher\n", 
+                  in.name_count, in.group_count,
+                  ((s_modes & MODE_SCAN) ? "scan" 
+                   : (parser_jit_enabled () ? "jit" : "interpreter")));
+    (void)printf ("%-28s %12s %14s\n", "step", "ns/op", "ops/s");
+
+    /* copying a name, taken off find_replace_char and trim_whitespace */
+    start = now_seconds ();
+    for (long i = 0; i < s_iterations; i++)
+    {
+        for (size_t j = 0; j < in.name_count; j++)
+        {
+            (void)strcpy (scratch, in.names[j]);
+            sink += (size_t)scratch[0];
+        }
+    }
+    elapsed = now_seconds () - start;
+    ops = in.name_count * (size_t)s_iterations;
+    copy_ns = (ops ? elapsed * 1e9 / (double)ops : 0);
+    report ("(copy)", ops, elapsed, 0);
+
+    start = now_seconds ();
+    for (long i = 0; i < s_iterations; i++)
+    {
+        for (size_t j = 0; j < corpus->count; j++)
+        {
+            sink += (size_t)basename (corpus->paths[j])[0];
+        }
+    }
+    report ("basename", corpus->count * (size_t)s_iterations, 
+            now_seconds () - start, 0);
+
+    start = now_seconds ();
+    for (long i = 0; i < s_iterations; i++)
+    {
+        for (size_t j = 0; j < in.name_count; j++)
+        {
+            (void)strcpy (scratch, in.names[j]);
+            sink += (size_t)find_replace_char (scratch, '_', ' ')[0];
+        }
+    }
+    report ("find_replace_char", ops, now_seconds () - start, copy_ns);
+
+    start = now_seconds ();
+    for (long i = 0; i < s_iterations; i++)
+    {
+        for (size_t j = 0; j < in.name_count; j++)
+        {
+            (void)strcpy (scratch, in.spaced[j]);
+            sink += (size_t)trim_whitespace (scratch)[0];
+        }
+    }
+    report ("trim_whitespace", ops, now_seconds () - start, copy_ns);
+
+    start = now_seconds ();
+    for (long i = 0; i < s_iterations; i++)
+    {
+        for (size_t j = 0; j < in.group_count; j++)
+        {
+            date_tuple_t date = guess_date_format (in.groups[j][0], 
+                    in.groups[j][1], in.groups[j][2], in.groups[j][3]);
+            sink += (size_t)date.day;
+        }
+    }
+    report ("guess_date_format", in.group_count * (size_t)s_iterations,
+            now_seconds () - start, 0);
+
+    start = now_seconds ();
+    for (long i = 0; i < s_iterations; i++)
+    {
+        for (size_t j = 0; j < corpus->count; j++)
+        {
+            sink += (parse_path (corpus->paths[j]) != NULL);
+        }
+    }
+    report ("parse_path (end to end)", corpus->count * (size_t)s_iterations,
+            now_seconds () - start, 0);
+
+    /* whole parses, split by what kind of name they were given */
+    for (int kind = 0; kind < BENCH_NAME_KIND_MAX; kind++)
+    {
+        bench_rng_t rng;
+        char label[64];
+        char path[512];
+        size_t count = 0;
+
+        /* regenerate a sample of the kind, the loaded corpus has no kinds */
+        bench_rng_seed (&rng, s_seed);
+        ops = 0;
+        elapsed = 0;
+        while ((count < 1000) && (ops < 1000000))
+        {
+            ops++;
+            if ((int)bench_make_path (&rng, path, sizeof (path)) != kind) continue;
+            count++;
+
+            start = now_seconds ();
+            for (long i = 0; i < s_iterations; i++)
+            {
+                sink += (parser_ctx_parse (ctx, path) != NULL);
+            }
+            elapsed += now_seconds () - start;
+        }
+
+        (void)snprintf (label, sizeof (label), "  %s", 
+                        bench_name_kind ((bench_name_kind_t)kind));
+        report (label, count * (size_t)s_iterations, elapsed, 0);
+    }
+
+    s_sink = sink;
+    retcode = 0;
+
+micro_exit:
+    free (scratch);
+    micro_inputs_free (&in);
+    parser_ctx_destroy (ctx);
+    parser_quit ();
+
+    return retcode;
+}
+
+
+/* parse the corpus once, keeping what each step is given in a real parse.
+ * the name is everything before the first digit of the filename, which is
+ * what the built in convention captures */
+static int
+micro_inputs_load (micro_inputs_t *in, const corpus_t *corpus)
+{
+    in->names  = calloc (corpus->count, sizeof (char *));
+    in->spaced = calloc (corpus->count, sizeof (char *));
+    in->groups = calloc (corpus->count, sizeof (*in->groups));
+    if ((in->names == NULL) || (in->spaced == NULL) || (in->groups == NULL))
+    {
+        return 1;
+    }
+
+    for (size_t i = 0; i < corpus->count; i++)
+    {
+        const char *filename = basename (corpus->paths[i]);
+        size_t length = strcspn (filename, "0123456789");
+        parsed_t *parsed = parse_path (corpus->paths[i]);
+        char *name = NULL;
+        char *spaced = NULL;
+
+        if (parsed)
+        {
+            (void)strcpy (in->groups[in->group_count][0], parsed->group_a);
+            (void)strcpy (in->groups[in->group_count][1], parsed->group_b);
+            (void)strcpy (in->groups[in->group_count][2], parsed->group_c);
+            (void)strcpy (in->groups[in->group_count][3], parsed->group_d);
+            in->group_count++;
+        }
+
+        if (length == 0) continue;
+        name = malloc (length + 1);
+        spaced = malloc (length + 1);
+        if ((name == NULL) || (spaced == NULL))
+        {
+            free (name);
+            free (spaced);
+            return 1;
+        }
+        memcpy (name, filename, length);
+        name[length] = '\0';
+        memcpy (spaced, name, length + 1);
+        (void)find_replace_char (spaced, '_', ' ');
+
+        in->names[in->name_count] = name;
+        in->spaced[in->name_count] = spaced;
+        in->name_count++;
+        if (length > in->longest) in->longest = length;
+    }
+
+    return 0;
+}
+
+
+static void
+micro_inputs_free (micro_inputs_t *in)
+{
+    for (size_t i = 0; i < in->name_count; i++)
+    {
+        free (in->names[i]);
+        free (in->spaced[i]);
+    }
+    free (in->names);   in->names = NULL;
+    free (in->spaced);  in->spaced = NULL;
+    free (in->groups);  in->groups = NULL;
+    in->name_count = 0;
+    in->group_count = 0;
+
+    return;
+}
+
+
+/* one line of the --micro table, less baseline nanoseconds per op */
+static void
+report (const char *label, size_t ops, double elapsed, double baseline)
+{
+    double ns = (ops ? elapsed * 1e9 / (double)ops : 0) - baseline;
+
+    if (ns < 0) ns = 0;
+    (void)printf ("%-28s %12.1f %14.0f\n", label, ns, 
+                  (ns > 0 ? 1e9 / ns : 0));
+
+    return;
+}
+
+
+static int
+same_result (const parsed_t *a, const parsed_t *b)
+{
+    if ((a == NULL) || (b == NULL)) return (a == b);
+
+    return ((strcmp (a->name_raw, b->name_raw) == 0) &&
+            (strcmp (a->name, b->name) == 0) &&
+            (strcmp (a->group_a, b->group_a) == 0) &&
+            (strcmp (a->group_b, b->group_b) == 0) &&
+            (strcmp (a->group_c, b->group_c) == 0) &&
+            (strcmp (a->group_d, b->group_d) == 0) &&
+            (a->year  == b->year) &&
+            (a->month == b->month) &&
+            (a->day   == b->day));
+}
+
+
+static int
+corpus_load (corpus_t *corpus, const char *filepath)
+{
+    FILE *fp = stdin;
+    linereader_t reader;
+    char *line = NULL;
+    size_t length = 0;
+
+    if (filepath != NULL)
+    {
+        fp = fopen (filepath, "rb");
+        if (fp == NULL)
+        {
+            (void)fprintf (stderr, "error: cannot open '%s': %s\n",
+                           filepath, strerror (errno));
+            return 1;
+        }
+    }
+
+    linereader_init (&reader, fp);
+    while ((line = linereader_next_n (&reader, &length)))
+    {
+        if (is_empty (line)) continue;
+        if (corpus_add (corpus, line, length)) break;
+    }
+    linereader_free (&reader);
+
+    if (fp != stdin) (void)fclose (fp);
+
+    return 0;
+}
+
+
+/* n synthetic paths, the same ones for the same seed */
+static int
+corpus_generate (corpus_t *corpus, size_t n, uint64_t seed)
+{
+    bench_rng_t rng;
+    char path[512];
+    size_t kinds[BENCH_NAME_KIND_MAX] = { 0 };
+
+    bench_rng_seed (&rng, seed);
+    for (size_t i = 0; i < n; i++)
+    {
+        bench_name_kind_t kind = bench_make_path (&rng, path, sizeof (path));
+        kinds[kind]++;
+
+        if (corpus_add (corpus, path, strlen (path)))
+        {
+            (void)fprintf (stderr, "error: out of memory\n");
+            return 1;
+        }
+    }
+
+    /* the corpus itself goes to stdout with --dump */
+    (void)fprintf ((s_dump ? stderr : stdout), "seed %llu:", 
+                   (unsigned long long)seed);
+    for (int i = 0; i < BENCH_NAME_KIND_MAX; i++)
+    {
+        (void)fprintf ((s_dump ? stderr : stdout), " %zu %s%s", kinds[i],
+                       bench_name_kind ((bench_name_kind_t)i),
+                       (i + 1 < BENCH_NAME_KIND_MAX ? "," : "\n"));
+    }
+
+    return 0;
+}
+
+
+static int
+corpus_add (corpus_t *corpus, const char *line, size_t length)
+{
+    char *copy = NULL;
+
+    if (corpus->count == corpus->alloc)
+    {
+        size_t alloc = (corpus->alloc ? corpus->alloc * 2 : 1024);
+        char **tmp = realloc (corpus->paths, alloc * sizeof (char *));
+        if (tmp == NULL) return 1;
+        corpus->paths = tmp;
+        corpus->alloc = alloc;
+    }
+
+    copy = malloc (length + 1);
+    if (copy == NULL) return 1;
+    memcpy (copy, line, length + 1);
+
+    corpus->paths[corpus->count++] = copy;
+
+    return 0;
+}
+
+
+static void
+corpus_free (corpus_t *corpus)
+{
+    for (size_t i = 0; i < corpus->count; i++) free (corpus->paths[i]);
+    free (corpus->paths);
+
+    corpus->paths = NULL;
+    corpus->count = 0;
+    corpus->alloc = 0;
+
+    return;
+}
+
+
+static double
+now_seconds (void)
+{
+    struct timespec ts;
+    (void)timespec_get (&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+
+static void
+parse_arguements (int argc, char **argv)
+{
+    enum
+    {
+        INPUT = CONARG_ID_CUSTOM,
+        ITERATIONS,
+        JIT_ONLY,
+        INTERPRETER_ONLY,
+        SCAN_ONLY,
+        VERIFY,
+        SCALING,
+        CACHE,
+        GENERATE,
+        SEED,
+        DUMP,
+        MICRO,
+        HELP,
+    };
+    const conarg_t ARG_LIST[] = {
+        { INPUT,            "-i", "--input",       CONARG_PARAM_REQUIRED },
+        { ITERATIONS,       "-n", "--iterations",  CONARG_PARAM_REQUIRED },
+        { JIT_ONLY,         NULL, "--jit",         CONARG_PARAM_NONE },
+        { INTERPRETER_ONLY, NULL, "--interpreter", CONARG_PARAM_NONE },
+        { SCAN_ONLY,        NULL, "--scan",        CONARG_PARAM_NONE },
+        { VERIFY,           NULL, "--verify",      CONARG_PARAM_NONE },
+        { SCALING,          NULL, "--scaling",     CONARG_PARAM_NONE },
+        { CACHE,            NULL, "--cache",       CONARG_PARAM_REQUIRED },
+        { GENERATE,         "-g", "--generate",    CONARG_PARAM_REQUIRED },
+        { SEED,             NULL, "--seed",        CONARG_PARAM_REQUIRED },
+        { DUMP,             NULL, "--dump",        CONARG_PARAM_NONE },
+        { MICRO,            NULL, "--micro",       CONARG_PARAM_NONE },
+        { HELP,             "-h", "--help",        CONARG_PARAM_NONE },
+    };
+    const size_t ARG_COUNT = LEN (ARG_LIST);
+
+    int id;
+    conarg_status_t param_stat;
+
+    CONARG_STEP (argc, argv);
+    while (argc > 0)
+    {
+        param_stat = CONARG_STATUS_NA;
+        id = conarg_check (ARG_LIST, ARG_COUNT, argc, argv, &param_stat);
+
+        switch (id)
+        {
+        case INPUT:
+            CONARG_STEP (argc, argv);
+            s_input = conarg_get_param (argc, argv);
+            break;
+
+        case ITERATIONS:
+            CONARG_STEP (argc, argv);
+            s_iterations = param_to_long (conarg_get_param (argc, argv), 1);
+            break;
+
+        case JIT_ONLY:
+            s_modes = MODE_JIT;
+            break;
+
+        case INTERPRETER_ONLY:
+            s_modes = MODE_INTERPRETER;
+            break;
+
+        case SCAN_ONLY:
+            s_modes = MODE_SCAN;
+            break;
+
+        case VERIFY:
+            s_verify = 1;
+            break;
+
+        case SCALING:
+            s_scaling = 1;
+            break;
+
+        case CACHE:
+            CONARG_STEP (argc, argv);
+            s_cache = param_to_long (conarg_get_param (argc, argv), 0);
+            break;
+
+        case GENERATE:
+            CONARG_STEP (argc, argv);
+            s_generate = param_to_long (conarg_get_param (argc, argv), 1);
+            break;
+
+        case SEED:
+            CONARG_STEP (argc, argv);
+            s_seed = (unsigned long long)param_to_long (conarg_get_param (argc, argv), 0);
+            break;
+
+        case DUMP:
+            s_dump = 1;
+            break;
+
+        case MICRO:
+            s_micro = 1;
+            break;
+
+        case HELP:
+            help_page (stdout);
+            exit (EXIT_SUCCESS);
+
+        /* error states */
+        case CONARG_ID_UNKNOWN:
+        case CONARG_ID_PARAM_ERROR:
+        default:
+            help_page (stderr);
+            exit (EXIT_FAILURE);
+        }
+
+        CONARG_STEP (argc, argv);
+    }
+
+    return;
+}
+
+
+/* convert a numeric parameter, exiting on bad input */
+static long
+param_to_long (char *param, long min)
+{
+    char *end = NULL;
+    long value;
+
+    errno = 0;
+    value = strtol (param, &end, 10);
+    if ((errno != 0) || (end == param) || (*end != '\0') || (value < min))
+    {
+        (void)fprintf (stderr, "error: invalid numeric parameter: '%s'\n", param);
+        help_page (stderr);
+        exit (EXIT_FAILURE);
+    }
+
+    return value;
+}
+
+
+static void
+help_page (FILE *stream)
+{
+    const char *HELP_MSG = {
+        "Usage: invoice-bench-parser [OPTION]...\n"
+        "Time the filename parser over a list of paths, one per line.\n"
+        "\n"
+        "  -i, --input FILE            read paths from FILE instead of stdin\n"
+        "  -n, --iterations N          parse the whole list N times (default 10)\n"
+        "      --jit                   only time the JIT compiled patterns\n"
+        "      --interpreter           only time the interpreter\n"
+        "      --scan                  only time the hand written scanner\n"
+        "      --verify                check the scanner against PCRE2 on every\n"
+        "                                path instead of timing, exits non zero\n"
+        "                                on any difference\n"
+        "      --scaling               time the JIT with 2 to 50 naming\n"
+        "                                conventions compiled together\n"
+        "      --cache N               time with a parse cache of N filenames\n"
+        "                                (default 0, no cache)\n"
+        "  -g, --generate N            parse N generated paths instead of\n"
+        "                                reading a list\n"
+        "      --seed S                seed for --generate (default 1), the\n"
+        "                                same seed gives the same paths\n"
+        "      --dump                  print the paths and exit, to feed them\n"
+        "                                to another program\n"
+        "      --micro                 time basename, find_replace_char,\n"
+        "                                trim_whitespace, guess_date_format\n"
+        "                                and parse_path each on their own, and\n"
+        "                                whole parses by kind of name\n"
+        "  -h, --help                  display this help message and exit\n"
+    };
+
+    (void)fprintf (stream, "%s", HELP_MSG);
+
+    return;
+}
+
+
+/* end of file */
@@ -9,17 +9,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 
 enum
 {
     STMT_CREATE_TABLES,
     STMT_INSERT,
+    STMT_UPSERT,
+    STMT_INSERT_OR_IGNORE,
     STMT_UPDATE_BY_FILEPATH,
     STMT_UPDATE_BY_INVOICE_ID,
+    STMT_DELETE_BY_FILEPATH,
+    STMT_DELETE_BY_DIRECTORY,
     STMT_SELECT_BY_CUSTOMER_NAME,
+    STMT_SELECT_BY_CUSTOMER_PREFIX,
     STMT_SELECT_BY_FILEPATH,
     STMT_SELECT_BY_INVOICE_ID,
+    STMT_SELECT_FILE_STATS,
+    STMT_SELECT_DATE_RANGE,
+    STMT_BEGIN,
+    STMT_COMMIT,
+    STMT_ROLLBACK,
     STMT_MAX,
 };
 const char *S_STMTS_TEXT[STMT_MAX] = {
@@ -49,6 +60,69 @@ const char *S_STMTS_TEXT[STMT_MAX] = {
             ":ERROR"
         ");",
 
+    /* the WHERE clause leaves unchanged rows alone, so re-scanning the same
+     * files does not dirty any pages */
+    [STMT_UPSERT] =
+        "INSERT INTO invoices ("
+            "filepath, customer_name, year, month, day, search_date, error_flag, "
+            "file_dev, file_ino, file_size, file_mtime"
+        ") " 
+        "VALUES ("
+            ":FILEPATH, "
+            ":CUSTOMER, "
+            ":YEAR, "
+            ":MONTH, "
+            ":DAY, "
+            ":DATE, "
+            ":ERROR, "
+            ":DEV, "
+            ":INO, "
+            ":SIZE, "
+            ":MTIME"
+        ") "
+        "ON CONFLICT (filepath) DO UPDATE "
+        "SET customer_name = excluded.customer_name, "
+            "year"       " = excluded.year, "
+            "month"      " = excluded.month, "
+            "day"        " = excluded.day, "
+            "search_date"" = excluded.search_date, "
+            "error_flag" " = excluded.error_flag, "
+            "file_dev"   " = coalesce (excluded.file_dev,   file_dev), "
+            "file_ino"   " = coalesce (excluded.file_ino,   file_ino), "
+            "file_size"  " = coalesce (excluded.file_size,  file_size), "
+            "file_mtime" " = coalesce (excluded.file_mtime, file_mtime) "
+        "WHERE customer_name IS NOT excluded.customer_name "
+           "OR year"       " IS NOT excluded.year "
+           "OR month"      " IS NOT excluded.month "
+           "OR day"        " IS NOT excluded.day "
+           "OR search_date"" IS NOT excluded.search_date "
+           "OR error_flag" " IS NOT excluded.error_flag "
+           "OR ((excluded.file_mtime IS NOT NULL) AND "
+               "((file_dev"  " IS NOT excluded.file_dev) "
+             "OR (file_ino"  " IS NOT excluded.file_ino) "
+             "OR (file_size" " IS NOT excluded.file_size) "
+             "OR (file_mtime IS NOT excluded.file_mtime)));",
+
+    [STMT_INSERT_OR_IGNORE] =
+        "INSERT INTO invoices ("
+            "filepath, customer_name, year, month, day, search_date, error_flag, "
+            "file_dev, file_ino, file_size, file_mtime"
+        ") " 
+        "VALUES ("
+            ":FILEPATH, "
+            ":CUSTOMER, "
+            ":YEAR, "
+            ":MONTH, "
+            ":DAY, "
+            ":DATE, "
+            ":ERROR, "
+            ":DEV, "
+            ":INO, "
+            ":SIZE, "
+            ":MTIME"
+        ") "
+        "ON CONFLICT (filepath) DO NOTHING;",
+
     [STMT_UPDATE_BY_FILEPATH] =
         "UPDATE invoices "
         "SET customer_name = :CUSTOMER, "
@@ -71,10 +145,32 @@ const char *S_STMTS_TEXT[STMT_MAX] = {
             "error_flag" " = :ERROR "
         "WHERE invoice_id = :INVOICE_ID;",
 
+    [STMT_DELETE_BY_FILEPATH] =
+        "DELETE FROM invoices "
+        "WHERE filepath = :FILEPATH;",
+
+    /* a range over the unique filepath index, :LOW is the directory with a
+     * trailing seperator, and :HIGH is the same with the seperator bumped 
+     * by one */
+    [STMT_DELETE_BY_DIRECTORY] =
+        "DELETE FROM invoices "
+        "WHERE filepath >= :LOW AND filepath < :HIGH;",
+
+    /* both are ranges over the (customer_name, search_date) index, so the
+     * rows come out in order without a sort */
     [STMT_SELECT_BY_CUSTOMER_NAME] = 
         "SELECT invoice_id, filepath, customer_name, year, month, day, search_date, error_flag "
         "FROM invoices "
-        "WHERE customer_name = :CUSTOMER;",
+        "WHERE customer_name = :CUSTOMER "
+        "ORDER BY search_date;",
+
+    /* :LOW is the prefix, :HIGH the prefix with its last byte bumped by 
+     * one, or an empty blob, which sorts after all text, for no bound */
+    [STMT_SELECT_BY_CUSTOMER_PREFIX] = 
+        "SELECT invoice_id, filepath, customer_name, year, month, day, search_date, error_flag "
+        "FROM invoices "
+        "WHERE customer_name >= :LOW AND customer_name < :HIGH "
+        "ORDER BY customer_name, search_date;",
     
     [STMT_SELECT_BY_FILEPATH] = 
         "SELECT invoice_id, filepath, customer_name, year, month, day, search_date, error_flag "
@@ -85,15 +181,152 @@ const char *S_STMTS_TEXT[STMT_MAX] = {
         "SELECT invoice_id, filepath, customer_name, year, month, day, search_date, error_flag "
         "FROM invoices "
         "WHERE invoice_id = :INVOICE_ID;",
+
+    [STMT_SELECT_FILE_STATS] = 
+        "SELECT filepath, file_dev, file_ino, file_size, file_mtime "
+        "FROM invoices;",
+
+    /* only reads the (search_date, customer_name, filepath) index, 
+     * invoice_id being the rowid is stored in it too. a row in range has
+     * a date, so the rest follows from search_date */
+    [STMT_SELECT_DATE_RANGE] = 
+        "SELECT invoice_id, filepath, customer_name, "
+            "search_date / 10000 AS year, (search_date / 100) % 100 AS month, "
+            "search_date % 100 AS day, search_date, 0 AS error_flag "
+        "FROM invoices "
+        "WHERE search_date BETWEEN :LOW AND :HIGH "
+        "ORDER BY search_date, customer_name;",
+
+    [STMT_BEGIN]    = "BEGIN IMMEDIATE TRANSACTION;",
+    [STMT_COMMIT]   = "COMMIT TRANSACTION;",
+    [STMT_ROLLBACK] = "ROLLBACK TRANSACTION;",
 };
 static sqlite3_stmt *s_stmts[STMT_MAX];
 
+/* s_stmts[] held by an open cursor, see cursor_borrow(). sqlite3_stmt_busy()
+ * cannot tell, it is false until the first step */
+static int s_stmt_borrowed[STMT_MAX];
 
-static int create_tables (sqlite3 *db);
 
-static invoice_t *select_invoice_callback (sqlite3_stmt *stmt);
-static void      *select_invoice_wrapper  (sqlite3_stmt *stmt);
-static int        select_invoice (sqlite3 *db, sqlite3_stmt *stmt, int retry_count, invoice_t **ret_invoice);
+/* the columns decoded into an invoice_t. resolved to result column 
+ * indices once the statements are prepared, so rows are decoded without
+ * looking at the column names */
+typedef enum
+{
+    COL_INVOICE_ID,
+    COL_FILEPATH,
+    COL_CUSTOMER_NAME,
+    COL_SEARCH_DATE,
+    COL_YEAR,
+    COL_MONTH,
+    COL_DAY,
+    COL_ERROR_FLAG,
+    COL_MAX,
+} invoice_column_t;
+
+static const char *S_COLUMN_NAMES[COL_MAX] = {
+    [COL_INVOICE_ID]    = "invoice_id",
+    [COL_FILEPATH]      = "filepath",
+    [COL_CUSTOMER_NAME] = "customer_name",
+    [COL_SEARCH_DATE]   = "search_date",
+    [COL_YEAR]          = "year",
+    [COL_MONTH]         = "month",
+    [COL_DAY]           = "day",
+    [COL_ERROR_FLAG]    = "error_flag",
+};
+
+/* s_stmt_columns[stmt][column] is the result column index, or -1 */
+static int s_stmt_columns[STMT_MAX][COL_MAX];
+
+typedef struct
+{
+    const int *columns;
+    invoice_t *invoice;
+} invoice_decode_t;
+
+typedef struct
+{
+    const int *columns;
+    invoice_view_t *view;
+} view_decode_t;
+
+
+/* a statement stepped by db_cursor_next() and db_cursor_fetch(). ad hoc
+ * queries are prepared for, and owned by, the cursor. searches borrow one
+ * of s_stmts[] */
+struct db_cursor
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    int owned;
+    int stmt_id;                /* index into s_stmts[] if not owned */
+    int status;                 /* last step, SQLITE_ROW until done */
+    int columns[COL_MAX];
+};
+
+
+/* schema migrations, S_MIGRATIONS[i] takes a database from user_version i
+ * to user_version i + 1 */
+static const char *S_MIGRATIONS[] = {
+    /* file metadata, lets a scan skip files that have not changed */
+    "ALTER TABLE invoices ADD COLUMN file_dev INTEGER; "
+    "ALTER TABLE invoices ADD COLUMN file_ino INTEGER; "
+    "ALTER TABLE invoices ADD COLUMN file_size INTEGER; "
+    "ALTER TABLE invoices ADD COLUMN file_mtime INTEGER;",
+
+    /* search_date used to leave out the day, store the full YYYYMMDD and
+     * index it for range scans */
+    "UPDATE invoices SET search_date = "
+        "CASE WHEN error_flag = 0 THEN (year * 10000) + (month * 100) + day END; "
+    "CREATE INDEX IF NOT EXISTS invoices_by_date "
+        "ON invoices (search_date, customer_name);",
+
+    /* customer pages, by name or name prefix, in date order */
+    "CREATE INDEX IF NOT EXISTS invoices_by_customer "
+        "ON invoices (customer_name, search_date);",
+
+    /* date range pages print the filepath, carry it in the date index so
+     * they never read the table */
+    "CREATE INDEX IF NOT EXISTS invoices_by_date_path "
+        "ON invoices (search_date, customer_name, filepath); "
+    "DROP INDEX IF EXISTS invoices_by_date;",
+};
+
+
+/* batched transaction state, see db_batch_*() */
+static struct
+{
+    size_t size;            /* writes per transaction, 0 means autocommit */
+    double max_latency;     /* seconds a write may stay uncommitted */
+
+    int    active;          /* a batch transaction is currently open */
+    size_t pending;         /* writes in the open transaction */
+    double opened_at;       /* time the open transaction was started */
+
+    size_t commits;         /* transactions committed */
+    size_t rows;            /* writes committed */
+    double commit_time;     /* seconds spent in COMMIT */
+    double first_begin;     /* time the first batch was opened */
+} s_batch;
+
+
+static int create_tables (sqlite3 *db);
+static int migrate_tables (sqlite3 *db);
+static int read_version (sqlite3 *db);
+static int prepare_statements (sqlite3 *db);
+static int bind_file_stat (sqlite3 *db, sqlite3_stmt *stmt, const file_stat_t *stat);
+static int bind_invoice_values (sqlite3 *db, sqlite3_stmt *stmt, char *filepath, char *customer_name, int year, int month, int day);
+static int execute_simple (sqlite3 *db, int stmt_id);
+static double now_seconds (void);
+
+static int decode_int (sqlite3_stmt *stmt, int i, int nullable, int *out);
+static int decode_text (sqlite3_stmt *stmt, int i, char *out, size_t size);
+static int decode_text_view (sqlite3_stmt *stmt, int i, db_text_t *out);
+static int select_invoice_decode (sqlite3_stmt *stmt, void *out);
+static int select_view_decode (sqlite3_stmt *stmt, void *out);
+static db_cursor_t *cursor_borrow (sqlite3 *db, int stmt_id);
+static int cursor_step (db_cursor_t *cursor, int (*decode)(sqlite3_stmt *, void *), void *out);
+static int select_invoice (sqlite3 *db, int stmt_id, int retry_count, invoice_t *ret_invoice);
 
 
 sqlite3 *
@@ -113,9 +346,16 @@ db_init (const char *dbfile, int dryrun)
      * prepare many statements */
     create_tables (db);
 
+    /* bring older databases up to date */
+    if (migrate_tables (db))
+    {
+        sqlwrap_close (db);
+        db = NULL;
+        return NULL;
+    }
+
     /* prepare statements */
-    /* memset (s_stmts, 0, STMT_MAX * sizeof (sqlite3_stmt *)); */
-    if (sqlwrap_prepare_n (db, S_STMTS_TEXT, s_stmts, STMT_MAX) != STMT_MAX)
+    if (prepare_statements (db))
     {
         sqlwrap_close (db);
         db = NULL;
@@ -126,13 +366,55 @@ db_init (const char *dbfile, int dryrun)
 }
 
 
+/* open dbfile to read only, in place, so memory use does not grow with 
+ * the database. one older than this program cannot be migrated in place,
+ * and is read from a migrated in memory copy instead, as with dryrun */
+sqlite3 *
+db_open_readonly (const char *dbfile)
+{
+    sqlite3 *db = NULL;
+    int version;
+
+    db = sqlwrap_open (dbfile, SQLITE_OPEN_READONLY);
+    if (db == NULL) return NULL;
+
+    version = read_version (db);
+    if (version < 0)
+    {
+        sqlwrap_close (db);
+        return NULL;
+    }
+
+    if (version != (int)LEN (S_MIGRATIONS))
+    {
+        log_verbose ("Database version %d needs migrating, reading a copy\n",
+                     version);
+        sqlwrap_close (db);
+        return db_init (dbfile, 1);
+    }
+
+    /* statements that write are prepared too, they fail if stepped */
+    if (prepare_statements (db))
+    {
+        sqlwrap_close (db);
+        return NULL;
+    }
+
+    return db;
+}
+
+
 void 
 db_quit (sqlite3 *db)
 {
     if (db == NULL) return;
 
+    /* commit anything left in an open batch */
+    (void)db_batch_flush (db);
+
     /* finalize all prepared statements */
     sqlwrap_finalize_n (s_stmts, STMT_MAX);
+    memset (s_stmt_borrowed, 0, sizeof (s_stmt_borrowed));
 
     /* close the database */
     (void)sqlwrap_close (db);
@@ -165,6 +447,88 @@ create_tables (sqlite3 *db)
 }
 
 
+static int
+migrate_tables (sqlite3 *db)
+{
+    const int LATEST = (int)LEN (S_MIGRATIONS);
+    int version = 0;
+    char set_version[64];
+
+    version = read_version (db);
+    if (version < 0) return 1;
+
+    if (version > LATEST)
+    {
+        log_error ("Database version %d is newer than this program (%d)\n",
+                   version, LATEST);
+        return 1;
+    }
+
+    for (; version < LATEST; version++)
+    {
+        log_verbose ("Migrating database to version %d\n", version + 1);
+
+        (void)snprintf (set_version, sizeof (set_version), 
+                        "PRAGMA user_version = %d;", version + 1);
+
+        if ((sqlite3_exec (db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK) ||
+            (sqlite3_exec (db, S_MIGRATIONS[version], NULL, NULL, NULL) != SQLITE_OK) ||
+            (sqlite3_exec (db, set_version, NULL, NULL, NULL) != SQLITE_OK) ||
+            (sqlite3_exec (db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK))
+        {
+            sqlwrap_log_error (db);
+            log_error ("Failed to migrate database to version %d\n", 
+                       version + 1);
+            (void)sqlite3_exec (db, "ROLLBACK;", NULL, NULL, NULL);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* the user_version of db, or -1 on error */
+static int
+read_version (sqlite3 *db)
+{
+    sqlite3_stmt *stmt = NULL;
+    int version = 0;
+
+    if (sqlite3_prepare_v2 (db, "PRAGMA user_version;", -1, &stmt, NULL) 
+            != SQLITE_OK)
+    {
+        sqlwrap_log_error (db);
+        log_error ("Failed to read the database version\n");
+        return -1;
+    }
+    if (sqlite3_step (stmt) == SQLITE_ROW) version = sqlite3_column_int (stmt, 0);
+    (void)sqlite3_finalize (stmt);
+
+    return version;
+}
+
+
+/* prepare s_stmts[] and map their result columns for decoding. returns 
+ * non zero on error */
+static int
+prepare_statements (sqlite3 *db)
+{
+    if (sqlwrap_prepare_n (db, S_STMTS_TEXT, s_stmts, STMT_MAX) != STMT_MAX)
+    {
+        return 1;
+    }
+
+    for (size_t i = 0; i < STMT_MAX; i++)
+    {
+        (void)sqlwrap_column_map (s_stmts[i], S_COLUMN_NAMES, 
+                                  s_stmt_columns[i], COL_MAX);
+    }
+
+    return 0;
+}
+
+
 int 
 db_insert (sqlite3 *db, char *filepath, char *customer_name, 
            int year, int month, int day)
@@ -173,25 +537,9 @@ db_insert (sqlite3 *db, char *filepath, char *customer_name,
 
     sqlite3_stmt *stmt = s_stmts[STMT_INSERT];
 
-    int date = date_format_int_atoz (year, month, day);
-    int error_flag = ((day == 0) || (month == 0) || (year == 0));
-
-#pragma warning( push )
-#pragma warning( disable : 4047 4024)
-    int ret_filepath = SQLWRAP_BIND_NAME (stmt, ":FILEPATH", filepath);
-    int ret_customer = SQLWRAP_BIND_NAME (stmt, ":CUSTOMER", customer_name);
-    int ret_error    = SQLWRAP_BIND_NAME (stmt, ":ERROR", error_flag);
-    int ret_year     = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":YEAR",  year);
-    int ret_month    = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":MONTH", month);
-    int ret_day      = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":DAY",   day);
-    int ret_date     = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":DATE",  date);
-#pragma warning( pop )
-
-    if (SQLITE_OK != (ret_filepath | ret_customer | ret_year | ret_month
-                      | ret_day | ret_date | ret_error))
+    if (bind_invoice_values (db, stmt, filepath, customer_name, 
+                             year, month, day))
     {
-        sqlwrap_log_error (db);
-        log_error ("SQLite3: failed to bind value\n");
         goto database_insert_invoice_exit;
     }
 
@@ -217,25 +565,9 @@ db_update_by_file (sqlite3 *db, char *filepath, char *customer_name,
 
     sqlite3_stmt *stmt = s_stmts[STMT_UPDATE_BY_FILEPATH];
 
-    int date = date_format_int_atoz (year, month, day);
-    int error_flag = ((day == 0) || (month == 0) || (year == 0));
-
-#pragma warning( push )
-#pragma warning( disable : 4047 4024)
-    int ret_filepath = SQLWRAP_BIND_NAME (stmt, ":FILEPATH", filepath);
-    int ret_customer = SQLWRAP_BIND_NAME (stmt, ":CUSTOMER", customer_name);
-    int ret_error    = SQLWRAP_BIND_NAME (stmt, ":ERROR", error_flag);
-    int ret_year     = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":YEAR",  year);
-    int ret_month    = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":MONTH", month);
-    int ret_day      = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":DAY",   day);
-    int ret_date     = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":DATE",  date);
-#pragma warning( pop )
-
-    if (SQLITE_OK != (ret_filepath | ret_customer | ret_year | ret_month
-                      | ret_day | ret_date | ret_error))
+    if (bind_invoice_values (db, stmt, filepath, customer_name, 
+                             year, month, day))
     {
-        sqlwrap_log_error (db);
-        log_error ("SQLite3: failed to bind value\n");
         goto database_update_invoice_exit;
     }
 
@@ -253,206 +585,919 @@ database_update_invoice_exit:
 }
 
 
-/* return true if an entry is found.
- * return false otherwise.
- * 
- * optionally, if ret_invoice is NOT NULL, the found entry is returned returned
- * through the pointer, if not entry is found, a NULL is returned. 
- * 
- * said entry is static. its contents are guaranteed only until the next call 
- * to select_invoice_callback() (or any function that calls such) */
-int 
-db_search_by_file (sqlite3 *db, char *filepath, invoice_t **ret_invoice)
+/* remove the entry for filepath, returns the number of rows deleted, or 
+ * -1 on error */
+int
+db_delete_by_file (sqlite3 *db, char *filepath)
 {
-    int retcode = 0;
-    invoice_t *result = NULL;
+    int retcode = -1;
+    int ret_filepath;
 
-    sqlite3_stmt *stmt = s_stmts[STMT_SELECT_BY_FILEPATH];
+    sqlite3_stmt *stmt = s_stmts[STMT_DELETE_BY_FILEPATH];
 
 #pragma warning( push )
 #pragma warning( disable : 4047 4024)
-   if (SQLITE_OK != SQLWRAP_BIND_NAME (stmt, ":FILEPATH", filepath))
-   {
+    ret_filepath = SQLWRAP_BIND_NAME (stmt, ":FILEPATH", filepath);
+#pragma warning( pop )
+
+    if (ret_filepath != SQLITE_OK)
+    {
         sqlwrap_log_error (db);
         log_error ("SQLite3: failed to bind value\n");
-        goto database_search_by_file_exit;
+        goto database_delete_file_exit;
     }
-#pragma warning( pop)
 
-    int sqlite_ret = select_invoice (db, stmt, 3, &result);
-    retcode = (sqlite_ret == SQLITE_ROW);
+    if (sqlwrap_execute (db, stmt, 3, NULL, NULL) != SQLITE_DONE)
+    {
+        sqlwrap_log_error (db);
+        log_error ("SQLite3: execution failed\n");
+        goto database_delete_file_exit;
+    } 
 
-database_search_by_file_exit:
+    retcode = sqlite3_changes (db);
+database_delete_file_exit:
     (void)sqlite3_reset (stmt);
-
-    if (ret_invoice) *ret_invoice = result;
     return retcode;
 }
 
 
-/* return true if an entry is found.
- * return false otherwise.
- * 
- * optionally, if ret_invoice is NOT NULL, the found entry is returned returned
- * through the pointer, if not entry is found, a NULL is returned. 
- * 
- * said entry is static. its contents are guaranteed only until the next call 
- * to select_invoice_callback() (or any function that calls such) */
-int 
-db_search_by_id (sqlite3 *db, int invoice_id, invoice_t **ret_invoice)
+/* remove every entry under directory, returns the number of rows deleted,
+ * or -1 on error */
+int
+db_delete_by_directory (sqlite3 *db, char *directory, char seperator)
 {
-    int retcode = 0;
-    invoice_t *result = NULL;
-    sqlite3_stmt *stmt = s_stmts[STMT_SELECT_BY_INVOICE_ID];
+    int retcode = -1;
+    int ret_low, ret_high;
+    size_t length = strlen (directory);
+    char *low = NULL;
+    char *high = NULL;
+
+    sqlite3_stmt *stmt = s_stmts[STMT_DELETE_BY_DIRECTORY];
+
+    /* drop any trailing seperator, it is added back below */
+    if ((length > 0) && (directory[length - 1] == seperator)) length--;
+
+    low  = malloc (length + 2);
+    high = malloc (length + 2);
+    if ((low == NULL) || (high == NULL))
+    {
+        log_error ("out of memory\n");
+        goto database_delete_directory_exit;
+    }
+
+    memcpy (low, directory, length);
+    memcpy (high, directory, length);
+    low[length]  = seperator;
+    high[length] = (char)(seperator + 1);
+    low[length + 1]  = '\0';
+    high[length + 1] = '\0';
 
 #pragma warning( push )
 #pragma warning( disable : 4047 4024)
-   if (SQLITE_OK != SQLWRAP_BIND_NAME (stmt, ":INVOICE_ID", invoice_id))
-   {
+    ret_low  = SQLWRAP_BIND_NAME (stmt, ":LOW",  low);
+    ret_high = SQLWRAP_BIND_NAME (stmt, ":HIGH", high);
+#pragma warning( pop )
+
+    if (SQLITE_OK != (ret_low | ret_high))
+    {
         sqlwrap_log_error (db);
         log_error ("SQLite3: failed to bind value\n");
-        goto database_search_by_id_exit;
+        goto database_delete_directory_exit;
     }
-#pragma warning( pop)
 
-    int sqlite_ret = select_invoice (db, stmt, 3, &result);
-    retcode = (sqlite_ret == SQLITE_ROW);
+    if (sqlwrap_execute (db, stmt, 3, NULL, NULL) != SQLITE_DONE)
+    {
+        sqlwrap_log_error (db);
+        log_error ("SQLite3: execution failed\n");
+        goto database_delete_directory_exit;
+    } 
 
-database_search_by_id_exit:
+    retcode = sqlite3_changes (db);
+database_delete_directory_exit:
     (void)sqlite3_reset (stmt);
-
-    if (ret_invoice) *ret_invoice = result;
+    free (low);  low = NULL;
+    free (high); high = NULL;
     return retcode;
 }
 
 
-static invoice_t *
-select_invoice_callback (sqlite3_stmt *stmt)
+/* insert or update an invoice in a single statement.
+ *
+ * rows whose stored values already match are left untouched, and are
+ * reported as DB_UPSERT_UNCHANGED. if keep_existing is set, rows that 
+ * already exist are never modified. stat may be NULL, in which case any 
+ * stored file metadata is kept as is. */
+db_upsert_t
+db_upsert (sqlite3 *db, char *filepath, char *customer_name, 
+           int year, int month, int day, const file_stat_t *stat,
+           int keep_existing)
 {
-    static column_t column;
-    static invoice_t s;
-        
-    int found_invoice_id = 0;
-    int found_customer_name = 0;
-    int found_filepath = 0;
-    int found_date = 0;
-    int found_year = 0;
-    int found_month = 0;
-    int found_day = 0;
-    int found_error_flag = 0;
+    db_upsert_t result = DB_UPSERT_ERROR;
 
-    int column_count = sqlite3_column_count (stmt);
+    int stmt_id = (keep_existing ? STMT_INSERT_OR_IGNORE : STMT_UPSERT);
+    sqlite3_stmt *stmt = s_stmts[stmt_id];
 
-    int INTEGER[]        = { SQLITE_INTEGER, SQLITE_NULL };
-    int INTEGER_STRICT[] = { SQLITE_INTEGER };
-    int TEXT_STRICT[]    = { SQLITE_TEXT };
-
-    for (int i = 0; i < column_count; i++)
+    if ((bind_invoice_values (db, stmt, filepath, customer_name, 
+                              year, month, day)) ||
+        (bind_file_stat (db, stmt, stat)))
     {
-        column = column_get (stmt, i);
-
-        if ((found_invoice_id) || (strcmp (column.name, "invoice_id") == 0))
-        {
-            found_invoice_id = 1;
-            if (column_match_type (column, INTEGER_STRICT, LEN(INTEGER_STRICT))) 
-            {
-                return NULL;
-            }
-
-            s.invoice_id = column.m.i;
-        }
-        else if ((found_filepath) || (strcmp (column.name, "filepath") == 0))
-        {
-            found_filepath = 1;
-            if (column_match_type (column, TEXT_STRICT, LEN(TEXT_STRICT))) 
-            {
-                return NULL;
-            }
-            
-            (void)strncpy_s (s.filepath, MY_MAX_PATH, column.m.s, column.bytes);
-        }
-        else if ((found_customer_name) || (strcmp (column.name, "customer_name") == 0))
-        {
-            found_customer_name = 1;
-            if (column_match_type (column, TEXT_STRICT, LEN(TEXT_STRICT))) 
-            {
-                return NULL;
-            }
-
-            (void)strncpy_s (s.customer_name, MY_MAX_PATH, column.m.s, column.bytes);
-        }
-        else if ((found_date) || (strcmp (column.name, "date") == 0))
-        {
-            found_date = 1;
-            if (column_match_type (column, INTEGER, LEN(INTEGER))) 
-            {
-                return NULL;
-            }
-
-            s.date = (column.type == SQLITE_NULL ? 0 : column.m.i);
-        }
-        else if ((found_year) || (strcmp (column.name, "year") == 0))
-        {
-            found_year = 1;
-            if (column_match_type (column, INTEGER, LEN(INTEGER))) 
-            {
-                return NULL;
-            }
-
-            s.year = (column.type == SQLITE_NULL ? 0 : column.m.i);
-        }
-        else if ((found_month) || (strcmp (column.name, "month") == 0))
-        {
-            found_month = 1;
-            if (column_match_type (column, INTEGER, LEN(INTEGER))) 
-            {
-                return NULL;
-            }
-
-            s.month = (column.type == SQLITE_NULL ? 0 : column.m.i);
-        }
-        else if ((found_day) || (strcmp (column.name, "day") == 0))
-        {
-            found_day = 1;
-            if (column_match_type (column, INTEGER, LEN(INTEGER))) 
-            {
-                return NULL;
-            }
-
-            s.day = (column.type == SQLITE_NULL ? 0 : column.m.i);
-        }
-        else if ((found_error_flag) || (strcmp (column.name, "error_flag") == 0))
-        {
-            found_error_flag = 1;
-            if (column_match_type (column, INTEGER_STRICT, LEN(INTEGER_STRICT))) 
-            {
-                return NULL;
-            }
-
-            s.error_flag = column.m.i;    
-        }
-        else
-        {
-            log_error ("SQLite3: Unknown column name '%s'\n", column.name);
-        }
+        goto database_upsert_invoice_exit;
     }
 
-    return &s;
-}
+    /* an update through ON CONFLICT does not touch the last insert rowid,
+     * clearing it first tells an insert apart from an update */
+    sqlite3_set_last_insert_rowid (db, 0);
 
+    if (sqlwrap_execute (db, stmt, 3, NULL, NULL) != SQLITE_DONE)
+    {
+        sqlwrap_log_error (db);
+        log_error ("SQLite3: execution failed\n");
+        goto database_upsert_invoice_exit;
+    } 
 
-static void *
-select_invoice_wrapper (sqlite3_stmt *stmt)
-{
-    return (void *)select_invoice_callback (stmt);
+    if (sqlite3_changes (db) == 0)           result = DB_UPSERT_UNCHANGED;
+    else if (sqlite3_last_insert_rowid (db)) result = DB_UPSERT_INSERTED;
+    else                                     result = DB_UPSERT_UPDATED;
+
+database_upsert_invoice_exit:
+    (void)sqlite3_reset (stmt);
+    return result;
 }
 
 
 static int
-select_invoice (sqlite3 *db, sqlite3_stmt *stmt, int retry_count, 
-                invoice_t **ret_invoice)
+bind_invoice_values (sqlite3 *db, sqlite3_stmt *stmt, char *filepath, 
+                     char *customer_name, int year, int month, int day)
 {
-    return sqlwrap_execute (db, stmt, retry_count, ret_invoice, select_invoice_wrapper);
+    int error_flag = ((day == 0) || (month == 0) || (year == 0));
+    int date = (error_flag ? 0 : date_format_int_atoz (year, month, day));
+
+#pragma warning( push )
+#pragma warning( disable : 4047 4024)
+    int ret_filepath = SQLWRAP_BIND_NAME (stmt, ":FILEPATH", filepath);
+    int ret_customer = SQLWRAP_BIND_NAME (stmt, ":CUSTOMER", customer_name);
+    int ret_error    = SQLWRAP_BIND_NAME (stmt, ":ERROR", error_flag);
+    int ret_year     = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":YEAR",  year);
+    int ret_month    = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":MONTH", month);
+    int ret_day      = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":DAY",   day);
+    int ret_date     = SQLWRAP_BIND_NAME_OR_NULL (stmt, ":DATE",  date);
+#pragma warning( pop )
+
+    if (SQLITE_OK != (ret_filepath | ret_customer | ret_year | ret_month
+                      | ret_day | ret_date | ret_error))
+    {
+        sqlwrap_log_error (db);
+        log_error ("SQLite3: failed to bind value\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int
+bind_file_stat (sqlite3 *db, sqlite3_stmt *stmt, const file_stat_t *stat)
+{
+    int ret_dev, ret_ino, ret_size, ret_mtime;
+
+#pragma warning( push )
+#pragma warning( disable : 4047 4024)
+    if (stat == NULL)
+    {
+        ret_dev   = SQLWRAP_BIND_NAME (stmt, ":DEV",   NULL);
+        ret_ino   = SQLWRAP_BIND_NAME (stmt, ":INO",   NULL);
+        ret_size  = SQLWRAP_BIND_NAME (stmt, ":SIZE",  NULL);
+        ret_mtime = SQLWRAP_BIND_NAME (stmt, ":MTIME", NULL);
+    }
+    else
+    {
+        ret_dev   = SQLWRAP_BIND_NAME (stmt, ":DEV",   stat->dev);
+        ret_ino   = SQLWRAP_BIND_NAME (stmt, ":INO",   stat->ino);
+        ret_size  = SQLWRAP_BIND_NAME (stmt, ":SIZE",  stat->size);
+        ret_mtime = SQLWRAP_BIND_NAME (stmt, ":MTIME", stat->mtime);
+    }
+#pragma warning( pop )
+
+    if (SQLITE_OK != (ret_dev | ret_ino | ret_size | ret_mtime))
+    {
+        sqlwrap_log_error (db);
+        log_error ("SQLite3: failed to bind value\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/* call back once for every stored file, with its metadata or NULL if none
+ * has been recorded. stops early, returning 1, if callback returns non 
+ * zero */
+int
+db_foreach_file_stat (sqlite3 *db, 
+        int (*callback)(const char *filepath, const file_stat_t *stat, void *user),
+        void *user)
+{
+    int retcode = 0;
+    int sqlite_ret;
+    file_stat_t stat;
+    sqlite3_stmt *stmt = s_stmts[STMT_SELECT_FILE_STATS];
+
+    while ((sqlite_ret = sqlwrap_execute (db, stmt, 3, NULL, NULL)) == SQLITE_ROW)
+    {
+        const char *filepath = (const char *)sqlite3_column_text (stmt, 0);
+        int has_stat = (sqlite3_column_type (stmt, 4) != SQLITE_NULL);
+
+        stat.dev   = sqlite3_column_int64 (stmt, 1);
+        stat.ino   = sqlite3_column_int64 (stmt, 2);
+        stat.size  = sqlite3_column_int64 (stmt, 3);
+        stat.mtime = sqlite3_column_int64 (stmt, 4);
+
+        if (callback (filepath, (has_stat ? &stat : NULL), user))
+        {
+            retcode = 1;
+            break;
+        }
+    }
+
+    if ((retcode == 0) && (sqlite_ret != SQLITE_DONE))
+    {
+        log_error ("SQLite3: failed to read file metadata\n");
+        retcode = 1;
+    }
+
+    (void)sqlite3_reset (stmt);
+    return retcode;
+}
+
+
+/* return true if an entry is found.
+ * return false otherwise.
+ * 
+ * optionally, if ret_invoice is NOT NULL, the found entry is returned returned
+ * through the pointer, if not entry is found, a NULL is returned. 
+ * 
+ * said entry is static. its contents are guaranteed only until the next call 
+ * to db_search_by_file() or db_search_by_id(). use db_search_by_file_r() 
+ * to decode into memory of your own */
+int 
+db_search_by_file (sqlite3 *db, char *filepath, invoice_t **ret_invoice)
+{
+    static invoice_t s_invoice;
+
+    int found = db_search_by_file_r (db, filepath, 
+                                     (ret_invoice ? &s_invoice : NULL));
+
+    if (ret_invoice) *ret_invoice = (found ? &s_invoice : NULL);
+    return found;
+}
+
+
+/* return true if an entry is found, and decoded into ret_invoice if it is
+ * NOT NULL. return false otherwise. */
+int 
+db_search_by_file_r (sqlite3 *db, char *filepath, invoice_t *ret_invoice)
+{
+    int retcode = 0;
+
+    sqlite3_stmt *stmt = s_stmts[STMT_SELECT_BY_FILEPATH];
+
+#pragma warning( push )
+#pragma warning( disable : 4047 4024)
+   if (SQLITE_OK != SQLWRAP_BIND_NAME (stmt, ":FILEPATH", filepath))
+   {
+        sqlwrap_log_error (db);
+        log_error ("SQLite3: failed to bind value\n");
+        goto database_search_by_file_exit;
+    }
+#pragma warning( pop)
+
+    int sqlite_ret = select_invoice (db, STMT_SELECT_BY_FILEPATH, 3, ret_invoice);
+    retcode = (sqlite_ret == SQLITE_ROW);
+
+database_search_by_file_exit:
+    (void)sqlite3_reset (stmt);
+
+    return retcode;
+}
+
+
+/* return true if an entry is found.
+ * return false otherwise.
+ * 
+ * optionally, if ret_invoice is NOT NULL, the found entry is returned returned
+ * through the pointer, if not entry is found, a NULL is returned. 
+ * 
+ * said entry is static. its contents are guaranteed only until the next call 
+ * to db_search_by_file() or db_search_by_id(). use db_search_by_id_r() 
+ * to decode into memory of your own */
+int 
+db_search_by_id (sqlite3 *db, int invoice_id, invoice_t **ret_invoice)
+{
+    static invoice_t s_invoice;
+
+    int found = db_search_by_id_r (db, invoice_id, 
+                                   (ret_invoice ? &s_invoice : NULL));
+
+    if (ret_invoice) *ret_invoice = (found ? &s_invoice : NULL);
+    return found;
+}
+
+
+/* return true if an entry is found, and decoded into ret_invoice if it is
+ * NOT NULL. return false otherwise. */
+int 
+db_search_by_id_r (sqlite3 *db, int invoice_id, invoice_t *ret_invoice)
+{
+    int retcode = 0;
+    sqlite3_stmt *stmt = s_stmts[STMT_SELECT_BY_INVOICE_ID];
+
+#pragma warning( push )
+#pragma warning( disable : 4047 4024)
+   if (SQLITE_OK != SQLWRAP_BIND_NAME (stmt, ":INVOICE_ID", invoice_id))
+   {
+        sqlwrap_log_error (db);
+        log_error ("SQLite3: failed to bind value\n");
+        goto database_search_by_id_exit;
+    }
+#pragma warning( pop)
+
+    int sqlite_ret = select_invoice (db, STMT_SELECT_BY_INVOICE_ID, 3, ret_invoice);
+    retcode = (sqlite_ret == SQLITE_ROW);
+
+database_search_by_id_exit:
+    (void)sqlite3_reset (stmt);
+
+    return retcode;
+}
+
+
+/* cursors
+ *
+ *   db_cursor_t *cursor = db_cursor_open (db, "SELECT * FROM invoices;");
+ *   while ((count = db_cursor_fetch (cursor, invoices, LEN (invoices))) > 0)
+ *   {
+ *       ...
+ *   }
+ *   db_cursor_close (cursor);
+ *
+ * rows are stepped out of SQLite as they are asked for, never the whole
+ * result set at once. columns of the query that are not invoice columns
+ * are ignored, invoice columns it leaves out are zeroed. 
+ *
+ * db_cursor_next_view() skips the copies, the view points into the row
+ * until the next step. */
+db_cursor_t *
+db_cursor_open (sqlite3 *db, const char *query)
+{
+    db_cursor_t *cursor = NULL;
+    const char *texts[] = { query };
+
+    cursor = malloc (sizeof (*cursor));
+    if (cursor == NULL)
+    {
+        log_error ("cannot allocate a database cursor\n");
+        return NULL;
+    }
+
+    if (sqlwrap_prepare_n (db, texts, &cursor->stmt, 1) != 1)
+    {
+        log_error ("SQLite3: cannot prepare query: '%s'\n", query);
+        free (cursor); cursor = NULL;
+        return NULL;
+    }
+
+    cursor->db     = db;
+    cursor->owned  = 1;
+    cursor->stmt_id = -1;
+    cursor->status = SQLITE_ROW;
+    (void)sqlwrap_column_map (cursor->stmt, S_COLUMN_NAMES, 
+                              cursor->columns, COL_MAX);
+
+    return cursor;
+}
+
+
+/* decode the next row into ret_invoice. return 1 for a row, 0 once there
+ * are no more, and -1 on error */
+int
+db_cursor_next (db_cursor_t *cursor, invoice_t *ret_invoice)
+{
+    invoice_decode_t decode = { cursor->columns, ret_invoice };
+
+    return cursor_step (cursor, select_invoice_decode, &decode);
+}
+
+
+/* like db_cursor_next(), but without copying the text out of the row */
+int
+db_cursor_next_view (db_cursor_t *cursor, invoice_view_t *ret_view)
+{
+    view_decode_t decode = { cursor->columns, ret_view };
+
+    return cursor_step (cursor, select_view_decode, &decode);
+}
+
+
+/* decode up to n rows into invoices. returns how many, 0 once there are no
+ * more, and -1 on error. rows read before an error are returned first */
+long
+db_cursor_fetch (db_cursor_t *cursor, invoice_t *invoices, size_t n)
+{
+    size_t count = 0;
+    int ret = 0;
+
+    while ((count < n) && ((ret = db_cursor_next (cursor, &invoices[count])) == 1))
+    {
+        count++;
+    }
+
+    if ((count == 0) && (ret < 0)) return -1;
+    return (long)count;
+}
+
+
+void
+db_cursor_close (db_cursor_t *cursor)
+{
+    if (cursor == NULL) return;
+
+    if (cursor->owned) 
+    {
+        sqlwrap_finalize_n (&cursor->stmt, 1);
+    }
+    else
+    {
+        (void)sqlite3_reset (cursor->stmt);
+        (void)sqlite3_clear_bindings (cursor->stmt);
+        s_stmt_borrowed[cursor->stmt_id] = 0;
+    }
+
+    free (cursor); cursor = NULL;
+
+    return;
+}
+
+
+/* a cursor over every invoice of customer_name, in date order. the search
+ * shares its statement, only one may be open at a time */
+db_cursor_t *
+db_search_by_customer (sqlite3 *db, const char *customer_name)
+{
+    db_cursor_t *cursor = cursor_borrow (db, STMT_SELECT_BY_CUSTOMER_NAME);
+    sqlite3_stmt *stmt = NULL;
+
+    if (cursor == NULL) return NULL;
+    stmt = cursor->stmt;
+
+    if (SQLITE_OK != sqlite3_bind_text (stmt, 
+                        sqlite3_bind_parameter_index (stmt, ":CUSTOMER"),
+                        customer_name, -1, SQLITE_TRANSIENT))
+    {
+        sqlwrap_log_error (db);
+        log_error ("SQLite3: failed to bind value\n");
+        db_cursor_close (cursor); cursor = NULL;
+        return NULL;
+    }
+
+    return cursor;
+}
+
+
+/* a cursor over every invoice of a customer whose name starts with 
+ * prefix, ordered by name then date. the search shares its statement, 
+ * only one may be open at a time */
+db_cursor_t *
+db_search_by_customer_prefix (sqlite3 *db, const char *prefix)
+{
+    db_cursor_t *cursor = cursor_borrow (db, STMT_SELECT_BY_CUSTOMER_PREFIX);
+    sqlite3_stmt *stmt = NULL;
+    size_t length = strlen (prefix);
+    int ret_low, ret_high;
+    int high_index;
+
+    if (cursor == NULL) return NULL;
+    stmt = cursor->stmt;
+
+    /* bytes of 0xff can not be bumped, drop them and bump the one before */
+    while ((length > 0) && ((unsigned char)prefix[length - 1] == 0xff)) length--;
+
+    ret_low = sqlite3_bind_text (stmt, 
+                  sqlite3_bind_parameter_index (stmt, ":LOW"),
+                  prefix, -1, SQLITE_TRANSIENT);
+
+    high_index = sqlite3_bind_parameter_index (stmt, ":HIGH");
+    if (length == 0)
+    {
+        ret_high = sqlite3_bind_zeroblob (stmt, high_index, 0);
+    }
+    else
+    {
+        /* SQLite takes its own copy of the bound before returning */
+        char *high = malloc (length);
+        if (high == NULL)
+        {
+            log_error ("out of memory\n");
+            db_cursor_close (cursor); cursor = NULL;
+            return NULL;
+        }
+
+        memcpy (high, prefix, length);
+        high[length - 1] = (char)((unsigned char)high[length - 1] + 1);
+        ret_high = sqlite3_bind_text (stmt, high_index, high, (int)length, 
+                                      SQLITE_TRANSIENT);
+        free (high); high = NULL;
+    }
+
+    if (SQLITE_OK != (ret_low | ret_high))
+    {
+        sqlwrap_log_error (db);
+        log_error ("SQLite3: failed to bind value\n");
+        db_cursor_close (cursor); cursor = NULL;
+        return NULL;
+    }
+
+    return cursor;
+}
+
+
+/* a cursor over every invoice dated from low to high inclusive, both 
+ * YYYYMMDD as from date_format_int_atoz(), ordered by date then customer.
+ * the search shares its statement, only one may be open at a time */
+db_cursor_t *
+db_search_by_date_range (sqlite3 *db, int low, int high)
+{
+    db_cursor_t *cursor = cursor_borrow (db, STMT_SELECT_DATE_RANGE);
+    sqlite3_stmt *stmt = NULL;
+    int ret_low, ret_high;
+
+    if (cursor == NULL) return NULL;
+    stmt = cursor->stmt;
+
+    ret_low  = sqlite3_bind_int (stmt, 
+                   sqlite3_bind_parameter_index (stmt, ":LOW"), low);
+    ret_high = sqlite3_bind_int (stmt, 
+                   sqlite3_bind_parameter_index (stmt, ":HIGH"), high);
+
+    if (SQLITE_OK != (ret_low | ret_high))
+    {
+        sqlwrap_log_error (db);
+        log_error ("SQLite3: failed to bind value\n");
+        db_cursor_close (cursor); cursor = NULL;
+        return NULL;
+    }
+
+    return cursor;
+}
+
+
+/* a cursor over one of s_stmts[], left prepared when closed */
+static db_cursor_t *
+cursor_borrow (sqlite3 *db, int stmt_id)
+{
+    db_cursor_t *cursor = NULL;
+    sqlite3_stmt *stmt = s_stmts[stmt_id];
+
+    if (s_stmt_borrowed[stmt_id] || sqlite3_stmt_busy (stmt))
+    {
+        log_error ("SQLite3: statement is already in use by a cursor\n");
+        return NULL;
+    }
+
+    cursor = malloc (sizeof (*cursor));
+    if (cursor == NULL)
+    {
+        log_error ("cannot allocate a database cursor\n");
+        return NULL;
+    }
+
+    cursor->db     = db;
+    cursor->stmt   = stmt;
+    cursor->owned  = 0;
+    cursor->stmt_id = stmt_id;
+    cursor->status = SQLITE_ROW;
+    memcpy (cursor->columns, s_stmt_columns[stmt_id], sizeof (cursor->columns));
+
+    s_stmt_borrowed[stmt_id] = 1;
+
+    return cursor;
+}
+
+
+static int
+cursor_step (db_cursor_t *cursor, int (*decode)(sqlite3_stmt *, void *), 
+             void *out)
+{
+    if (cursor->status != SQLITE_ROW) 
+    {
+        return (cursor->status == SQLITE_DONE ? 0 : -1);
+    }
+
+    cursor->status = sqlwrap_execute_into (cursor->db, cursor->stmt, 3, 
+                                           decode, out);
+
+    switch (cursor->status)
+    {
+    case SQLITE_ROW:  return 1;
+    case SQLITE_DONE: return 0;
+    default:          return -1;
+    }
+}
+
+
+/* copy the text of view into arena, and point view at the copies. they 
+ * are terminated, and last as long as the arena. return non zero if out of
+ * memory */
+int
+db_view_materialize (invoice_view_t *view, arena_t *arena)
+{
+    char *filepath;
+    char *customer_name;
+
+    filepath = arena_strndup (arena, view->filepath.ptr, view->filepath.length);
+    customer_name = arena_strndup (arena, view->customer_name.ptr, 
+                                   view->customer_name.length);
+    if ((filepath == NULL) || (customer_name == NULL)) return 1;
+
+    view->filepath.ptr      = filepath;
+    view->customer_name.ptr = customer_name;
+
+    return 0;
+}
+
+
+/* column i of the current row, 0 if the statement does not
+ * return it (i is -1). return 0 on success */
+static int
+decode_int (sqlite3_stmt *stmt, int i, int nullable, int *out)
+{
+    if (i < 0) { *out = 0; return 0; }
+    if (!column_check_type (stmt, i, SQLITE_INTEGER, nullable)) return 1;
+
+    /* NULL reads as 0 */
+    *out = sqlite3_column_int (stmt, i);
+    return 0;
+}
+
+
+static int
+decode_text (sqlite3_stmt *stmt, int i, char *out, size_t size)
+{
+    const char *text;
+    size_t bytes;
+
+    if (i < 0) { *out = '\0'; return 0; }
+    if (!column_check_type (stmt, i, SQLITE_TEXT, 0)) return 1;
+
+    text  = (const char *)sqlite3_column_text (stmt, i);
+    bytes = (size_t)sqlite3_column_bytes (stmt, i);
+    (void)strncpy_s (out, size, text, bytes);
+    return 0;
+}
+
+
+static int
+decode_text_view (sqlite3_stmt *stmt, int i, db_text_t *out)
+{
+    if (i < 0) { out->ptr = ""; out->length = 0; return 0; }
+    if (!column_check_type (stmt, i, SQLITE_TEXT, 0)) return 1;
+
+    out->ptr    = (const char *)sqlite3_column_text (stmt, i);
+    out->length = (size_t)sqlite3_column_bytes (stmt, i);
+    return 0;
+}
+
+
+/* decode the current row into an invoice_decode_t. return 0 on success */
+static int
+select_invoice_decode (sqlite3_stmt *stmt, void *out)
+{
+    invoice_decode_t *decode = out;
+    const int *col = decode->columns;
+    invoice_t *s = decode->invoice;
+
+    return decode_int  (stmt, col[COL_INVOICE_ID],    0, &s->invoice_id)
+        || decode_text (stmt, col[COL_FILEPATH],      s->filepath, MY_MAX_PATH)
+        || decode_text (stmt, col[COL_CUSTOMER_NAME], s->customer_name, MY_MAX_PATH)
+        || decode_int  (stmt, col[COL_SEARCH_DATE],   1, &s->date)
+        || decode_int  (stmt, col[COL_YEAR],          1, &s->year)
+        || decode_int  (stmt, col[COL_MONTH],         1, &s->month)
+        || decode_int  (stmt, col[COL_DAY],           1, &s->day)
+        || decode_int  (stmt, col[COL_ERROR_FLAG],    0, &s->error_flag);
+}
+
+
+/* decode the current row into a view_decode_t. return 0 on success */
+static int
+select_view_decode (sqlite3_stmt *stmt, void *out)
+{
+    view_decode_t *decode = out;
+    const int *col = decode->columns;
+    invoice_view_t *s = decode->view;
+
+    return decode_int       (stmt, col[COL_INVOICE_ID],    0, &s->invoice_id)
+        || decode_text_view (stmt, col[COL_FILEPATH],      &s->filepath)
+        || decode_text_view (stmt, col[COL_CUSTOMER_NAME], &s->customer_name)
+        || decode_int       (stmt, col[COL_SEARCH_DATE],   1, &s->date)
+        || decode_int       (stmt, col[COL_YEAR],          1, &s->year)
+        || decode_int       (stmt, col[COL_MONTH],         1, &s->month)
+        || decode_int       (stmt, col[COL_DAY],           1, &s->day)
+        || decode_int       (stmt, col[COL_ERROR_FLAG],    0, &s->error_flag);
+}
+
+
+static int
+select_invoice (sqlite3 *db, int stmt_id, int retry_count, 
+                invoice_t *ret_invoice)
+{
+    invoice_decode_t decode = { s_stmt_columns[stmt_id], ret_invoice };
+
+    return sqlwrap_execute_into (db, s_stmts[stmt_id], retry_count, 
+                                 (ret_invoice ? select_invoice_decode : NULL),
+                                 &decode);
+}
+
+
+/* transactions */
+static int
+execute_simple (sqlite3 *db, int stmt_id)
+{
+    int retcode = 1;
+    sqlite3_stmt *stmt = s_stmts[stmt_id];
+
+    if (sqlwrap_execute (db, stmt, 3, NULL, NULL) != SQLITE_DONE)
+    {
+        sqlwrap_log_error (db);
+        log_error ("SQLite3: execution failed\n");
+        goto execute_simple_exit;
+    }
+
+    retcode = 0;
+execute_simple_exit:
+    (void)sqlite3_reset (stmt);
+    return retcode;
+}
+
+
+int
+db_begin (sqlite3 *db)
+{
+    log_debug ("beginning transaction\n");
+    return execute_simple (db, STMT_BEGIN);
+}
+
+
+int
+db_commit (sqlite3 *db)
+{
+    log_debug ("committing transaction\n");
+    return execute_simple (db, STMT_COMMIT);
+}
+
+
+int
+db_rollback (sqlite3 *db)
+{
+    log_debug ("rolling back transaction\n");
+    return execute_simple (db, STMT_ROLLBACK);
+}
+
+
+/* batched transactions
+ *
+ * writes are grouped into one transaction until either batch_size writes
+ * have been made, or the oldest uncommitted write is max_latency_ms old. 
+ * a batch_size of 0 leaves every write in autocommit mode. */
+void
+db_batch_init (size_t batch_size, int max_latency_ms)
+{
+    s_batch.size        = batch_size;
+    s_batch.max_latency = (max_latency_ms < 0 ? 0 : max_latency_ms) / 1000.0;
+
+    s_batch.active      = 0;
+    s_batch.pending     = 0;
+    s_batch.opened_at   = 0;
+
+    s_batch.commits     = 0;
+    s_batch.rows        = 0;
+    s_batch.commit_time = 0;
+    s_batch.first_begin = 0;
+
+    return;
+}
+
+
+/* call before each write, opens a new transaction if needed */
+int
+db_batch_begin (sqlite3 *db)
+{
+    if ((s_batch.size == 0) || (s_batch.active)) return 0;
+
+    if (db_begin (db)) return 1;
+
+    s_batch.active    = 1;
+    s_batch.pending   = 0;
+    s_batch.opened_at = now_seconds ();
+    if (s_batch.commits == 0) s_batch.first_begin = s_batch.opened_at;
+
+    return 0;
+}
+
+
+/* call after each write, commits once the batch is full or stale */
+int
+db_batch_step (sqlite3 *db)
+{
+    if (!s_batch.active) return 0;
+
+    s_batch.pending++;
+    if (s_batch.pending >= s_batch.size) return db_batch_flush (db);
+
+    return db_batch_poll (db);
+}
+
+
+/* commit the open transaction if it has exceeded the max latency */
+int
+db_batch_poll (sqlite3 *db)
+{
+    if (!s_batch.active) return 0;
+
+    if ((now_seconds () - s_batch.opened_at) < s_batch.max_latency) return 0;
+
+    return db_batch_flush (db);
+}
+
+
+/* commit any pending writes */
+int
+db_batch_flush (sqlite3 *db)
+{
+    double start;
+
+    if (!s_batch.active) return 0;
+
+    start = now_seconds ();
+    if (db_commit (db))
+    {
+        log_error ("Failed to commit %zu writes, rolling back\n", 
+                   s_batch.pending);
+        (void)db_rollback (db);
+        s_batch.active = 0;
+        return 1;
+    }
+
+    s_batch.commit_time += now_seconds () - start;
+    s_batch.commits++;
+    s_batch.rows += s_batch.pending;
+
+    s_batch.active  = 0;
+    s_batch.pending = 0;
+
+    return 0;
+}
+
+
+/* discard any pending writes */
+int
+db_batch_rollback (sqlite3 *db)
+{
+    if (!s_batch.active) return 0;
+
+    s_batch.active  = 0;
+    s_batch.pending = 0;
+
+    return db_rollback (db);
+}
+
+
+void
+db_batch_report (void)
+{
+    double elapsed;
+
+    if ((s_batch.size == 0) || (s_batch.commits == 0)) return;
+
+    elapsed = now_seconds () - s_batch.first_begin;
+    if (elapsed <= 0) elapsed = 1e-9;
+
+    log_info ("batch size %zu: %zu rows in %zu commits over %.3fs "
+              "(%.1f commits/s, %.1f rows/s, %.3fs in commit)\n",
+              s_batch.size, s_batch.rows, s_batch.commits, elapsed,
+              s_batch.commits / elapsed, s_batch.rows / elapsed,
+              s_batch.commit_time);
+
+    return;
+}
+
+
+static double
+now_seconds (void)
+{
+    struct timespec ts;
+
+    if (timespec_get (&ts, TIME_UTC) == 0) return 0;
+
+    return (double)ts.tv_sec + (ts.tv_nsec / 1e9);
 }
 
 
@@ -2,7 +2,9 @@
 #ifndef INVOICE_DATABASE_HEADER
 #define INVOICE_DATABASE_HEADER
 
+#include <arena-lib/arena.h>
 #include <sqlite3.h>
+#include <stddef.h>
 
 
 #define MY_MAX_PATH 255
@@ -18,15 +20,91 @@ typedef struct
     int error_flag;
 } invoice_t;
 
+/* text in place, not terminated */
+typedef struct
+{
+    const char *ptr;
+    size_t length;
+} db_text_t;
+
+/* an invoice_t that points into the row instead of copying out of it. 
+ * the text is SQLite's column memory, valid until the cursor steps again
+ * or is closed, see db_view_materialize() to keep it longer */
+typedef struct
+{
+    int invoice_id;
+    db_text_t filepath;
+    db_text_t customer_name;
+    int date;
+    int year;
+    int month;
+    int day;
+    int error_flag;
+} invoice_view_t;
+
+/* identifies one version of a file on disk */
+typedef struct
+{
+    long long dev;
+    long long ino;
+    long long size;
+    long long mtime;        /* nanoseconds since the epoch */
+} file_stat_t;
+
+/* a result set read a row at a time, see db_cursor_open() */
+typedef struct db_cursor db_cursor_t;
+
+typedef enum
+{
+    DB_UPSERT_ERROR,
+    DB_UPSERT_INSERTED,
+    DB_UPSERT_UPDATED,
+    DB_UPSERT_UNCHANGED,
+} db_upsert_t;
+
 
 sqlite3 *db_init (const char *dbfile, int dryrun);
+sqlite3 *db_open_readonly (const char *dbfile);
 void     db_quit (sqlite3 *db);
 
 int db_insert (sqlite3 *db, char *filepath, char *customer_name, int year, int month, int day);
 
 int db_update_by_file (sqlite3 *db, char *filepath, char *customer_name, int year, int month, int day);
 
+db_upsert_t db_upsert (sqlite3 *db, char *filepath, char *customer_name, int year, int month, int day, const file_stat_t *stat, int keep_existing);
+
+int db_delete_by_file (sqlite3 *db, char *filepath);
+int db_delete_by_directory (sqlite3 *db, char *directory, char seperator);
+
+int db_foreach_file_stat (sqlite3 *db, int (*callback)(const char *filepath, const file_stat_t *stat, void *user), void *user);
+
 int db_search_by_file (sqlite3 *db, char *filepath, invoice_t **ret_invoice);
 int db_search_by_id (sqlite3 *db, int id, invoice_t **ret_invoice);
+int db_search_by_file_r (sqlite3 *db, char *filepath, invoice_t *ret_invoice);
+int db_search_by_id_r (sqlite3 *db, int id, invoice_t *ret_invoice);
+
+db_cursor_t *db_cursor_open (sqlite3 *db, const char *query);
+int          db_cursor_next (db_cursor_t *cursor, invoice_t *ret_invoice);
+long         db_cursor_fetch (db_cursor_t *cursor, invoice_t *invoices, size_t n);
+int          db_cursor_next_view (db_cursor_t *cursor, invoice_view_t *ret_view);
+void         db_cursor_close (db_cursor_t *cursor);
+
+db_cursor_t *db_search_by_customer (sqlite3 *db, const char *customer_name);
+db_cursor_t *db_search_by_customer_prefix (sqlite3 *db, const char *prefix);
+db_cursor_t *db_search_by_date_range (sqlite3 *db, int low, int high);
+
+int db_view_materialize (invoice_view_t *view, arena_t *arena);
+
+int db_begin (sqlite3 *db);
+int db_commit (sqlite3 *db);
+int db_rollback (sqlite3 *db);
+
+void db_batch_init (size_t batch_size, int max_latency_ms);
+int  db_batch_begin (sqlite3 *db);
+int  db_batch_step (sqlite3 *db);
+int  db_batch_poll (sqlite3 *db);
+int  db_batch_flush (sqlite3 *db);
+int  db_batch_rollback (sqlite3 *db);
+void db_batch_report (void);
 
 #endif
\ No newline at end of file
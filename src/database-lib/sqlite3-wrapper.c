@@ -4,11 +4,15 @@
 #include <logging-lib/logging.h>
 #include <mystring-lib/mystring.h>
 #include <sqlite3.h>
+#include <stats-lib/trace.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 
+static int step_with_retry (sqlite3 *db, sqlite3_stmt *stmt, int retry_count);
+
+
 void
 sqlwrap_log_error (sqlite3 *db)
 {
@@ -208,27 +212,94 @@ sqlwrap_finalize_n (sqlite3_stmt **stmts, size_t n)
 }
 
 
+/* resolve names[] to the result columns of stmt, map[i] is the column
+ * index of names[i], or -1 if stmt does not return it. done once after
+ * preparing, so rows can be decoded by index. returns how many were 
+ * found */
+size_t
+sqlwrap_column_map (sqlite3_stmt *stmt, const char **names, int *map, 
+                    size_t n)
+{
+    int column_count = sqlite3_column_count (stmt);
+    size_t found = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        map[i] = -1;
+
+        for (int j = 0; j < column_count; j++)
+        {
+            if (strcmp (sqlite3_column_name (stmt, j), names[i]) == 0)
+            {
+                map[i] = j;
+                found++;
+                break;
+            }
+        }
+    }
+
+    return found;
+}
+
+
 int
 sqlwrap_execute (sqlite3 *db, sqlite3_stmt *stmt, int retry_count, void **result_ptr, void *(*callback_get_item)(sqlite3_stmt *))
 {
     int sqlite_ret;
     void *result = NULL;
 
+    sqlite_ret = step_with_retry (db, stmt, retry_count);
+
+    if ((sqlite_ret == SQLITE_ROW) && (callback_get_item))
+    {
+        result = callback_get_item (stmt);
+    }
+
+    if (result_ptr) *result_ptr = result;
+    return sqlite_ret;
+}
+
+
+/* like sqlwrap_execute(), but decode the row into caller owned memory. 
+ * decode should return 0 on success, if it fails SQLITE_MISMATCH is 
+ * returned in place of SQLITE_ROW */
+int
+sqlwrap_execute_into (sqlite3 *db, sqlite3_stmt *stmt, int retry_count, 
+                      int (*decode)(sqlite3_stmt *, void *), void *out)
+{
+    int sqlite_ret = step_with_retry (db, stmt, retry_count);
+
+    if ((sqlite_ret == SQLITE_ROW) && (decode) && (decode (stmt, out)))
+    {
+        log_error ("SQLite3: failed to decode row\n");
+        return SQLITE_MISMATCH;
+    }
+
+    return sqlite_ret;
+}
+
+
+static int
+step_with_retry (sqlite3 *db, sqlite3_stmt *stmt, int retry_count)
+{
+    int sqlite_ret;
+    uint64_t start = TRACE_BEGIN ();
+
     while (((sqlite_ret = sqlite3_step (stmt)) == SQLITE_BUSY) && (retry_count > 0))
     {
         log_warning ("SQLite2: cannot execute statment, database is busy. Retying...\n");
         retry_count--;
     }
 
+    TRACE_END ("sqlite", trace_intern (sqlite3_sql (stmt)), start);
+
     switch (sqlite_ret) 
     {
     case SQLITE_BUSY:
         log_error ("SQLite2: failed to execute statement, database is busy. Aborting!\n");
         break;
     case SQLITE_DONE:
-        break;
     case SQLITE_ROW:
-        if (callback_get_item) result = callback_get_item (stmt);
         break;
     case SQLITE_ERROR:
     case SQLITE_CORRUPT:
@@ -240,7 +311,6 @@ sqlwrap_execute (sqlite3 *db, sqlite3_stmt *stmt, int retry_count, void **result
         break;
     }
 
-    if (result_ptr) *result_ptr = result;
     return sqlite_ret;
 }
 
@@ -335,4 +405,25 @@ verify_column_type_exit:
 }
 
 
+/* true if column i of the current row is of type, or NULL when nullable.
+ * the cheap check for decoding by index, logs the mismatch otherwise */
+int
+column_check_type (sqlite3_stmt *stmt, int i, int type, int nullable)
+{
+    int real_type = sqlite3_column_type (stmt, i);
+
+    if ((real_type == type) || (nullable && (real_type == SQLITE_NULL)))
+    {
+        return 1;
+    }
+
+    log_error ("SQLite3: Bad '%s' type, expected %s%s but got %s!\n", 
+               sqlite3_column_name (stmt, i), column_type_string (type), 
+               (nullable ? " or SQLITE_NULL" : ""), 
+               column_type_string (real_type));
+
+    return 0;
+}
+
+
 /* end of file */
\ No newline at end of file
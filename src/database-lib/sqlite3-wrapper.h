@@ -30,17 +30,21 @@ int      sqlwrap_close (sqlite3 *db);
 
 size_t sqlwrap_prepare_n (sqlite3 *db, const char **stmt_texts, sqlite3_stmt **stmts, size_t n);
 void   sqlwrap_finalize_n (sqlite3_stmt **stmts, size_t n);
+size_t sqlwrap_column_map (sqlite3_stmt *stmt, const char **names, int *map, size_t n);
 int    sqlwrap_execute (sqlite3 *db, sqlite3_stmt *stmt, int retry_count, void **result_ptr, void *(*callback_get_item)(sqlite3_stmt *));
+int    sqlwrap_execute_into (sqlite3 *db, sqlite3_stmt *stmt, int retry_count, int (*decode)(sqlite3_stmt *, void *), void *out);
 
 column_t    column_get (sqlite3_stmt *stmt, int i);
 const char *column_type_string (int type);
 int         column_match_type (column_t col, int *types, size_t n);
+int         column_check_type (sqlite3_stmt *stmt, int i, int type, int nullable);
 
 
 /* msvc _HATES_ this for some reason? but it does compile! */
 /* it looks like, msvc is doing type checks before expanding the _Generic */
 #define SQLWRAP_BIND_N(stmt, index, value, n) _Generic((value),               \
        int: sqlite3_bind_int  (stmt, index, value),                           \
+ long long: sqlite3_bind_int64 (stmt, index, value),                          \
     char *: sqlite3_bind_text (stmt, index, value, n, SQLITE_STATIC),         \
     void *: sqlite3_bind_null (stmt, index))
 
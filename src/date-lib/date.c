@@ -1,50 +1,167 @@
 #include "date.h"
 
+#include <threads.h>
 #include <time.h>
 
 
+/* today as year * 10000 + month * 100 + day, taken once per run unless
+ * date_refresh_today() is called */
+static int s_today_key = 0;
+static int s_today_set = 0;         /* by date_set_today() */
+static once_flag s_today_once = ONCE_FLAG_INIT;
 
+static void today_from_clock (void);
+static int  clock_key (void);
+static inline int date_key (int year, int month, int day);
+static inline int is_valid (int year, int month, int day, int today);
+
+
+/* read today's date from the clock, if date_set_today() has not been 
+ * called. optional, the first date_validate() does it otherwise */
+void
+date_init (void)
+{
+    call_once (&s_today_once, today_from_clock);
+
+    return;
+}
+
+
+/* use an explicit date as today, dates after it do not validate. may be
+ * called again to move the day, from a single thread while no dates are 
+ * being validated */
+void
+date_set_today (int year, int month, int day)
+{
+    s_today_key = date_key (year, month, day);
+    s_today_set = 1;
+
+    return;
+}
+
+
+/* read today's date from the clock again, for programs that run across
+ * midnight. returns non zero if the day changed. a date given to 
+ * date_set_today() is kept. call from a single thread while no dates are
+ * being validated */
+int
+date_refresh_today (void)
+{
+    int key;
+
+    date_init ();
+    if (s_today_set) return 0;
+
+    key = clock_key ();
+    if ((key == 0) || (key == s_today_key)) return 0;
+
+    s_today_key = key;
+    return 1;
+}
+
+
+
+/* a date as the integer YYYYMMDD, which sorts in date order */
 int
 date_format_int_atoz (int year, int month, int day)
 {
-    return ((day * 0) + (month * 100) + (year * 10000));
+    return date_key (year, month, day);
+}
+
+
+/* the inverse of date_format_int_atoz() */
+date_tuple_t
+date_from_int (int date)
+{
+    return (date_tuple_t){
+        .year  = (date / 10000),
+        .month = (date / 100) % 100,
+        .day   = (date % 100),
+    };
 }
 
 
 int
 date_validate (int year, int month, int day)
 {
-    time_t t = time (NULL);
-    struct tm *tm = localtime (&t);
+    date_init ();
 
-    const int DAYS_IN_MONTH[12]={31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return is_valid (year, month, day, s_today_key);
+}
 
-    /* future dates are not allowed */
-    if (!((year  < (tm->tm_year + 1900)) ||
-          (month < (tm->tm_mon  + 1)) ||
-          (day   < (tm->tm_mday))))
-    {
-        return 0;
-    }
 
-    /* too old/invalid range */
-    if (year < 1900) 
-    {
-        return 0;
-    }
+/* validate n dates at once, setting valid[i] to 1 or 0 for each. returns
+ * how many were valid. the loop has no branches or calls, so compilers 
+ * are free to vectorize it */
+size_t
+date_validate_n (const date_tuple_t *dates, int *valid, size_t n)
+{
+    int today;
+    size_t count = 0;
 
-    if ((month > 12) || (month < 1)) 
-    {
-        return 0;
-    }
+    date_init ();
+    today = s_today_key;
 
-    if ((day > DAYS_IN_MONTH[month - 1]) || (day < 1)) 
+    for (size_t i = 0; i < n; i++)
     {
-        return 0;
+        valid[i] = is_valid (dates[i].year, dates[i].month, dates[i].day, today);
+        count += (size_t)valid[i];
     }
 
-    /* true */
-    return 1;
+    return count;
+}
+
+
+static void
+today_from_clock (void)
+{
+    /* date_set_today() wins */
+    if (s_today_set) return;
+
+    s_today_key = clock_key ();
+
+    return;
+}
+
+
+/* today from the clock, or 0 if it cannot be read */
+static int
+clock_key (void)
+{
+    time_t t;
+    struct tm *tm;
+
+    t = time (NULL);
+    tm = localtime (&t);
+    if (tm == NULL) return 0;
+
+    return date_key (tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
+}
+
+
+static inline int
+date_key (int year, int month, int day)
+{
+    return ((year * 10000) + (month * 100) + day);
+}
+
+
+/* a date from 1900 up to and including today */
+static inline int
+is_valid (int year, int month, int day, int today)
+{
+    /* days in each month less 28, two bits per month from bit 2, january
+     * first. february gains a day in leap years */
+    const unsigned DAYS_IN_MONTH_TABLE = 0x3bbeecc;
+
+    int leap = (((year % 4) == 0) & ((year % 100) != 0)) | ((year % 400) == 0);
+    int days = 28 + (int)((DAYS_IN_MONTH_TABLE >> ((month & 15) * 2)) & 3) + 
+               (leap & (month == 2));
+
+    return ((year >= 1900) & 
+            (month >= 1) & (month <= 12) &
+            (day >= 1) & (day <= days) &
+            (date_key (year, month, day) <= today));
 }
 
 
@@ -1,6 +1,8 @@
 #ifndef DATE_HEADER
 #define DATE_HEADER
 
+#include <stddef.h>
+
 typedef struct 
 {
     int year;
@@ -9,8 +11,14 @@ typedef struct
 } date_tuple_t;
 
 
+void date_init (void);
+void date_set_today (int year, int month, int day);
+int  date_refresh_today (void);
+
 int date_format_int_atoz (int year, int month, int day);
+date_tuple_t date_from_int (int date);
 int date_validate (int year, int month, int day);
+size_t date_validate_n (const date_tuple_t *dates, int *valid, size_t n);
 
 date_tuple_t date_yyyy_mmdd (int a, int b, int c, int d);
 date_tuple_t date_yyyy_ddmm (int a, int b, int c, int d);
@@ -0,0 +1,557 @@
+#include "dirwalk.h"
+
+#include <errno.h>
+#include <logging-lib/logging.h>
+#include <queue-lib/queue.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#if defined(_WIN32)
+#   include <windows.h>
+#   include <sys/stat.h>
+#   define DIRWALK_SEPERATOR '\\'
+#else
+#   include <dirent.h>
+#   include <fcntl.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#   if defined(__linux__)
+#       include <sys/syscall.h>
+#   endif
+#   define DIRWALK_SEPERATOR '/'
+#endif
+
+
+/* directories waiting to be read. the owning thread pushes and pops at the
+ * tail, idle threads steal from the head, so the oldest (and usually 
+ * largest) subtrees are the ones that move between threads. */
+typedef struct
+{
+    mtx_t lock;
+    char **items;
+    size_t head;
+    size_t tail;
+    size_t alloc;
+} deque_t;
+
+typedef struct
+{
+    deque_t *deques;
+    int threads;
+
+    atomic_size_t pending;      /* directories queued or being read */
+    atomic_int stop;
+
+    dirwalk_callback_t on_file;
+    void *user;
+} walk_t;
+
+typedef struct
+{
+    walk_t *walk;
+    int index;
+    thrd_t thread;
+
+    char *path;                 /* scratch buffer for joined paths */
+    size_t alloc;
+} worker_t;
+
+enum
+{
+    ENTRY_OTHER,
+    ENTRY_FILE,
+    ENTRY_DIRECTORY,
+};
+
+
+static int   deque_push (deque_t *dq, char *item);
+static char *deque_pop (deque_t *dq);
+static char *deque_steal (deque_t *dq);
+
+static int   walker_thread (void *arg);
+static char *next_directory (worker_t *w);
+static void  read_directory (worker_t *w, const char *dir);
+static void  handle_entry (worker_t *w, int dirfd, const char *dir, 
+                           const char *name, int type);
+static int   queue_directory (worker_t *w, const char *path);
+static const char *join_path (worker_t *w, const char *dir, const char *name, 
+                              size_t *length_out);
+
+
+/* walk every root with the given number of threads, calling on_file for 
+ * each regular file. symbolic links are not followed. return 0 if the 
+ * whole tree was walked */
+int
+dirwalk_run (char **roots, size_t n, int threads, 
+             dirwalk_callback_t on_file, void *user)
+{
+    int retcode = 1;
+    walk_t walk = { 0 };
+    worker_t *workers = NULL;
+    int started = 0;
+
+    if ((roots == NULL) || (on_file == NULL)) return 1;
+    if (threads < 1) threads = 1;
+
+    walk.threads = threads;
+    walk.on_file = on_file;
+    walk.user = user;
+    atomic_init (&walk.pending, 0);
+    atomic_init (&walk.stop, 0);
+
+    walk.deques = calloc ((size_t)threads, sizeof (deque_t));
+    workers = calloc ((size_t)threads, sizeof (worker_t));
+    if ((walk.deques == NULL) || (workers == NULL)) goto dirwalk_run_exit;
+
+    for (int i = 0; i < threads; i++)
+    {
+        (void)mtx_init (&walk.deques[i].lock, mtx_plain);
+        workers[i].walk = &walk;
+        workers[i].index = i;
+    }
+
+    /* deal the roots out between the threads */
+    for (size_t i = 0; i < n; i++)
+    {
+        log_verbose ("scanning '%s'\n", roots[i]);
+        if (queue_directory (&workers[i % (size_t)threads], roots[i]))
+        {
+            goto dirwalk_run_exit;
+        }
+    }
+
+    for (; started < threads; started++)
+    {
+        if (thrd_create (&workers[started].thread, walker_thread, 
+                         &workers[started]) != thrd_success)
+        {
+            log_error ("Failed to start walker thread %d\n", started);
+            break;
+        }
+    }
+
+    /* a thread that failed to start leaves work behind, the others steal 
+     * it so nothing is lost */
+    if (started == 0) 
+    {
+        atomic_store (&walk.stop, 1);
+        goto dirwalk_run_exit;
+    }
+
+    for (int i = 0; i < started; i++) (void)thrd_join (workers[i].thread, NULL);
+
+    retcode = (atomic_load (&walk.stop) ? 1 : 0);
+
+dirwalk_run_exit:
+    if (walk.deques)
+    {
+        for (int i = 0; i < threads; i++)
+        {
+            char *left = NULL;
+            while ((left = deque_pop (&walk.deques[i])) != NULL) free (left);
+            free (walk.deques[i].items);
+            mtx_destroy (&walk.deques[i].lock);
+        }
+    }
+    if (workers)
+    {
+        for (int i = 0; i < threads; i++) free (workers[i].path);
+    }
+    free (walk.deques); walk.deques = NULL;
+    free (workers);     workers = NULL;
+
+    return retcode;
+}
+
+
+static int
+walker_thread (void *arg)
+{
+    worker_t *w = arg;
+    walk_t *walk = w->walk;
+    char *dir = NULL;
+    unsigned spins = 0;
+
+    while (!atomic_load_explicit (&walk->stop, memory_order_relaxed))
+    {
+        dir = next_directory (w);
+        if (dir == NULL)
+        {
+            /* nothing queued anywhere and nothing being read, so nothing 
+             * new can show up either */
+            if (atomic_load (&walk->pending) == 0) break;
+
+            queue_backoff (&spins);
+            continue;
+        }
+
+        spins = 0;
+        read_directory (w, dir);
+        free (dir);
+
+        /* only once its subdirectories are queued */
+        atomic_fetch_sub (&walk->pending, 1);
+    }
+
+    return 0;
+}
+
+
+static char *
+next_directory (worker_t *w)
+{
+    walk_t *walk = w->walk;
+    char *dir = deque_pop (&walk->deques[w->index]);
+
+    for (int i = 1; (dir == NULL) && (i < walk->threads); i++)
+    {
+        dir = deque_steal (&walk->deques[(w->index + i) % walk->threads]);
+    }
+
+    return dir;
+}
+
+
+static int
+queue_directory (worker_t *w, const char *path)
+{
+    walk_t *walk = w->walk;
+    char *copy = NULL;
+    size_t length = strlen (path);
+
+    copy = malloc (length + 1);
+    if (copy == NULL) 
+    {
+        log_error ("out of memory queueing '%s'\n", path);
+        atomic_store (&walk->stop, 1);
+        return 1;
+    }
+    memcpy (copy, path, length + 1);
+
+    atomic_fetch_add (&walk->pending, 1);
+    if (deque_push (&walk->deques[w->index], copy))
+    {
+        atomic_fetch_sub (&walk->pending, 1);
+        free (copy);
+        log_error ("out of memory queueing '%s'\n", path);
+        atomic_store (&walk->stop, 1);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+#if defined(_WIN32)
+static void
+read_directory (worker_t *w, const char *dir)
+{
+    WIN32_FIND_DATAA found;
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    const char *pattern = NULL;
+
+    pattern = join_path (w, dir, "*", NULL);
+    if (pattern == NULL) return;
+
+    handle = FindFirstFileA (pattern, &found);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        log_warning ("cannot open directory '%s'\n", dir);
+        return;
+    }
+
+    do
+    {
+        int type = ENTRY_FILE;
+
+        /* do not follow links, same as find */
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) continue;
+
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) 
+        {
+            type = ENTRY_DIRECTORY;
+        }
+
+        handle_entry (w, -1, dir, found.cFileName, type);
+    } while (FindNextFileA (handle, &found));
+
+    (void)FindClose (handle);
+
+    return;
+}
+
+#else /* posix */
+
+static int
+entry_type (int dirfd, const char *name, unsigned char d_type)
+{
+    struct stat st;
+
+    switch (d_type)
+    {
+    case DT_REG: return ENTRY_FILE;
+    case DT_DIR: return ENTRY_DIRECTORY;
+    case DT_UNKNOWN: break;
+    default: return ENTRY_OTHER;
+    }
+
+    /* some filesystems do not fill in d_type */
+    if (fstatat (dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) return ENTRY_OTHER;
+
+    if (S_ISREG (st.st_mode)) return ENTRY_FILE;
+    if (S_ISDIR (st.st_mode)) return ENTRY_DIRECTORY;
+
+    return ENTRY_OTHER;
+}
+
+
+static void
+read_directory (worker_t *w, const char *dir)
+{
+    int fd = openat (AT_FDCWD, dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        log_warning ("cannot open directory '%s': %s\n", dir, strerror (errno));
+        return;
+    }
+
+#if defined(__linux__) && defined(SYS_getdents64)
+    /* read entries in large blocks straight from the kernel */
+    struct linux_dirent64
+    {
+        unsigned long long d_ino;
+        long long d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+    long buffer[32768 / sizeof (long)];
+    long nread;
+
+    while ((nread = syscall (SYS_getdents64, fd, buffer, sizeof (buffer))) > 0)
+    {
+        for (long offset = 0; offset < nread; )
+        {
+            struct linux_dirent64 *d = (void *)((char *)buffer + offset);
+            offset += d->d_reclen;
+
+            handle_entry (w, fd, dir, d->d_name, 
+                          entry_type (fd, d->d_name, d->d_type));
+        }
+    }
+    if (nread < 0) 
+    {
+        log_warning ("cannot read directory '%s': %s\n", dir, strerror (errno));
+    }
+
+    (void)close (fd);
+
+#else
+    DIR *dp = fdopendir (fd);
+    struct dirent *d = NULL;
+
+    if (dp == NULL)
+    {
+        (void)close (fd);
+        return;
+    }
+
+    while ((d = readdir (dp)) != NULL)
+    {
+        handle_entry (w, fd, dir, d->d_name, 
+                      entry_type (fd, d->d_name, d->d_type));
+    }
+
+    (void)closedir (dp);    /* closes fd too */
+#endif
+
+    return;
+}
+#endif /* posix */
+
+
+static void
+handle_entry (worker_t *w, int dirfd, const char *dir, const char *name, 
+              int type)
+{
+    walk_t *walk = w->walk;
+    dirwalk_entry_t entry;
+    const char *path = NULL;
+    size_t length = 0;
+
+    /* skip the current and parent directory */
+    if ((name[0] == '.') && 
+        ((name[1] == '\0') || ((name[1] == '.') && (name[2] == '\0'))))
+    {
+        return;
+    }
+
+    if (type == ENTRY_OTHER) return;
+
+    path = join_path (w, dir, name, &length);
+    if (path == NULL) return;
+
+    if (type == ENTRY_DIRECTORY)
+    {
+        (void)queue_directory (w, path);
+        return;
+    }
+
+    entry.path = path;
+    entry.path_len = length;
+    entry.name = path + (length - strlen (name));
+    entry.dirfd = dirfd;
+
+    if (walk->on_file (&entry, w->index, walk->user))
+    {
+        atomic_store (&walk->stop, 1);
+    }
+
+    return;
+}
+
+
+/* stat a file handed to the callback, returns 0 on success. does not 
+ * follow symlinks. */
+int
+dirwalk_stat (const dirwalk_entry_t *entry, dirwalk_stat_t *out)
+{
+#if defined(_WIN32)
+    struct _stat64 st;
+
+    if (_stat64 (entry->path, &st) != 0) return 1;
+
+    out->dev   = (long long)st.st_dev;
+    out->ino   = 0;     /* not meaningful on windows */
+    out->size  = (long long)st.st_size;
+    out->mtime = (long long)st.st_mtime * 1000000000LL;
+#else
+    struct stat st;
+    int rc;
+
+    if (entry->dirfd >= 0)
+        rc = fstatat (entry->dirfd, entry->name, &st, AT_SYMLINK_NOFOLLOW);
+    else
+        rc = lstat (entry->path, &st);
+
+    if (rc != 0) return 1;
+
+    out->dev   = (long long)st.st_dev;
+    out->ino   = (long long)st.st_ino;
+    out->size  = (long long)st.st_size;
+#   if defined(__APPLE__)
+    out->mtime = (long long)st.st_mtimespec.tv_sec * 1000000000LL 
+               + (long long)st.st_mtimespec.tv_nsec;
+#   else
+    out->mtime = (long long)st.st_mtim.tv_sec * 1000000000LL 
+               + (long long)st.st_mtim.tv_nsec;
+#   endif
+#endif
+
+    return 0;
+}
+
+
+/* join dir and name into the worker's scratch buffer */
+static const char *
+join_path (worker_t *w, const char *dir, const char *name, size_t *length_out)
+{
+    size_t dir_len = strlen (dir);
+    size_t name_len = strlen (name);
+    size_t needed;
+    char *tmp = NULL;
+
+    /* dont double up on seperators if the root ends in one */
+    int seperator = ((dir_len > 0) && 
+                     ((dir[dir_len - 1] == '/') || 
+                      (dir[dir_len - 1] == DIRWALK_SEPERATOR))) ? 0 : 1;
+
+    needed = dir_len + (size_t)seperator + name_len + 1;
+    if (needed > w->alloc)
+    {
+        tmp = realloc (w->path, needed * 2);
+        if (tmp == NULL) return NULL;
+        w->path = tmp;
+        w->alloc = needed * 2;
+    }
+
+    memcpy (w->path, dir, dir_len);
+    if (seperator) w->path[dir_len] = DIRWALK_SEPERATOR;
+    memcpy (w->path + dir_len + seperator, name, name_len + 1);
+
+    if (length_out) *length_out = needed - 1;
+    return w->path;
+}
+
+
+static int
+deque_push (deque_t *dq, char *item)
+{
+    char **tmp = NULL;
+
+    (void)mtx_lock (&dq->lock);
+
+    if (dq->tail == dq->alloc)
+    {
+        /* slide everything back to the front before growing */
+        if (dq->head > 0)
+        {
+            memmove (dq->items, dq->items + dq->head, 
+                     (dq->tail - dq->head) * sizeof (char *));
+            dq->tail -= dq->head;
+            dq->head = 0;
+        }
+
+        if (dq->tail == dq->alloc)
+        {
+            size_t alloc = (dq->alloc ? dq->alloc * 2 : 64);
+            tmp = realloc (dq->items, alloc * sizeof (char *));
+            if (tmp == NULL)
+            {
+                (void)mtx_unlock (&dq->lock);
+                return 1;
+            }
+            dq->items = tmp;
+            dq->alloc = alloc;
+        }
+    }
+
+    dq->items[dq->tail++] = item;
+
+    (void)mtx_unlock (&dq->lock);
+    return 0;
+}
+
+
+static char *
+deque_pop (deque_t *dq)
+{
+    char *item = NULL;
+
+    (void)mtx_lock (&dq->lock);
+    if (dq->tail > dq->head) item = dq->items[--dq->tail];
+    if (dq->tail == dq->head) dq->tail = dq->head = 0;
+    (void)mtx_unlock (&dq->lock);
+
+    return item;
+}
+
+
+static char *
+deque_steal (deque_t *dq)
+{
+    char *item = NULL;
+
+    /* dont wait on a busy owner, just try somewhere else */
+    if (mtx_trylock (&dq->lock) != thrd_success) return NULL;
+    if (dq->tail > dq->head) item = dq->items[dq->head++];
+    if (dq->tail == dq->head) dq->tail = dq->head = 0;
+    (void)mtx_unlock (&dq->lock);
+
+    return item;
+}
+
+
+/* end of file */
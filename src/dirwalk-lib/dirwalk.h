@@ -0,0 +1,38 @@
+#ifndef INVOICE_DIRWALK_HEADER
+#define INVOICE_DIRWALK_HEADER
+
+#include <stddef.h>
+
+/* a regular file found while walking, only valid during the callback */
+typedef struct
+{
+    const char *path;       /* full path, starting with the root */
+    size_t path_len;
+    const char *name;       /* last component of path */
+    int dirfd;              /* parent directory handle, -1 if unavailable */
+} dirwalk_entry_t;
+
+/* file metadata, enough to tell whether a file changed between walks */
+typedef struct
+{
+    long long dev;
+    long long ino;
+    long long size;
+    long long mtime;        /* nanoseconds since the epoch */
+} dirwalk_stat_t;
+
+/* called from the walker threads for every regular file. worker is the 
+ * index of the calling thread, in [0, threads). returning non zero stops 
+ * the walk. */
+typedef int (*dirwalk_callback_t) (const dirwalk_entry_t *entry, int worker, 
+                                   void *user);
+
+
+int dirwalk_run (char **roots, size_t n, int threads, 
+                 dirwalk_callback_t on_file, void *user);
+
+int dirwalk_stat (const dirwalk_entry_t *entry, dirwalk_stat_t *out);
+
+
+#endif /* header guard */
+/* end of file */
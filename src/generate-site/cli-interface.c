@@ -12,6 +12,7 @@
 
 static void help_page (FILE *stream);
 static void version_page (FILE *stream);
+static long param_to_date (char *param);
 
 
 void
@@ -23,7 +24,12 @@ cli_parse_arguements (int argc, char **argv)
         FORMAT,
         SECTION,
         QUERY,
+        CUSTOMER,
+        CUSTOMER_PREFIX,
+        DATE_FROM,
+        DATE_TO,
         OUTPUT,
+        TRACE,
         DEBUG,
         VERBOSE,
         TERSE,
@@ -36,7 +42,12 @@ cli_parse_arguements (int argc, char **argv)
         { FORMAT,   "-f", "--format",   CONARG_PARAM_REQUIRED },
         { SECTION,  "-s", "--section",  CONARG_PARAM_REQUIRED },
         { QUERY,    "-q", "--query",    CONARG_PARAM_REQUIRED },
+        { CUSTOMER, "-c", "--customer", CONARG_PARAM_REQUIRED },
+        { CUSTOMER_PREFIX, NULL, "--customer-prefix", CONARG_PARAM_REQUIRED },
+        { DATE_FROM, NULL, "--from",    CONARG_PARAM_REQUIRED },
+        { DATE_TO,  NULL, "--to",       CONARG_PARAM_REQUIRED },
         { OUTPUT,   NULL, "--output",   CONARG_PARAM_REQUIRED },
+        { TRACE,    NULL, "--trace",    CONARG_PARAM_REQUIRED },
 
         { DEBUG,    NULL, "--debug",    CONARG_PARAM_NONE },
         { VERBOSE,  "-v", "--verbose",  CONARG_PARAM_NONE },
@@ -78,11 +89,36 @@ cli_parse_arguements (int argc, char **argv)
             g_set_sqlquery = conarg_get_param (argc, argv);
             break;
 
+        case CUSTOMER:
+            CONARG_STEP (argc, argv);
+            g_set_customer = conarg_get_param (argc, argv);
+            break;
+
+        case CUSTOMER_PREFIX:
+            CONARG_STEP (argc, argv);
+            g_set_customer_prefix = conarg_get_param (argc, argv);
+            break;
+
+        case DATE_FROM:
+            CONARG_STEP (argc, argv);
+            g_set_date_from = param_to_date (conarg_get_param (argc, argv));
+            break;
+
+        case DATE_TO:
+            CONARG_STEP (argc, argv);
+            g_set_date_to = param_to_date (conarg_get_param (argc, argv));
+            break;
+
         case OUTPUT:
             CONARG_STEP (argc, argv);
             g_set_output_file = conarg_get_param (argc, argv);
             break;
 
+        case TRACE:
+            CONARG_STEP (argc, argv);
+            g_set_trace = conarg_get_param (argc, argv);
+            break;
+
         case DEBUG:
             g_set_logging_mode = LOG_DEBUG; 
             break;
@@ -135,6 +171,31 @@ version_page (FILE *stream)
 }
 
 
+
+/* convert a YYYYMMDD date parameter, exiting on bad input */
+static long
+param_to_date (char *param)
+{
+    char *end = NULL;
+    long value;
+    long month, day;
+
+    errno = 0;
+    value = strtol (param, &end, 10);
+    month = (value / 100) % 100;
+    day   = value % 100;
+    if ((errno != 0) || (end - param != 8) || (*end != '\0') ||
+        (month < 1) || (month > 12) || (day < 1) || (day > 31))
+    {
+        (void)fprintf (stderr, "error: invalid date, expected YYYYMMDD: '%s'\n", param);
+        help_page (stderr);
+        exit (EXIT_FAILURE);
+    }
+
+    return value;
+}
+
+
 static void
 help_page (FILE *stream)
 {
@@ -147,7 +208,19 @@ help_page (FILE *stream)
         "  -f, --format FILEPATH       format specification file\n"
         "  -n, --section NAME          result section's name\n"
         "  -q, --query SQLQUERY        result items search query\n"
+        "  -c, --customer NAME         every invoice of customer NAME, in\n"
+        "                                date order, in place of the query\n"
+        "      --customer-prefix TEXT  every invoice of the customers whose\n"
+        "                                names start with TEXT, by name then\n"
+        "                                date, in place of the query\n"
+        "      --from YYYYMMDD         every invoice dated from YYYYMMDD on,\n"
+        "                                by date then name, in place of the\n"
+        "                                query\n"
+        "      --to YYYYMMDD           every invoice dated up to and including\n"
+        "                                YYYYMMDD, with or without --from\n"
         "      --output FILEPATH       write outputs to file instead of stdout\n"
+        "      --trace FILEPATH        write a Chrome trace of each SQLite\n"
+        "                                statement to FILEPATH\n"
         "  -t, --terse                 show minimal output/information\n"
         "  -v, --verbose               show more details and warnings at runtime\n"
         "      --debug                 show every last drop of information\n"
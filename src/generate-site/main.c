@@ -4,15 +4,23 @@
 #include <logging-lib/logging.h>
 #include "settings.h"
 #include <sqlite3.h>
+#include <stats-lib/trace.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 
+static db_cursor_t *open_section (sqlite3 *db);
+static int render_section (db_cursor_t *cursor, FILE *stream);
+
+
 int
 main (int argc, char **argv)
 {
     sqlite3 *db = NULL;
+    db_cursor_t *cursor = NULL;
     FILE *output = NULL;
+    uint64_t start;
+    int exitcode = EXIT_SUCCESS;
 
     /* load options passed by commandline */
     settings_load_defaults ();
@@ -27,34 +35,127 @@ main (int argc, char **argv)
         if (output == NULL)
         {
             log_error ("cannot open output file: '%s'\n", g_set_output_file);
-            return 1;
+            return EXIT_FAILURE;
         }
 
         g_info = output;
     }
 
+    /* spans are buffered, and written once done */
+    if ((g_set_trace != NULL) && trace_start (g_set_trace))
+    {
+        log_error ("cannot start tracing to: '%s'\n", g_set_trace);
+        exitcode = EXIT_FAILURE;
+        goto main_exit_output;
+    }
+
     /* log current settings */
     log_debug ("logging mode: %d\n",  g_set_logging_mode);
     log_debug ("database: '%s'\n",    g_set_database);
     log_debug ("format file: %s\n",   g_set_fmt_file);
     log_debug ("section: %s\n",       g_set_secname);
     log_debug ("query: '%s'\n",       g_set_sqlquery);
+    log_debug ("customer: '%s'\n",    g_set_customer);
+    log_debug ("customer prefix: '%s'\n", g_set_customer_prefix);
+    log_debug ("dates: %ld to %ld\n", g_set_date_from, g_set_date_to);
     log_debug ("output file: '%s'\n", g_set_output_file);
+    log_debug ("trace file: '%s'\n",  g_set_trace);
 
-    /* open the database in memory (database dryrun mode) */
-    db = db_init (g_set_database, 1);
+    /* read the database in place, nothing is written */
+    start = TRACE_BEGIN ();
+    db = db_open_readonly (g_set_database);
+    TRACE_END ("stage", "open", start);
     if (db == NULL)
     {
         log_error ("Failed to initialze database\n");
+        exitcode = EXIT_FAILURE;
         goto main_exit_output;
     }
 
-    
-
+    start = TRACE_BEGIN ();
+    cursor = open_section (db);
+    if ((cursor == NULL) || render_section (cursor, (output ? output : stdout)))
+    {
+        exitcode = EXIT_FAILURE;
+    }
+    db_cursor_close (cursor); cursor = NULL;
+    TRACE_END ("stage", "render", start);
 
 /* main_exit_database: */
     db_quit (db); db = NULL;
 main_exit_output:
-    (void)fclose (output); output = NULL;
-    return 0;
-}
\ No newline at end of file
+    if ((g_set_trace != NULL) && trace_quit ())
+    {
+        log_error ("cannot write trace file: '%s'\n", g_set_trace);
+    }
+    if (output) (void)fclose (output);
+    output = NULL;
+    return exitcode;
+}
+
+
+/* the invoices of the section, by customer, customer prefix, date range,
+ * or the query, in that order of preference */
+static db_cursor_t *
+open_section (sqlite3 *db)
+{
+    if (g_set_customer) return db_search_by_customer (db, g_set_customer);
+
+    if (g_set_customer_prefix)
+    {
+        return db_search_by_customer_prefix (db, g_set_customer_prefix);
+    }
+
+    /* an open end takes in every date on that side */
+    if (g_set_date_from || g_set_date_to)
+    {
+        return db_search_by_date_range (db, (int)g_set_date_from, 
+                                        (int)(g_set_date_to ? g_set_date_to : 99991231));
+    }
+
+    return db_cursor_open (db, g_set_sqlquery);
+}
+
+
+/* the invoices under the section name, one line each. rows are written 
+ * straight out of SQLite, without copies, so memory use does not grow 
+ * with the result. return non zero on error */
+static int
+render_section (db_cursor_t *cursor, FILE *stream)
+{
+    int retcode = 0;
+    int ret;
+    size_t total = 0;
+    invoice_view_t invoice;
+
+    (void)fprintf (stream, "%s\n", g_set_secname);
+
+    while ((ret = db_cursor_next_view (cursor, &invoice)) > 0)
+    {
+        if (invoice.error_flag)
+        {
+            (void)fprintf (stream, "  %-10s  %.*s  %.*s\n", "no date", 
+                           (int)invoice.customer_name.length, invoice.customer_name.ptr,
+                           (int)invoice.filepath.length, invoice.filepath.ptr);
+        }
+        else
+        {
+            (void)fprintf (stream, "  %04d-%02d-%02d  %.*s  %.*s\n", 
+                           invoice.year, invoice.month, invoice.day,
+                           (int)invoice.customer_name.length, invoice.customer_name.ptr,
+                           (int)invoice.filepath.length, invoice.filepath.ptr);
+        }
+
+        total++;
+    }
+
+    if (ret < 0)
+    {
+        log_error ("failed reading the invoices of section '%s'\n", g_set_secname);
+        retcode = 1;
+    }
+
+    log_verbose ("%zu invoices in section '%s'\n", total, g_set_secname);
+
+    return retcode;
+}
@@ -10,6 +10,11 @@ char *g_set_fmt_file;
 char *g_set_secname;
 char *g_set_sqlquery;
 char *g_set_output_file;
+char *g_set_trace;
+char *g_set_customer;
+char *g_set_customer_prefix;
+long g_set_date_from;
+long g_set_date_to;
 
 
 void
@@ -21,6 +26,11 @@ settings_load_defaults (void)
     g_set_secname      = DEFAULT_SECTION_NAME;
     g_set_sqlquery     = DEFAULT_SQLQUERY;
     g_set_output_file  = NULL;
+    g_set_trace        = DEFAULT_TRACE;
+    g_set_customer     = DEFAULT_CUSTOMER;
+    g_set_customer_prefix = DEFAULT_CUSTOMER_PREFIX;
+    g_set_date_from    = DEFAULT_DATE_FROM;
+    g_set_date_to      = DEFAULT_DATE_TO;
 
     return;
 }
\ No newline at end of file
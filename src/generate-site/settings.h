@@ -8,6 +8,11 @@ extern char *g_set_fmt_file;
 extern char *g_set_secname;
 extern char *g_set_sqlquery;
 extern char *g_set_output_file;
+extern char *g_set_trace;
+extern char *g_set_customer;
+extern char *g_set_customer_prefix;
+extern long g_set_date_from;
+extern long g_set_date_to;
 
 
 void settings_load_defaults (void);
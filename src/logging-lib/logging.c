@@ -1,7 +1,14 @@
 
 #include "logging.h"
 
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
 
 
 /* variable declarations */
@@ -19,10 +26,51 @@ static char *s_log_filepath = NULL;
 static FILE *s_log_file = NULL;
 
 
+/* async logging. producers format each message into one or more slots of
+ * a bounded ring, and a single writer thread copies them out to their 
+ * streams. the ring is lock free for producers: every slot carries a 
+ * sequence number saying whether it is free or filled for a given ticket
+ * (see Dmitry Vyukov's bounded queue). a message needing k slots claims k
+ * consecutive tickets at once, so it is never interleaved with another. */
+#define LOG_SLOT_TEXT   240
+#define LOG_WRITE_BATCH (64 * 1024)
+#define LOG_IDLE_NS     (5 * 1000 * 1000)
+
+typedef struct
+{
+    atomic_size_t sequence;
+    FILE *stream;
+    unsigned short length;
+    char text[LOG_SLOT_TEXT];
+} log_slot_t;
+
+static struct
+{
+    log_slot_t *slots;
+    size_t mask;                    /* slot count is a power of two */
+    logging_overflow_t overflow;
+
+    atomic_size_t enqueue;          /* next ticket for producers */
+    size_t dequeue;                 /* next ticket for the writer */
+
+    atomic_size_t dropped;
+    atomic_int stop;
+
+    thrd_t writer;
+    mtx_t lock;                     /* only guards the writer's sleep */
+    cnd_t wake;
+} s_async;
+static atomic_int s_async_active = 0;
+
+
 /* file static function prototypes */
 static void logging_clear (void);
 static void logging_set (logging_mode_t mode);
 
+static int  async_enqueue (FILE *stream, const char *text, size_t length);
+static int  async_writer (void *arg);
+static void async_flush (FILE *stream, char *batch, size_t *used);
+
 
 /* console logging */
 static void
@@ -75,6 +123,7 @@ logging_init (logging_mode_t mode, char *logfilepath)
 void
 logging_quit (void)
 {
+    logging_stop_async ();
     logging_clear ();
     s_log_mode = LOG_UNINITIALIZED;
 
@@ -91,6 +140,290 @@ logging_get_mode (void)
 }
 
 
+/* write a message to stream, through the async buffer when it is running */
+int
+logging_write (FILE *stream, const char *format, ...)
+{
+    char local[1024];
+    char *text = local;
+    va_list args;
+    int length;
+
+    va_start (args, format);
+
+    if (!atomic_load_explicit (&s_async_active, memory_order_acquire))
+    {
+        length = vfprintf (stream, format, args);
+        va_end (args);
+        return length;
+    }
+
+    length = vsnprintf (local, sizeof (local), format, args);
+    va_end (args);
+    if (length < 0) return length;
+
+    /* too long for the stack */
+    if ((size_t)length >= sizeof (local))
+    {
+        text = malloc ((size_t)length + 1);
+        if (text == NULL) return -1;
+
+        va_start (args, format);
+        (void)vsnprintf (text, (size_t)length + 1, format, args);
+        va_end (args);
+    }
+
+    (void)async_enqueue (stream, text, (size_t)length);
+
+    if (text != local) free (text);
+    return length;
+}
+
+
+/* start a writer thread, and route every message through a buffer of 
+ * slots, each holding up to 240 bytes of a message. a no op if slots is
+ * 0. stopped by logging_quit(), or at exit */
+int
+logging_start_async (size_t slots, logging_overflow_t overflow)
+{
+    static int s_registered = 0;
+    size_t count = 2;
+
+    if ((slots == 0) || atomic_load (&s_async_active)) return 0;
+
+    /* a power of two, and room for at least one long message */
+    while (count < slots) count <<= 1;
+
+    s_async.slots = calloc (count, sizeof (log_slot_t));
+    if (s_async.slots == NULL) return 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        atomic_init (&s_async.slots[i].sequence, i);
+    }
+
+    s_async.mask = count - 1;
+    s_async.overflow = overflow;
+    s_async.dequeue = 0;
+    atomic_store (&s_async.enqueue, 0);
+    atomic_store (&s_async.dropped, 0);
+    atomic_store (&s_async.stop, 0);
+
+    if ((mtx_init (&s_async.lock, mtx_plain) != thrd_success) ||
+        (cnd_init (&s_async.wake) != thrd_success) ||
+        (thrd_create (&s_async.writer, async_writer, NULL) != thrd_success))
+    {
+        free (s_async.slots);
+        s_async.slots = NULL;
+        return 1;
+    }
+
+    atomic_store_explicit (&s_async_active, 1, memory_order_release);
+
+    /* make sure the buffer is written out, however the program ends */
+    if (!s_registered) s_registered = !atexit (logging_stop_async);
+
+    return 0;
+}
+
+
+/* write out everything buffered and stop the writer thread. no other 
+ * thread may be logging */
+void
+logging_stop_async (void)
+{
+    size_t dropped;
+
+    if (!atomic_load (&s_async_active)) return;
+
+    atomic_store (&s_async.stop, 1);
+    (void)cnd_signal (&s_async.wake);
+    (void)thrd_join (s_async.writer, NULL);
+
+    atomic_store_explicit (&s_async_active, 0, memory_order_release);
+
+    cnd_destroy (&s_async.wake);
+    mtx_destroy (&s_async.lock);
+    free (s_async.slots);
+    s_async.slots = NULL;
+
+    dropped = atomic_load (&s_async.dropped);
+    if (dropped && g_warning) 
+    {
+        (void)fprintf (g_warning, "warning: %zu log messages dropped\n", dropped);
+    }
+
+    return;
+}
+
+
+/* messages thrown away by LOG_OVERFLOW_DROP so far */
+size_t
+logging_dropped (void)
+{
+    return atomic_load (&s_async.dropped);
+}
+
+
+static int
+async_enqueue (FILE *stream, const char *text, size_t length)
+{
+    size_t capacity = s_async.mask + 1;
+    size_t count = (length + LOG_SLOT_TEXT - 1) / LOG_SLOT_TEXT;
+    size_t ticket;
+
+    /* a message may take at most half the ring */
+    if (count == 0) count = 1;
+    if (count > capacity / 2)
+    {
+        count = capacity / 2;
+        length = count * LOG_SLOT_TEXT;
+    }
+
+    /* claim count tickets. the writer frees slots in ticket order, so if
+     * the last one is free so are the rest */
+    ticket = atomic_load_explicit (&s_async.enqueue, memory_order_relaxed);
+    for (;;)
+    {
+        size_t last = ticket + count - 1;
+        log_slot_t *slot = &s_async.slots[last & s_async.mask];
+        size_t sequence = atomic_load_explicit (&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)last;
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit (&s_async.enqueue, 
+                    &ticket, ticket + count, 
+                    memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            /* full */
+            if (s_async.overflow == LOG_OVERFLOW_DROP)
+            {
+                (void)atomic_fetch_add (&s_async.dropped, 1);
+                return 1;
+            }
+
+            (void)cnd_signal (&s_async.wake);
+            thrd_yield ();
+            ticket = atomic_load_explicit (&s_async.enqueue, memory_order_relaxed);
+        }
+        else
+        {
+            ticket = atomic_load_explicit (&s_async.enqueue, memory_order_relaxed);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        log_slot_t *slot = &s_async.slots[(ticket + i) & s_async.mask];
+        size_t chunk = length - (i * LOG_SLOT_TEXT);
+        if (chunk > LOG_SLOT_TEXT) chunk = LOG_SLOT_TEXT;
+
+        memcpy (slot->text, text + (i * LOG_SLOT_TEXT), chunk);
+        slot->length = (unsigned short)chunk;
+        slot->stream = stream;
+
+        atomic_store_explicit (&slot->sequence, ticket + i + 1, memory_order_release);
+    }
+
+    /* hurry the writer along before the ring fills */
+    if ((ticket & (capacity / 2 - 1)) + count > capacity / 2) 
+    {
+        (void)cnd_signal (&s_async.wake);
+    }
+
+    return 0;
+}
+
+
+/* the only consumer. gathers runs of messages to the same stream into one
+ * write, and flushes whenever the ring runs dry */
+static int
+async_writer (void *arg)
+{
+    static char s_batch[LOG_WRITE_BATCH];
+    size_t used = 0;
+    FILE *current = NULL;
+    int dirty = 0;
+
+    (void)arg;
+
+    for (;;)
+    {
+        log_slot_t *slot = &s_async.slots[s_async.dequeue & s_async.mask];
+        size_t sequence = atomic_load_explicit (&slot->sequence, memory_order_acquire);
+
+        if (sequence == s_async.dequeue + 1)
+        {
+            if ((slot->stream != current) || (used + slot->length > sizeof (s_batch)))
+            {
+                async_flush (current, s_batch, &used);
+                current = slot->stream;
+            }
+
+            memcpy (s_batch + used, slot->text, slot->length);
+            used += slot->length;
+            dirty = 1;
+
+            /* hand the slot back for the ticket one lap ahead */
+            atomic_store_explicit (&slot->sequence, 
+                                   s_async.dequeue + s_async.mask + 1, 
+                                   memory_order_release);
+            s_async.dequeue++;
+            continue;
+        }
+
+        /* nothing ready */
+        async_flush (current, s_batch, &used);
+        if (dirty) (void)fflush (NULL);
+        dirty = 0;
+
+        /* producers only ever claim tickets before stop is set, and a 
+         * claimed ticket is always filled in */
+        if (atomic_load (&s_async.stop) && 
+            (atomic_load (&s_async.enqueue) == s_async.dequeue))
+        {
+            break;
+        }
+
+        /* producers do not signal every message, so sleep briefly */
+        {
+            struct timespec until;
+            (void)timespec_get (&until, TIME_UTC);
+            until.tv_nsec += LOG_IDLE_NS;
+            if (until.tv_nsec >= 1000000000L)
+            {
+                until.tv_sec += 1;
+                until.tv_nsec -= 1000000000L;
+            }
+
+            (void)mtx_lock (&s_async.lock);
+            (void)cnd_timedwait (&s_async.wake, &s_async.lock, &until);
+            (void)mtx_unlock (&s_async.lock);
+        }
+    }
+
+    return 0;
+}
+
+
+static void
+async_flush (FILE *stream, char *batch, size_t *used)
+{
+    if ((stream != NULL) && (*used > 0))
+    {
+        (void)fwrite (batch, 1, *used, stream);
+    }
+    *used = 0;
+
+    return;
+}
+
+
 /* file logging */
 int
 logging_init_file (char *logfilepath)
@@ -3,6 +3,7 @@
 #define INVOICE_LOGGING_HEADER
 
 
+#include <stddef.h>
 #include <stdio.h>
 
 /* definition */
@@ -25,13 +26,48 @@ typedef enum
 } logging_mode_t;
 
 
+/* what to do when a message does not fit in the async buffer */
+typedef enum
+{
+    LOG_OVERFLOW_BLOCK,     /* wait for the writer thread to catch up */
+    LOG_OVERFLOW_DROP,      /* throw the message away, and count it */
+} logging_overflow_t;
+
+
+/* the most detailed level compiled in, lower levels compile to nothing. 
+ * the values follow logging_mode_t, debug messages are left out of 
+ * release builds */
+#define LOGGING_LEVEL_ERRORS_ONLY 2
+#define LOGGING_LEVEL_TERSE       3
+#define LOGGING_LEVEL_VERBOSE     4
+#define LOGGING_LEVEL_DEBUG       5
+
+#ifndef LOGGING_MIN_LEVEL
+#   define LOGGING_MIN_LEVEL LOGGING_LEVEL_DEBUG
+#endif
+
+/* arguements of a compiled out message are still type checked, but never
+ * evaluated */
+#define LOG_DISCARD(...) ((void)sizeof (fprintf (stderr, __VA_ARGS__)))
+
 /* format should always be an implicit c compile time constant for the 
  * "warning: " and "error: " prefixes to work properly */
-#define log_info(...)    (void)((!g_info)    || (fprintf (g_info, __VA_ARGS__)))
-#define log_verbose(...) (void)((!g_verbose) || (fprintf (g_verbose, "verbose: " __VA_ARGS__)))
-#define log_debug(...)   (void)((!g_debug)   || (fprintf (g_debug, "debug: " __VA_ARGS__)))
-#define log_warning(...) (void)((!g_warning) || (fprintf (g_warning, "warning: " __VA_ARGS__)))
-#define log_error(...)   (void)((!g_error)   || (fprintf (g_error, "error: " __VA_ARGS__)))
+#define log_info(...)    (void)((!g_info)    || (logging_write (g_info, __VA_ARGS__)))
+#define log_error(...)   (void)((!g_error)   || (logging_write (g_error, "error: " __VA_ARGS__)))
+
+#if LOGGING_MIN_LEVEL >= LOGGING_LEVEL_VERBOSE
+#   define log_verbose(...) (void)((!g_verbose) || (logging_write (g_verbose, "verbose: " __VA_ARGS__)))
+#   define log_warning(...) (void)((!g_warning) || (logging_write (g_warning, "warning: " __VA_ARGS__)))
+#else
+#   define log_verbose(...) LOG_DISCARD ("verbose: " __VA_ARGS__)
+#   define log_warning(...) LOG_DISCARD ("warning: " __VA_ARGS__)
+#endif
+
+#if LOGGING_MIN_LEVEL >= LOGGING_LEVEL_DEBUG
+#   define log_debug(...)   (void)((!g_debug)   || (logging_write (g_debug, "debug: " __VA_ARGS__)))
+#else
+#   define log_debug(...)   LOG_DISCARD ("debug: " __VA_ARGS__)
+#endif
 
 #define log_unimplemented() { \
     log_debug ("%s:%d: %s(): unimplemented\n", __FILE__, __LINE__, __FUNCTION__); \
@@ -45,6 +81,11 @@ void logging_init (logging_mode_t mode, char *logfilepath);
 void logging_quit (void);
 logging_mode_t logging_get_mode (void);
 
+int    logging_write (FILE *stream, const char *format, ...);
+int    logging_start_async (size_t slots, logging_overflow_t overflow);
+void   logging_stop_async (void);
+size_t logging_dropped (void);
+
 int   logging_init_file (char *logfilepath);
 int   logging_quit_file (void);
 char *logging_get_filepath (void);
@@ -3,74 +3,278 @@
 
 #include <errno.h>
 #include <logging-lib/logging.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined(_WIN32)
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#   define LINEREADER_MMAP 1
+#else
+#   define LINEREADER_MMAP 0
+#endif
 
-/* designed to work on any stream */
+#define LINEREADER_BLOCK (64 * 1024)
+
+
+static int   map_stream (linereader_t *reader);
+static char *mapped_tail (linereader_t *reader, size_t *length);
+static int   fill_buffer (linereader_t *reader);
+
+
+/* designed to work on any stream, not reentrant. the line is only valid 
+ * until the next call */
 char *
 readline (FILE *stream)
 {
-    /* note: s_result IS a memory leak, BUT ITS FAST THOO! :/
-     *       it should probably be declared outside the function scope, so it 
-     *       can be freed later. */
-    static char *s_result = NULL;       /* reuse buffer between calls */
-    static size_t s_alloc = 0;          /* reuse alloc between calls */
-    const size_t DEFAULT_ALLOC = 2;     /* initial buffer length */
-
-    int c;              /* character */
-    size_t i = 0;       /* iterator/length */
+    /* note: s_reader IS a memory leak, BUT ITS FAST THOO! :/ */
+    static linereader_t s_reader = { NULL, '\n', NULL, 0, 0, 0, 0, 0, NULL };
 
-    void *tmp = NULL;   /* realloc overhead */
-
-    
     /* null guard */
     if (stream == NULL) return NULL;
 
-    /* if stream is at end of file, return NULL */
-    if (feof (stream)) return NULL;
+    /* buffered data belongs to the stream it was read from */
+    if (s_reader.stream != stream)
+    {
+        linereader_free (&s_reader);
+        linereader_init (&s_reader, stream);
+    }
+
+    return linereader_next (&s_reader);
+}
+
+
+void
+linereader_init (linereader_t *reader, FILE *stream)
+{
+    reader->stream    = stream;
+    reader->delimiter = '\n';
+    reader->buffer    = NULL;
+    reader->alloc     = 0;
+    reader->begin     = 0;
+    reader->end       = 0;
+    reader->mapped    = 0;
+    reader->eof       = 0;
+    reader->tail      = NULL;
+
+    return;
+}
+
+
+/* split on delimiter instead of newlines, '\0' reads the output of 
+ * find -print0. must be called before the first line is read. */
+void
+linereader_set_delimiter (linereader_t *reader, char delimiter)
+{
+    reader->delimiter = delimiter;
+
+    return;
+}
+
 
-    /* first time initialize */
-    if (s_result == NULL)
+void
+linereader_free (linereader_t *reader)
+{
+#if LINEREADER_MMAP
+    if (reader->mapped)
     {
-        s_result = malloc (DEFAULT_ALLOC + 1);
-        if (!s_result) return NULL;
-        s_alloc = DEFAULT_ALLOC;
+        (void)munmap (reader->buffer, reader->alloc);
+        reader->buffer = NULL;
     }
+#endif
+    free (reader->buffer);
+    free (reader->tail);
+    linereader_init (reader, NULL);
+
+    return;
+}
+
+
+/* reentrant readline(), the line belongs to reader and is valid until the 
+ * next call with the same reader */
+char *
+linereader_next (linereader_t *reader)
+{
+    return linereader_next_n (reader, NULL);
+}
 
-    /* append characters until buffer is empty or newline is found */
-    while (c = fgetc (stream), !feof(stream))
+
+/* linereader_next(), also returning the length of the line. the line 
+ * points into the reader's buffer, it may be modified but not extended. */
+char *
+linereader_next_n (linereader_t *reader, size_t *length)
+{
+    char *line = NULL;
+    char *found = NULL;
+    size_t line_len;
+
+    /* null guard */
+    if ((reader == NULL) || (reader->stream == NULL)) return NULL;
+
+    /* map regular files on the first call */
+    if ((reader->buffer == NULL) && (!reader->eof))
     {
-        if ((c == '\n') || (c == '\r') || (c == EOF)) break;
+        if (map_stream (reader) < 0) return NULL;
+    }
 
-        if (i >= s_alloc)
+    for (;;)
+    {
+        if (reader->end > reader->begin)
         {
-            /* handle size_t overflow */
-            if (SIZE_MAX / 2 < s_alloc)
-            {
-                errno = ERANGE;
-                return NULL;
-            }
-
-            /* extend s_result */
-            tmp = realloc (s_result, s_alloc * 2 + 1);
-            if (tmp == NULL) return NULL;
-            s_result = tmp;
-            s_alloc *= 2;
+            found = memchr (reader->buffer + reader->begin, reader->delimiter, 
+                            reader->end - reader->begin);
+            if (found) break;
         }
 
-        /* store the character in our buffer */
-        s_result[i] = (char)c;
+        /* out of data, hand out whatever is left as the last line */
+        if (reader->eof)
+        {
+            if (reader->begin >= reader->end) return NULL;
+            if (reader->mapped) return mapped_tail (reader, length);
 
-        /* update the iterator */
-        i++; 
+            /* fill_buffer always leaves room for this terminator */
+            found = reader->buffer + reader->end;
+            break;
+        }
+
+        if (fill_buffer (reader)) return NULL;
+    }
+
+    line = reader->buffer + reader->begin;
+    line_len = (size_t)(found - line);
+    reader->begin += line_len + 1;
+    if (reader->begin > reader->end) reader->begin = reader->end;
+
+    *found = '\0';
+    if ((reader->delimiter == '\n') && (line_len > 0) && 
+        (line[line_len - 1] == '\r'))
+    {
+        line[--line_len] = '\0';
+    }
+
+    if (length) *length = line_len;
+    return line;
+}
+
+
+/* map stream if it is a regular file, returns 1 if it was mapped, 0 if 
+ * it should be read instead, and -1 on error */
+static int
+map_stream (linereader_t *reader)
+{
+#if LINEREADER_MMAP
+    struct stat st;
+    int fd = fileno (reader->stream);
+    long offset = ftell (reader->stream);
+    void *map = NULL;
+
+    if ((fd < 0) || (offset < 0) || (fstat (fd, &st) != 0)) return 0;
+    if ((!S_ISREG (st.st_mode)) || (st.st_size <= offset)) return 0;
+    if ((unsigned long long)st.st_size > SIZE_MAX) return 0;
+
+    /* private, so lines can be terminated in place without touching the
+     * file itself */
+    map = mmap (NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, 
+                MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return 0;
+
+#   if defined(MADV_SEQUENTIAL)
+    (void)madvise (map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#   endif
+
+    reader->buffer = map;
+    reader->alloc  = (size_t)st.st_size;
+    reader->begin  = (size_t)offset;
+    reader->end    = (size_t)st.st_size;
+    reader->mapped = 1;
+    reader->eof    = 1;
+
+    /* leave the stream where a reader would have */
+    (void)fseek (reader->stream, 0, SEEK_END);
+
+    return 1;
+#else
+    (void)reader;
+    return 0;
+#endif
+}
+
+
+/* the last line of a mapped file has no room for a terminator, copy it */
+static char *
+mapped_tail (linereader_t *reader, size_t *length)
+{
+    size_t line_len = reader->end - reader->begin;
+
+    free (reader->tail);
+    reader->tail = malloc (line_len + 1);
+    if (reader->tail == NULL) return NULL;
+
+    memcpy (reader->tail, reader->buffer + reader->begin, line_len);
+    reader->tail[line_len] = '\0';
+    reader->begin = reader->end;
+
+    if ((reader->delimiter == '\n') && (line_len > 0) && 
+        (reader->tail[line_len - 1] == '\r'))
+    {
+        reader->tail[--line_len] = '\0';
+    }
+
+    if (length) *length = line_len;
+    return reader->tail;
+}
+
+
+/* read the next block, keeping the unread part of the buffer. returns 
+ * non zero on error */
+static int
+fill_buffer (linereader_t *reader)
+{
+    size_t unread = reader->end - reader->begin;
+    size_t got;
+    char *tmp = NULL;
+
+    /* move the partial line to the front */
+    if (reader->begin > 0)
+    {
+        memmove (reader->buffer, reader->buffer + reader->begin, unread);
+        reader->begin = 0;
+        reader->end = unread;
     }
 
-    /* append the null terminator */
-    s_result[i] = '\0';
+    /* grow when a single line fills the whole buffer, there is always one
+     * spare byte past alloc for a terminator */
+    if ((reader->buffer == NULL) || (reader->end == reader->alloc))
+    {
+        size_t alloc = (reader->alloc ? reader->alloc * 2 : LINEREADER_BLOCK);
+
+        /* handle size_t overflow */
+        if (alloc < reader->alloc)
+        {
+            errno = ERANGE;
+            return 1;
+        }
+
+        tmp = realloc (reader->buffer, alloc + 1);
+        if (tmp == NULL) return 1;
+        reader->buffer = tmp;
+        reader->alloc = alloc;
+    }
+
+    got = fread (reader->buffer + reader->end, 1, 
+                 reader->alloc - reader->end, reader->stream);
+    reader->end += got;
+
+    if (got == 0)
+    {
+        if (ferror (reader->stream)) return 1;
+        reader->eof = 1;
+    }
 
-    return s_result;
+    return 0;
 }
 
 
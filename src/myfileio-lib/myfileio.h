@@ -2,11 +2,35 @@
 #ifndef INVOICE_MYFILEIO_HEADER
 #define INVOICE_MYFILEIO_HEADER
 
+#include <stddef.h>
 #include <stdio.h>
 
+/* reads a stream in large blocks, handing out lines in place. regular 
+ * files are mapped into memory instead, where the platform allows it. */
+typedef struct
+{
+    FILE *stream;
+    char delimiter;     /* '\n' (a preceeding '\r' is dropped) or '\0' */
+
+    char *buffer;       /* read buffer, or the mapped file */
+    size_t alloc;       /* bytes allocated, or mapped */
+    size_t begin;       /* first byte not yet handed out */
+    size_t end;         /* one past the last valid byte */
+    int mapped;
+    int eof;
+
+    char *tail;         /* copy of an unterminated last line when mapped */
+} linereader_t;
+
 /* stdin safe */
 char *readline (FILE *stream);
 
+void  linereader_init (linereader_t *reader, FILE *stream);
+void  linereader_set_delimiter (linereader_t *reader, char delimiter);
+void  linereader_free (linereader_t *reader);
+char *linereader_next (linereader_t *reader);
+char *linereader_next_n (linereader_t *reader, size_t *length);
+
 /* file only */
 char *freadline (FILE *stream);
 int ffindc (int character, FILE *stream);
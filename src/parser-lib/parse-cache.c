@@ -0,0 +1,380 @@
+#include "parse-cache.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+
+/* the cache is split into shards by hash, each behind its own lock, so
+ * parser threads rarely wait on each other. each shard holds a fixed 
+ * number of entries, found through a chained hash table and ordered on a
+ * doubly linked list from most to least recently used. once full, the 
+ * shard's least recently used entry is reused for each new filename. 
+ * links are entry indices, -1 ends a list. */
+#define PARSE_CACHE_SHARDS 16
+
+typedef struct
+{
+    uint64_t hash;
+    char *key;              /* filename, then name_raw, in one allocation */
+    size_t alloc;
+    size_t length;
+    int matched;
+
+    size_t name_offset;     /* parsed_t.name - parsed_t.name_raw */
+    char group_a[MAX_PARSED_GROUP + 1];
+    char group_b[MAX_PARSED_GROUP + 1];
+    char group_c[MAX_PARSED_GROUP + 1];
+    char group_d[MAX_PARSED_GROUP + 1];
+    int convention;
+
+    long chain;             /* next entry in the same bucket */
+    long newer;
+    long older;
+} parse_cache_entry_t;
+
+typedef struct
+{
+    mtx_t lock;
+    int lock_init;
+
+    parse_cache_entry_t *entries;
+    size_t capacity;
+    size_t count;
+
+    long *buckets;
+    size_t bucket_mask;     /* bucket count is a power of two */
+
+    long newest;
+    long oldest;
+} parse_cache_shard_t;
+
+struct parse_cache
+{
+    parse_cache_shard_t shards[PARSE_CACHE_SHARDS];
+
+    atomic_size_t hits;
+    atomic_size_t misses;
+};
+
+
+static int  shard_init (parse_cache_shard_t *shard, size_t capacity);
+static void shard_free (parse_cache_shard_t *shard);
+static parse_cache_shard_t *shard_of (parse_cache_t *cache, uint64_t hash);
+
+static long find_entry (const parse_cache_shard_t *shard, const char *key, 
+                        size_t length, uint64_t hash);
+static void unlink_bucket (parse_cache_shard_t *shard, long index);
+static void unlink_lru (parse_cache_shard_t *shard, long index);
+static void push_newest (parse_cache_shard_t *shard, long index);
+
+
+/* capacity is the total number of filenames, shared between the shards */
+parse_cache_t *
+parse_cache_create (size_t capacity)
+{
+    size_t shard_capacity = (capacity + PARSE_CACHE_SHARDS - 1) / PARSE_CACHE_SHARDS;
+    parse_cache_t *cache = NULL;
+
+    if (capacity == 0) return NULL;
+
+    cache = calloc (1, sizeof (parse_cache_t));
+    if (cache == NULL) return NULL;
+
+    for (size_t i = 0; i < PARSE_CACHE_SHARDS; i++)
+    {
+        if (shard_init (&cache->shards[i], shard_capacity))
+        {
+            parse_cache_destroy (cache);
+            return NULL;
+        }
+    }
+
+    atomic_init (&cache->hits, 0);
+    atomic_init (&cache->misses, 0);
+
+    return cache;
+}
+
+
+void
+parse_cache_destroy (parse_cache_t *cache)
+{
+    if (cache == NULL) return;
+
+    for (size_t i = 0; i < PARSE_CACHE_SHARDS; i++)
+    {
+        shard_free (&cache->shards[i]);
+    }
+    free (cache);
+
+    return;
+}
+
+
+/* FNV-1a */
+uint64_t
+parse_cache_hash (const char *key, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+/* on a hit the entry becomes the most recently used, and its result is 
+ * copied into result. result->filepath is left alone. safe to call from
+ * many threads at once. */
+parse_cache_result_t
+parse_cache_lookup (parse_cache_t *cache, const char *key, size_t length,
+                    uint64_t hash, parsed_t *result)
+{
+    parse_cache_shard_t *shard = shard_of (cache, hash);
+    parse_cache_entry_t *entry = NULL;
+    parse_cache_result_t retcode = PARSE_CACHE_HIT;
+    long index;
+
+    (void)mtx_lock (&shard->lock);
+
+    index = find_entry (shard, key, length, hash);
+    if (index < 0)
+    {
+        (void)mtx_unlock (&shard->lock);
+        (void)atomic_fetch_add (&cache->misses, 1);
+        return PARSE_CACHE_MISS;
+    }
+
+    unlink_lru (shard, index);
+    push_newest (shard, index);
+
+    entry = &shard->entries[index];
+    if (!entry->matched) 
+    {
+        retcode = PARSE_CACHE_HIT_NO_MATCH;
+        goto parse_cache_lookup_exit;
+    }
+
+    (void)strcpy (result->name_raw, entry->key + entry->length + 1);
+    result->name = result->name_raw + entry->name_offset;
+    memcpy (result->group_a, entry->group_a, sizeof (entry->group_a));
+    memcpy (result->group_b, entry->group_b, sizeof (entry->group_b));
+    memcpy (result->group_c, entry->group_c, sizeof (entry->group_c));
+    memcpy (result->group_d, entry->group_d, sizeof (entry->group_d));
+    result->convention = entry->convention;
+
+parse_cache_lookup_exit:
+    (void)mtx_unlock (&shard->lock);
+    (void)atomic_fetch_add (&cache->hits, 1);
+
+    return retcode;
+}
+
+
+/* remember the result for a filename, parsed is NULL if it did not parse.
+ * safe to call from many threads at once. */
+void
+parse_cache_store (parse_cache_t *cache, const char *key, size_t length,
+                   uint64_t hash, const parsed_t *parsed)
+{
+    parse_cache_shard_t *shard = shard_of (cache, hash);
+    size_t raw_length = (parsed ? strlen (parsed->name_raw) : 0);
+    size_t needed = length + 1 + raw_length + 1;
+    parse_cache_entry_t *entry = NULL;
+    long index;
+
+    (void)mtx_lock (&shard->lock);
+
+    /* another thread may have parsed the same name meanwhile */
+    if (find_entry (shard, key, length, hash) >= 0) goto parse_cache_store_exit;
+
+    /* take a free entry, or evict the least recently used. its key is 
+     * grown first, so failing leaves the shard as it was */
+    index = ((shard->count < shard->capacity) ? (long)shard->count : shard->oldest);
+    entry = &shard->entries[index];
+
+    if (entry->alloc < needed)
+    {
+        char *tmp = realloc (entry->key, needed);
+        if (tmp == NULL) goto parse_cache_store_exit;
+        entry->key = tmp;
+        entry->alloc = needed;
+    }
+
+    if (index == (long)shard->count)
+    {
+        shard->count++;
+    }
+    else
+    {
+        unlink_bucket (shard, index);
+        unlink_lru (shard, index);
+    }
+
+    memcpy (entry->key, key, length);
+    entry->key[length] = '\0';
+    if (parsed) memcpy (entry->key + length + 1, parsed->name_raw, raw_length);
+    entry->key[length + 1 + raw_length] = '\0';
+
+    entry->hash = hash;
+    entry->length = length;
+    entry->matched = (parsed != NULL);
+    if (parsed)
+    {
+        entry->name_offset = (size_t)(parsed->name - parsed->name_raw);
+        memcpy (entry->group_a, parsed->group_a, sizeof (entry->group_a));
+        memcpy (entry->group_b, parsed->group_b, sizeof (entry->group_b));
+        memcpy (entry->group_c, parsed->group_c, sizeof (entry->group_c));
+        memcpy (entry->group_d, parsed->group_d, sizeof (entry->group_d));
+        entry->convention = parsed->convention;
+    }
+
+    entry->chain = shard->buckets[hash & shard->bucket_mask];
+    shard->buckets[hash & shard->bucket_mask] = index;
+    push_newest (shard, index);
+
+parse_cache_store_exit:
+    (void)mtx_unlock (&shard->lock);
+
+    return;
+}
+
+
+size_t
+parse_cache_hits (parse_cache_t *cache)
+{
+    return (cache ? atomic_load (&cache->hits) : 0);
+}
+
+
+size_t
+parse_cache_misses (parse_cache_t *cache)
+{
+    return (cache ? atomic_load (&cache->misses) : 0);
+}
+
+
+static int
+shard_init (parse_cache_shard_t *shard, size_t capacity)
+{
+    size_t buckets = 1;
+
+    if (mtx_init (&shard->lock, mtx_plain) != thrd_success) return 1;
+    shard->lock_init = 1;
+
+    /* around two buckets per entry keeps the chains short */
+    while (buckets < capacity * 2) buckets <<= 1;
+
+    shard->entries = calloc (capacity, sizeof (parse_cache_entry_t));
+    shard->buckets = malloc (buckets * sizeof (long));
+    if ((shard->entries == NULL) || (shard->buckets == NULL)) return 1;
+
+    for (size_t i = 0; i < buckets; i++) shard->buckets[i] = -1;
+
+    shard->capacity = capacity;
+    shard->bucket_mask = buckets - 1;
+    shard->newest = -1;
+    shard->oldest = -1;
+
+    return 0;
+}
+
+
+static void
+shard_free (parse_cache_shard_t *shard)
+{
+    if (shard->entries != NULL)
+    {
+        for (size_t i = 0; i < shard->count; i++) free (shard->entries[i].key);
+    }
+    free (shard->entries);
+    free (shard->buckets);
+    if (shard->lock_init) mtx_destroy (&shard->lock);
+
+    shard->entries = NULL;
+    shard->buckets = NULL;
+    shard->lock_init = 0;
+
+    return;
+}
+
+
+/* the high bits pick the shard, the low bits pick the bucket */
+static parse_cache_shard_t *
+shard_of (parse_cache_t *cache, uint64_t hash)
+{
+    return &cache->shards[(hash >> 60) % PARSE_CACHE_SHARDS];
+}
+
+
+static long
+find_entry (const parse_cache_shard_t *shard, const char *key, size_t length, 
+            uint64_t hash)
+{
+    long index = shard->buckets[hash & shard->bucket_mask];
+
+    while (index >= 0)
+    {
+        const parse_cache_entry_t *entry = &shard->entries[index];
+        if ((entry->hash == hash) && (entry->length == length) &&
+            (memcmp (entry->key, key, length) == 0))
+        {
+            return index;
+        }
+        index = entry->chain;
+    }
+
+    return -1;
+}
+
+
+static void
+unlink_bucket (parse_cache_shard_t *shard, long index)
+{
+    long *link = &shard->buckets[shard->entries[index].hash & shard->bucket_mask];
+
+    while (*link != index) link = &shard->entries[*link].chain;
+    *link = shard->entries[index].chain;
+
+    return;
+}
+
+
+static void
+unlink_lru (parse_cache_shard_t *shard, long index)
+{
+    parse_cache_entry_t *entry = &shard->entries[index];
+
+    if (entry->newer >= 0) shard->entries[entry->newer].older = entry->older;
+    else                   shard->newest = entry->older;
+
+    if (entry->older >= 0) shard->entries[entry->older].newer = entry->newer;
+    else                   shard->oldest = entry->newer;
+
+    return;
+}
+
+
+static void
+push_newest (parse_cache_shard_t *shard, long index)
+{
+    parse_cache_entry_t *entry = &shard->entries[index];
+
+    entry->newer = -1;
+    entry->older = shard->newest;
+
+    if (shard->newest >= 0) shard->entries[shard->newest].newer = index;
+    shard->newest = index;
+    if (shard->oldest < 0) shard->oldest = index;
+
+    return;
+}
+
+
+/* end of file */
@@ -0,0 +1,40 @@
+#ifndef INVOICE_PARSE_CACHE_HEADER
+#define INVOICE_PARSE_CACHE_HEADER
+
+#include "parser.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* private to parser-lib, parse results remembered by filename. the date
+ * is not kept, only the groups it is read from, since whether a date is
+ * valid depends on the day. every function is safe to call from many 
+ * threads at once. */
+
+typedef struct parse_cache parse_cache_t;
+
+typedef enum
+{
+    PARSE_CACHE_MISS,
+    PARSE_CACHE_HIT,            /* result was copied out */
+    PARSE_CACHE_HIT_NO_MATCH,   /* the filename is known not to parse */
+} parse_cache_result_t;
+
+
+parse_cache_t *parse_cache_create (size_t capacity);
+void parse_cache_destroy (parse_cache_t *cache);
+
+uint64_t parse_cache_hash (const char *key, size_t length);
+
+parse_cache_result_t parse_cache_lookup (parse_cache_t *cache, 
+                                         const char *key, size_t length,
+                                         uint64_t hash, parsed_t *result);
+void parse_cache_store (parse_cache_t *cache, const char *key, size_t length,
+                        uint64_t hash, const parsed_t *parsed);
+
+size_t parse_cache_hits (parse_cache_t *cache);
+size_t parse_cache_misses (parse_cache_t *cache);
+
+
+#endif /* header guard */
+/* end of file */
@@ -0,0 +1,1377 @@
+#include "parser.h"
+
+#include "parse-cache.h"
+#include <date-lib/date.h>
+#include <logging-lib/logging.h>
+#include <myfileio-lib/myfileio.h>
+#include <mystring-lib/mystring.h>
+#define PCRE2_STATIC
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#include <stats-lib/stats.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* a naming convention. the first group of pattern captures the customer 
+ * name, the digits of the groups after it are joined to make the date */
+typedef struct
+{
+    char *name;
+    char *pattern;
+    char *literals;     /* text any match must contain, as "a\0b\0\0", or NULL */
+    pcre2_code *re;     /* the pattern on its own */
+    int re_jit;
+} convention_t;
+
+/* the built in convention, used unless others are added. the scanner is 
+ * an exact stand in for this pattern */
+static const char *S_DEFAULT_NAME = "invoice";
+static const char *S_DEFAULT_PATTERN = 
+        "^(.*?)(\\d{2})(\\d{2}).*?(\\d{2})(\\d{2}).*\\.pdf";
+
+static convention_t *s_conventions = NULL;
+static size_t s_convention_count = 0;
+static int s_default_conventions = 0;
+
+/* every convention compiled into a single alternation, see 
+ * compile_conventions() */
+static pcre2_code *s_re = NULL;
+static int s_re_jit = 0;            /* pattern was compiled by the JIT */
+static int s_prefilter = 0;         /* some convention has literals */
+
+/* capture groups of the default convention */
+enum 
+{
+    MATCH,
+    GROUP_NAME,
+    GROUP_DATE_A,
+    GROUP_DATE_B,
+    GROUP_DATE_C,
+    GROUP_DATE_D,
+    GROUP_COUNT,
+};
+
+/* JIT stack limits, the default 32KiB on the machine stack is too small
+ * for long paths */
+#define PARSER_JIT_STACK_MIN (32 * 1024)
+#define PARSER_JIT_STACK_MAX (512 * 1024)
+
+
+/* everything a single thread needs to parse paths */
+struct parser_ctx
+{
+    pcre2_match_data *match_data;
+    pcre2_match_context *match_context;
+    pcre2_jit_stack *jit_stack;         /* NULL without the JIT */
+    parsed_t result;
+};
+static parser_ctx_t *s_default_ctx = NULL;
+static int s_use_jit = 1;
+static size_t s_cache_size = 0;
+static parse_cache_t *s_cache = NULL;  /* shared by every context */
+
+/* --stats stages */
+static int s_stage_parse = -1;
+static int s_stage_date = -1;
+static parser_matcher_t s_matcher = PARSER_MATCHER_SCAN;
+static int s_scan_usable = 0;       /* the scanner agrees with PCRE2 here */
+
+
+/* the scanner works on a bitmap of digit positions, longer names go to 
+ * PCRE2 instead */
+#define SCAN_MAX_LENGTH 1024
+#define SCAN_WORDS      (SCAN_MAX_LENGTH / 64 + 1)
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#   include <emmintrin.h>
+#   define SCAN_SSE2 1
+#else
+#   define SCAN_SSE2 0
+#endif
+
+
+static int  compile_conventions (void);
+static void free_conventions (void);
+static pcre2_code *compile_pattern (const char *pattern, const char *name);
+static char *required_literals (const char *pattern);
+static size_t skip_group (const char *pattern, size_t i);
+static size_t skip_class (const char *pattern, size_t i);
+static size_t quantifier_length (const char *pattern, size_t i);
+static int  has_literals (const convention_t *conv, const char *filename);
+static int  match_pattern (parser_ctx_t *ctx, pcre2_code *re, int jit, 
+                           const char *filename, size_t length);
+
+static void re_group (char *dst, size_t n, PCRE2_SPTR subject, PCRE2_SIZE *ovector, int i);
+static parsed_t *preform_regex_match (parser_ctx_t *ctx, char *filename);
+static parsed_t *preform_scan_match (parser_ctx_t *ctx, char *filename);
+static parsed_t *store_groups (parser_ctx_t *ctx, const char *filename, 
+                               PCRE2_SIZE *ovector, int groups, int convention);
+
+static int    scan_filename (const char *filename, size_t length, PCRE2_SIZE *ovector);
+static void   digit_bitmap (const char *s, size_t length, uint64_t *bits);
+static size_t find_digit_run4 (const uint64_t *bits, size_t length, size_t from);
+static int    count_trailing_zeros (uint64_t x);
+
+static parsed_t *parse_filename (parser_ctx_t *ctx, char *filename);
+static void      parse_date (parsed_t *parsed);
+
+
+/* choose between the JIT and the interpreter, must be called before 
+ * parser_init(). the JIT is used by default, where PCRE2 supports it. */
+void
+parser_set_jit (int enabled)
+{
+    s_use_jit = enabled;
+
+    return;
+}
+
+
+/* choose how filenames are matched, see parser_matcher_t */
+void
+parser_set_matcher (parser_matcher_t matcher)
+{
+    s_matcher = matcher;
+
+    return;
+}
+
+
+/* remember the last n filenames parsed, 0 turns the cache off. every 
+ * context shares the cache, so a name is parsed once whichever thread 
+ * sees it first. must be called before parser_init(). */
+void
+parser_set_cache_size (size_t n)
+{
+    s_cache_size = n;
+
+    return;
+}
+
+
+/* cache hits and misses since parser_init() */
+void
+parser_cache_stats (size_t *hits, size_t *misses)
+{
+    if (hits)   *hits   = parse_cache_hits (s_cache);
+    if (misses) *misses = parse_cache_misses (s_cache);
+
+    return;
+}
+
+
+/* returns true if the patterns are JIT compiled */
+int
+parser_jit_enabled (void)
+{
+    return s_re_jit;
+}
+
+
+/* add a naming convention, conventions are tried in the order they are 
+ * added. must be called before parser_init(), returns non zero on error */
+int
+parser_add_convention (const char *name, const char *pattern)
+{
+    convention_t *tmp = NULL;
+    convention_t *conv = NULL;
+    pcre2_code *re = NULL;
+    uint32_t groups = 0;
+
+    /* check the pattern on its own, for a clearer error */
+    re = compile_pattern (pattern, name);
+    if (re == NULL) return 1;
+
+    (void)pcre2_pattern_info (re, PCRE2_INFO_CAPTURECOUNT, &groups);
+    if (groups < 2)
+    {
+        log_error ("pattern '%s' needs a name group and at least one date "
+                   "group\n", name);
+        pcre2_code_free (re);
+        return 1;
+    }
+
+    tmp = realloc (s_conventions, (s_convention_count + 1) * sizeof (convention_t));
+    if (tmp == NULL) { pcre2_code_free (re); return 1; }
+    s_conventions = tmp;
+
+    /* kept, to match on its own when the others are ruled out */
+    conv = &s_conventions[s_convention_count];
+    conv->name     = malloc (strlen (name) + 1);
+    conv->pattern  = malloc (strlen (pattern) + 1);
+    conv->literals = required_literals (pattern);
+    conv->re       = re;
+    conv->re_jit   = 0;
+    if ((conv->name == NULL) || (conv->pattern == NULL))
+    {
+        free (conv->name);
+        free (conv->pattern);
+        free (conv->literals);
+        pcre2_code_free (conv->re);
+        return 1;
+    }
+    strcpy (conv->name, name);
+    strcpy (conv->pattern, pattern);
+
+    s_convention_count++;
+    return 0;
+}
+
+
+/* add every convention in a pattern file. each line is "name = pattern",
+ * blank lines and lines starting with '#' are skipped. returns non zero 
+ * on error */
+int
+parser_load_patterns (const char *filepath)
+{
+    FILE *fp = NULL;
+    linereader_t reader;
+    char *line = NULL;
+    size_t line_number = 0;
+    int retcode = 0;
+
+    fp = fopen (filepath, "rb");
+    if (fp == NULL)
+    {
+        log_error ("Failed to open pattern file '%s'\n", filepath);
+        return 1;
+    }
+
+    linereader_init (&reader, fp);
+    while ((line = linereader_next (&reader)))
+    {
+        char *name = NULL;
+        char *pattern = NULL;
+        char *equals = NULL;
+
+        line_number++;
+        line = trim_whitespace (line);
+        if (is_empty (line) || (line[0] == '#')) continue;
+
+        equals = strchr (line, '=');
+        if (equals == NULL)
+        {
+            log_error ("%s:%zu: expected 'name = pattern'\n", 
+                       filepath, line_number);
+            retcode = 1;
+            break;
+        }
+
+        *equals = '\0';
+        name = trim_whitespace (line);
+        pattern = trim_whitespace (equals + 1);
+        if (is_empty (name) || is_empty (pattern))
+        {
+            log_error ("%s:%zu: expected 'name = pattern'\n", 
+                       filepath, line_number);
+            retcode = 1;
+            break;
+        }
+
+        if (parser_add_convention (name, pattern))
+        {
+            log_error ("%s:%zu: bad pattern\n", filepath, line_number);
+            retcode = 1;
+            break;
+        }
+    }
+    linereader_free (&reader);
+    (void)fclose (fp);
+
+    if ((retcode == 0) && (s_convention_count == 0))
+    {
+        log_error ("pattern file '%s' holds no patterns\n", filepath);
+        retcode = 1;
+    }
+
+    return retcode;
+}
+
+
+/* name of the convention a parse matched, see parsed_t */
+const char *
+parser_convention_name (int convention)
+{
+    if ((convention < 0) || ((size_t)convention >= s_convention_count)) 
+    {
+        return NULL;
+    }
+
+    return s_conventions[convention].name;
+}
+
+
+int
+parser_init (void)
+{
+    uint32_t newline = 0;
+
+    /* fall back on the built in convention */
+    s_default_conventions = (s_convention_count == 0);
+    if (s_default_conventions && 
+        parser_add_convention (S_DEFAULT_NAME, S_DEFAULT_PATTERN))
+    {
+        return 1;
+    }
+
+    if (compile_conventions ()) return 1;
+
+    /* read the clock now, rather than from a parser thread */
+    date_init ();
+
+    s_stage_parse = stats_register ("parse");
+    s_stage_date  = stats_register ("date");
+
+    /* running without the cache is better than not running */
+    if (s_cache_size > 0)
+    {
+        s_cache = parse_cache_create (s_cache_size);
+        if (s_cache == NULL) log_verbose ("Failed to create the parse cache\n");
+    }
+
+    /* '.' in the patterns stops at line endings. the scanner hands any name
+     * holding '\r' or '\n' to PCRE2, which is only enough when those are 
+     * the only line endings */
+    (void)pcre2_config (PCRE2_CONFIG_NEWLINE, &newline);
+    s_scan_usable = ((newline == PCRE2_NEWLINE_LF)   || 
+                     (newline == PCRE2_NEWLINE_CR)   ||
+                     (newline == PCRE2_NEWLINE_CRLF) || 
+                     (newline == PCRE2_NEWLINE_ANYCRLF));
+    if (!s_scan_usable) log_verbose ("PCRE2: scanner disabled by newline type\n");
+
+    /* context backing parse_path() */
+    s_default_ctx = parser_ctx_create ();
+    if (s_default_ctx == NULL) return 1;
+
+    return 0;
+}
+
+
+void
+parser_quit (void)
+{
+    parser_ctx_destroy (s_default_ctx);
+    s_default_ctx = NULL;
+
+    free_conventions ();
+
+    parse_cache_destroy (s_cache);
+    s_cache = NULL;
+
+    return;
+}
+
+
+/* create a parsing context, one is needed per thread. must be called 
+ * after parser_init() */
+parser_ctx_t *
+parser_ctx_create (void)
+{
+    parser_ctx_t *ctx = NULL;
+    pcre2_code *re = s_re;
+
+    if (re == NULL) return NULL;
+
+    ctx = calloc (1, sizeof (parser_ctx_t));
+    if (ctx == NULL) return NULL;
+
+    ctx->match_data = pcre2_match_data_create_from_pattern (re, NULL);
+    ctx->match_context = pcre2_match_context_create (NULL);
+    if ((ctx->match_data == NULL) || (ctx->match_context == NULL))
+    {
+        goto parser_ctx_create_error;
+    }
+
+    /* JIT stacks cannot be shared between threads, so each context gets
+     * its own */
+    if (s_re_jit)
+    {
+        ctx->jit_stack = pcre2_jit_stack_create (PARSER_JIT_STACK_MIN, 
+                                                 PARSER_JIT_STACK_MAX, NULL);
+        if (ctx->jit_stack == NULL) goto parser_ctx_create_error;
+
+        pcre2_jit_stack_assign (ctx->match_context, NULL, ctx->jit_stack);
+    }
+
+    return ctx;
+
+parser_ctx_create_error:
+    parser_ctx_destroy (ctx);
+    return NULL;
+}
+
+
+void
+parser_ctx_destroy (parser_ctx_t *ctx)
+{
+    if (ctx == NULL) return;
+
+    pcre2_match_data_free (ctx->match_data);
+    ctx->match_data = NULL;
+    pcre2_match_context_free (ctx->match_context);
+    ctx->match_context = NULL;
+    pcre2_jit_stack_free (ctx->jit_stack);
+    ctx->jit_stack = NULL;
+
+    free (ctx);
+
+    return;
+}
+
+
+/* join every convention into one pattern, so each name is only searched 
+ * once however many conventions there are. it is used when every 
+ * convention could match, see preform_regex_match():
+ *
+ *   (?|(*MARK:0)(?:pattern 0)|(*MARK:1)(?:pattern 1)|...)
+ *
+ * the branch reset group numbers the groups of every branch from 1, as if
+ * it were alone, and the mark names the branch that matched. like any 
+ * alternation, the first branch to match at the leftmost position wins. */
+static int
+compile_conventions (void)
+{
+    size_t length = 8;
+    char *combined = NULL;
+    char *iter = NULL;
+
+    for (size_t i = 0; i < s_convention_count; i++)
+    {
+        length += strlen (s_conventions[i].pattern) + 32;
+    }
+
+    combined = malloc (length);
+    if (combined == NULL) return 1;
+
+    iter = combined;
+    iter += sprintf (iter, "(?|");
+    for (size_t i = 0; i < s_convention_count; i++)
+    {
+        iter += sprintf (iter, "%s(*MARK:%zu)(?:%s)", 
+                         (i ? "|" : ""), i, s_conventions[i].pattern);
+    }
+    (void)sprintf (iter, ")");
+
+    s_re = compile_pattern (combined, "combined");
+    free (combined);
+    if (s_re == NULL) return 1;
+
+    /* fall back on the interpreter if the JIT is unavailable */
+    s_re_jit = 0;
+    if (s_use_jit)
+    {
+        int ret = pcre2_jit_compile (s_re, PCRE2_JIT_COMPLETE);
+        if (ret == 0)
+        {
+            s_re_jit = 1;
+        }
+        else
+        {
+            log_verbose ("PCRE2: JIT unavailable (%d), using the "
+                         "interpreter\n", ret);
+        }
+    }
+
+    /* conventions whose literals are missing from a name are skipped */
+    s_prefilter = 0;
+    for (size_t i = 0; i < s_convention_count; i++)
+    {
+        convention_t *conv = &s_conventions[i];
+
+        if (conv->literals != NULL) s_prefilter = 1;
+        if (s_re_jit) conv->re_jit = (pcre2_jit_compile (conv->re, PCRE2_JIT_COMPLETE) == 0);
+    }
+
+    log_verbose ("PCRE2: %zu naming conventions, %s\n", s_convention_count,
+                 (s_prefilter ? "prefiltered" : "no prefilter"));
+
+    return 0;
+}
+
+
+static void
+free_conventions (void)
+{
+    pcre2_code_free (s_re);
+    s_re = NULL;
+    s_re_jit = 0;
+    s_prefilter = 0;
+
+    for (size_t i = 0; i < s_convention_count; i++)
+    {
+        free (s_conventions[i].name);
+        free (s_conventions[i].pattern);
+        free (s_conventions[i].literals);
+        pcre2_code_free (s_conventions[i].re);
+    }
+    free (s_conventions);
+    s_conventions = NULL;
+    s_convention_count = 0;
+    s_default_conventions = 0;
+
+    return;
+}
+
+
+static pcre2_code *
+compile_pattern (const char *pattern, const char *name)
+{
+    int errornumber;
+    PCRE2_SIZE erroroffset;
+    pcre2_code *re = NULL;
+
+    re = pcre2_compile (
+            (PCRE2_SPTR)pattern,
+            PCRE2_ZERO_TERMINATED,
+            0,
+            &errornumber,
+            &erroroffset,
+            NULL);
+
+    if (re == NULL)
+    {
+        PCRE2_UCHAR buffer[256];
+        pcre2_get_error_message (errornumber, buffer, sizeof (buffer));
+        log_verbose ("PCRE2: %d: %s at offset %zu\n", errornumber, buffer, 
+                     (size_t)erroroffset);
+        log_error ("PCRE2: %s: statement compililation failed\n", name);
+        return NULL;
+    }
+
+    return re;
+}
+
+
+/* every run of plain text a match of pattern must contain, such as "D01-" 
+ * and ".pdf" from "^(.*?)D01-(\\d{4})\\.pdf", as "D01-\0.pdf\0\0". only the 
+ * top level of the pattern is read, groups and classes are skipped over. 
+ * returns NULL when there is none, or the pattern could change how text 
+ * matches (alternations and inline options) */
+static char *
+required_literals (const char *pattern)
+{
+    const size_t MIN_LITERAL = 2;
+
+    size_t length = strlen (pattern);
+    char *literals = NULL;
+    size_t count = 0;       /* bytes used in literals */
+    size_t run = 0;         /* start of the current run */
+    int last_literal = 0;   /* the previous atom is the last byte of the run */
+    size_t i = 0;
+
+    /* no literal is longer than the pattern spelling it */
+    literals = malloc (length + 2);
+    if (literals == NULL) return NULL;
+
+#define END_RUN() \
+    do { \
+        if (count - run >= MIN_LITERAL) literals[count++] = '\0'; \
+        else count = run; \
+        run = count; \
+        last_literal = 0; \
+    } while (0)
+
+#define ADD_LITERAL(c) \
+    do { \
+        literals[count++] = (char)(c); \
+        last_literal = 1; \
+    } while (0)
+
+    while (i < length)
+    {
+        char c = pattern[i];
+        size_t quantifier = 0;
+
+        if (c == '|') goto required_literals_none;
+
+        if (c == '(')
+        {
+            /* (?i) and the like, and (*VERB)s such as (*CR) */
+            if ((pattern[i + 1] == '*') ||
+                ((pattern[i + 1] == '?') && 
+                 (((pattern[i + 2] >= 'a') && (pattern[i + 2] <= 'z')) ||
+                  ((pattern[i + 2] >= 'A') && (pattern[i + 2] <= 'Z')) ||
+                  (pattern[i + 2] == '-') || (pattern[i + 2] == '^'))))
+            {
+                goto required_literals_none;
+            }
+
+            END_RUN ();
+            i = skip_group (pattern, i);
+            if (i == 0) goto required_literals_none;
+        }
+        else if (c == '[')
+        {
+            END_RUN ();
+            i = skip_class (pattern, i);
+            if (i == 0) goto required_literals_none;
+        }
+        else if (c == '\\')
+        {
+            char e = pattern[i + 1];
+            i += 2;
+
+            switch (e)
+            {
+            /* control characters */
+            case 'a': ADD_LITERAL ('\a'); break;
+            case 'e': ADD_LITERAL ('\x1b'); break;
+            case 'f': ADD_LITERAL ('\f'); break;
+            case 'n': ADD_LITERAL ('\n'); break;
+            case 'r': ADD_LITERAL ('\r'); break;
+            case 't': ADD_LITERAL ('\t'); break;
+
+            case 'c':
+                if (pattern[i] == '\0') goto required_literals_none;
+                ADD_LITERAL ((pattern[i] >= 'a' && pattern[i] <= 'z' 
+                              ? pattern[i] - 32 : pattern[i]) ^ 0x40);
+                i++;
+                break;
+
+            /* \xhh and \x{hh...} */
+            case 'x':
+            {
+                unsigned long value = 0;
+                char *end = NULL;
+
+                if (pattern[i] == '{')
+                {
+                    value = strtoul (pattern + i + 1, &end, 16);
+                    if ((end == pattern + i + 1) || (*end != '}')) goto required_literals_none;
+                    i = (size_t)(end - pattern) + 1;
+                }
+                else
+                {
+                    const char *HEX = "0123456789abcdef";
+                    const char *digit = NULL;
+                    size_t digits = 0;
+
+                    while ((digits < 2) && (pattern[i] != '\0') &&
+                           ((digit = strchr (HEX, pattern[i] | 0x20)) != NULL))
+                    {
+                        value = value * 16 + (unsigned long)(digit - HEX);
+                        digits++;
+                        i++;
+                    }
+                }
+
+                /* the nul would end the text, and wide characters are more
+                 * than one byte */
+                if ((value == 0) || (value > 0x7f)) END_RUN ();
+                else ADD_LITERAL (value);
+                break;
+            }
+
+            /* \Q...\E is all text */
+            case 'Q':
+                while ((pattern[i] != '\0') && 
+                       !((pattern[i] == '\\') && (pattern[i + 1] == 'E')))
+                {
+                    ADD_LITERAL (pattern[i]);
+                    i++;
+                }
+                if (pattern[i] != '\0') i += 2;
+                break;
+
+            case 'E':
+                break;
+
+            /* assertions match no text, but break the run */
+            case 'b': case 'B': case 'A': case 'z': case 'Z': case 'G': 
+            case 'K':
+                END_RUN ();
+                break;
+
+            /* classes of a single character */
+            case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+            case 'h': case 'H': case 'v': case 'V': case 'R': case 'N':
+            case 'X': case 'C':
+                END_RUN ();
+                break;
+
+            /* \p{Lu}, \pL */
+            case 'p': case 'P':
+                END_RUN ();
+                if (pattern[i] == '{')
+                {
+                    while ((pattern[i] != '\0') && (pattern[i] != '}')) i++;
+                    if (pattern[i] == '\0') goto required_literals_none;
+                }
+                i++;
+                break;
+
+            /* back references \1, \g{1}, \k<name>, and octal \0, \o{} */
+            case 'g': case 'k': case 'o':
+            case '0': case '1': case '2': case '3': case '4': 
+            case '5': case '6': case '7': case '8': case '9':
+                END_RUN ();
+                if ((pattern[i] == '{') || (pattern[i] == '<') || (pattern[i] == '\''))
+                {
+                    char close = (pattern[i] == '{') ? '}' : 
+                                 (pattern[i] == '<') ? '>' : '\'';
+                    while ((pattern[i] != '\0') && (pattern[i] != close)) i++;
+                    if (pattern[i] == '\0') goto required_literals_none;
+                    i++;
+                }
+                while ((pattern[i] >= '0') && (pattern[i] <= '9')) i++;
+                break;
+
+            case '\0':
+                goto required_literals_none;
+
+            default:
+                /* any other escaped letter is nothing we know of */
+                if (((e >= 'a') && (e <= 'z')) || ((e >= 'A') && (e <= 'Z')))
+                {
+                    goto required_literals_none;
+                }
+                ADD_LITERAL (e);
+                break;
+            }
+        }
+        else if ((c == '.') || (c == '^') || (c == '$'))
+        {
+            END_RUN ();
+            i++;
+        }
+        else if ((quantifier = quantifier_length (pattern, i)) > 0)
+        {
+            /* the text before a quantifier may be missing, or repeated, 
+             * so the run ends ahead of it */
+            if (last_literal) count--;
+            END_RUN ();
+            i += quantifier;
+        }
+        else
+        {
+            ADD_LITERAL (c);
+            i++;
+        }
+    }
+    END_RUN ();
+
+#undef END_RUN
+#undef ADD_LITERAL
+
+    if (count == 0) goto required_literals_none;
+    literals[count] = '\0';
+
+    return literals;
+
+required_literals_none:
+    free (literals);
+    return NULL;
+}
+
+
+/* index just past the group opened at pattern[i], or 0 if it is not 
+ * closed */
+static size_t
+skip_group (const char *pattern, size_t i)
+{
+    size_t depth = 0;
+
+    while (pattern[i] != '\0')
+    {
+        char c = pattern[i];
+
+        if (c == '\\')
+        {
+            if (pattern[i + 1] == 'Q')
+            {
+                const char *end = strstr (pattern + i + 2, "\\E");
+                if (end == NULL) return 0;
+                i = (size_t)(end - pattern) + 2;
+                continue;
+            }
+            if (pattern[i + 1] == '\0') return 0;
+            i += 2;
+            continue;
+        }
+
+        if (c == '[')
+        {
+            i = skip_class (pattern, i);
+            if (i == 0) return 0;
+            continue;
+        }
+
+        if (c == '(') depth++;
+        if ((c == ')') && (--depth == 0)) return i + 1;
+        i++;
+    }
+
+    return 0;
+}
+
+
+/* index just past the class opened at pattern[i], or 0 if it is not 
+ * closed. a ']' first in the class is part of it */
+static size_t
+skip_class (const char *pattern, size_t i)
+{
+    i++;
+    if (pattern[i] == '^') i++;
+    if (pattern[i] == ']') i++;
+
+    while (pattern[i] != '\0')
+    {
+        if (pattern[i] == '\\')
+        {
+            if (pattern[i + 1] == '\0') return 0;
+            i += 2;
+            continue;
+        }
+
+        /* [:alpha:] */
+        if ((pattern[i] == '[') && (pattern[i + 1] == ':'))
+        {
+            const char *end = strstr (pattern + i + 2, ":]");
+            if (end == NULL) return 0;
+            i = (size_t)(end - pattern) + 2;
+            continue;
+        }
+
+        if (pattern[i] == ']') return i + 1;
+        i++;
+    }
+
+    return 0;
+}
+
+
+/* length of the quantifier at pattern[i], with any lazy or possessive 
+ * marker, or 0 if there is none. a '{' not followed by counts is text */
+static size_t
+quantifier_length (const char *pattern, size_t i)
+{
+    size_t start = i;
+
+    if ((pattern[i] == '*') || (pattern[i] == '+') || (pattern[i] == '?'))
+    {
+        i++;
+    }
+    else if (pattern[i] == '{')
+    {
+        size_t digits = 0;
+
+        i++;
+        while ((pattern[i] >= '0') && (pattern[i] <= '9')) { i++; digits++; }
+        if (pattern[i] == ',')
+        {
+            i++;
+            while ((pattern[i] >= '0') && (pattern[i] <= '9')) { i++; digits++; }
+        }
+        if ((digits == 0) || (pattern[i] != '}')) return 0;
+        i++;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if ((pattern[i] == '?') || (pattern[i] == '+')) i++;
+
+    return i - start;
+}
+
+
+/* the name holds every literal of the convention */
+static int
+has_literals (const convention_t *conv, const char *filename)
+{
+    if (conv->literals == NULL) return 1;
+
+    for (const char *lit = conv->literals; *lit != '\0'; lit += strlen (lit) + 1)
+    {
+        if (strstr (filename, lit) == NULL) return 0;
+    }
+
+    return 1;
+}
+
+
+static int
+match_pattern (parser_ctx_t *ctx, pcre2_code *re, int jit, 
+               const char *filename, size_t length)
+{
+    /* the JIT entry point skips the interpreter's sanity checks */
+    if (jit)
+    {
+        return pcre2_jit_match (re, (PCRE2_SPTR)filename, length, 0, 0, 
+                                ctx->match_data, ctx->match_context);
+    }
+
+    return pcre2_match (re, (PCRE2_SPTR)filename, length, 0, 0, 
+                        ctx->match_data, ctx->match_context);
+}
+
+
+static parsed_t *
+preform_regex_match (parser_ctx_t *ctx, char *filename)
+{
+    int retcode;
+    size_t length;
+    size_t candidates = 0;
+    size_t first = 0;
+    int convention = -1;
+
+    PCRE2_SIZE *ovector = NULL;
+    pcre2_match_data *match_data = ctx->match_data;
+
+    /* null guard */
+    if (filename == NULL) return NULL;
+    length = strlen (filename);
+
+    /* only conventions whose literals are all in the name can match it */
+    for (size_t i = 0; i < s_convention_count; i++)
+    {
+        if (!has_literals (&s_conventions[i], filename)) continue;
+        if (candidates++ == 0) first = i;
+    }
+
+    if (candidates == s_convention_count)
+    {
+        /* one search covers them all */
+        retcode = match_pattern (ctx, s_re, s_re_jit, filename, length);
+    }
+    else
+    {
+        /* try each on its own. like the alternation, the leftmost match
+         * wins, and the first convention at that position */
+        PCRE2_SIZE best_start = PCRE2_UNSET;
+        int last = -1;
+
+        retcode = PCRE2_ERROR_NOMATCH;
+        for (size_t i = first; (i < s_convention_count) && (candidates > 0); i++)
+        {
+            convention_t *conv = &s_conventions[i];
+            int rc;
+
+            if (!has_literals (conv, filename)) continue;
+            candidates--;
+
+            rc = match_pattern (ctx, conv->re, conv->re_jit, filename, length);
+            last = (int)i;
+            if (rc == PCRE2_ERROR_NOMATCH) continue;
+            if (rc < 0) { retcode = rc; convention = -1; break; }
+
+            if (pcre2_get_ovector_pointer (match_data)[0] < best_start)
+            {
+                best_start = pcre2_get_ovector_pointer (match_data)[0];
+                convention = (int)i;
+                retcode = rc;
+                if (best_start == 0) break;
+            }
+        }
+
+        /* the match data holds whichever was tried last */
+        if ((convention >= 0) && (convention != last))
+        {
+            retcode = match_pattern (ctx, s_conventions[convention].re, 
+                                     s_conventions[convention].re_jit, 
+                                     filename, length);
+        }
+    }
+
+    if (retcode < 0)
+    {
+        switch (retcode)
+        {
+        case PCRE2_ERROR_NOMATCH:
+            log_warning ("PCRE2: no matches found\n");
+            break;
+
+        default:
+            log_error ("PCRE2: %d: unknown error\n", retcode);
+            break;
+        }
+
+        return NULL;
+    }
+
+    ovector = pcre2_get_ovector_pointer (match_data);    
+
+    /* not enough room in match_data */
+    if (retcode == 0)
+    {
+        log_debug ("PCRE2: ovector too small\n");
+        return NULL;
+    }
+
+    /* the mark is the index of the convention that matched */
+    if (convention < 0)
+    {
+        PCRE2_SPTR mark = pcre2_get_mark (match_data);
+        convention = (mark ? atoi ((const char *)mark) : 0);
+    }
+
+    return store_groups (ctx, filename, ovector, retcode, convention);
+}
+
+
+/* copy the name, and split the date digits into groups a, b, c and d */
+static parsed_t *
+store_groups (parser_ctx_t *ctx, const char *filename, PCRE2_SIZE *ovector,
+              int groups, int convention)
+{
+    parsed_t *result = &ctx->result;
+    char digits[4 * MAX_PARSED_GROUP + 1] = { 0 };
+    size_t count = 0;
+
+    re_group (result->name_raw, MAX_PARSED_NAME, (PCRE2_SPTR8)filename, ovector, GROUP_NAME);
+
+    /* the built in convention has exactly four two digit groups, other 
+     * conventions may split the digits up however they like */
+    for (int i = GROUP_NAME + 1; i < groups; i++)
+    {
+        PCRE2_SIZE start = ovector[2*i];
+        PCRE2_SIZE end = ovector[2*i+1];
+
+        if (start == PCRE2_UNSET) continue;
+        for (PCRE2_SIZE j = start; (j < end) && (count < sizeof (digits) - 1); j++)
+        {
+            digits[count++] = filename[j];
+        }
+    }
+
+    memcpy (result->group_a, digits + 0, 2); result->group_a[2] = '\0';
+    memcpy (result->group_b, digits + 2, 2); result->group_b[2] = '\0';
+    memcpy (result->group_c, digits + 4, 2); result->group_c[2] = '\0';
+    memcpy (result->group_d, digits + 6, 2); result->group_d[2] = '\0';
+
+    result->convention = convention;
+    
+    return result;
+}
+
+
+/* the regex free path, taking the same groups as RE_INVOICE_GROUP */
+static parsed_t *
+preform_scan_match (parser_ctx_t *ctx, char *filename)
+{
+    PCRE2_SIZE ovector[2 * GROUP_COUNT];
+    int retcode;
+
+    /* null guard */
+    if (filename == NULL) return NULL;
+
+    retcode = scan_filename (filename, strlen (filename), ovector);
+    if (retcode < 0) return preform_regex_match (ctx, filename);
+    if (retcode == 0)
+    {
+        log_warning ("PCRE2: no matches found\n");
+        return NULL;
+    }
+
+    return store_groups (ctx, filename, ovector, GROUP_COUNT, 0);
+}
+
+
+/* match ^(.*?)(\d{2})(\d{2}).*?(\d{2})(\d{2}).*\.pdf in one pass.
+ *
+ * the lazy groups make the regex take the first run of four digits, then
+ * the first run of four digits after it, as long as a ".pdf" still 
+ * follows. taking a later first run can only push the second one later, 
+ * so if the first choice fails there is no match at all.
+ *
+ * returns 1 with ovector filled in on a match, 0 on no match, and -1 if
+ * the name is something only PCRE2 can answer for. */
+static int
+scan_filename (const char *filename, size_t length, PCRE2_SIZE *ovector)
+{
+    uint64_t bits[SCAN_WORDS];
+    size_t first, second, suffix;
+
+    if (!s_scan_usable || !s_default_conventions) return -1;
+    if (length > SCAN_MAX_LENGTH) return -1;
+    if (memchr (filename, '\n', length) || memchr (filename, '\r', length)) 
+    {
+        return -1;
+    }
+
+    /* the last ".pdf", every digit run must end before it */
+    if (length < 12) return 0;
+    for (suffix = length - 4; ; suffix--)
+    {
+        if (memcmp (filename + suffix, ".pdf", 4) == 0) break;
+        if (suffix == 0) return 0;
+    }
+
+    digit_bitmap (filename, length, bits);
+
+    first = find_digit_run4 (bits, suffix, 0);
+    if (first == SIZE_MAX) return 0;
+
+    second = find_digit_run4 (bits, suffix, first + 4);
+    if (second == SIZE_MAX) return 0;
+
+    ovector[2*MATCH]        = 0;
+    ovector[2*MATCH+1]      = suffix + 4;
+    ovector[2*GROUP_NAME]   = 0;
+    ovector[2*GROUP_NAME+1] = first;
+    ovector[2*GROUP_DATE_A] = first;
+    ovector[2*GROUP_DATE_A+1] = first + 2;
+    ovector[2*GROUP_DATE_B] = first + 2;
+    ovector[2*GROUP_DATE_B+1] = first + 4;
+    ovector[2*GROUP_DATE_C] = second;
+    ovector[2*GROUP_DATE_C+1] = second + 2;
+    ovector[2*GROUP_DATE_D] = second + 2;
+    ovector[2*GROUP_DATE_D+1] = second + 4;
+
+    return 1;
+}
+
+
+/* set bit i of bits if s[i] is an ascii digit, bits must hold at least
+ * length / 64 + 1 words */
+static void
+digit_bitmap (const char *s, size_t length, uint64_t *bits)
+{
+    size_t i = 0;
+
+    memset (bits, 0, (length / 64 + 1) * sizeof (uint64_t));
+
+#if SCAN_SSE2
+    {
+        const __m128i ZERO = _mm_set1_epi8 ('0');
+        const __m128i NINE = _mm_set1_epi8 (9);
+
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i v = _mm_loadu_si128 ((const __m128i *)(s + i));
+            __m128i x = _mm_sub_epi8 (v, ZERO);
+
+            /* unsigned x <= 9 */
+            __m128i is_digit = _mm_cmpeq_epi8 (_mm_min_epu8 (x, NINE), x);
+            uint64_t mask = (uint64_t)(unsigned)_mm_movemask_epi8 (is_digit);
+
+            /* i is a multiple of 16, so the mask never straddles a word */
+            bits[i / 64] |= mask << (i % 64);
+        }
+    }
+#endif
+
+    for (; i < length; i++)
+    {
+        if ((s[i] >= '0') && (s[i] <= '9'))
+        {
+            bits[i / 64] |= (uint64_t)1 << (i % 64);
+        }
+    }
+
+    return;
+}
+
+
+/* the first i >= from where four digits in a row end by limit, or
+ * SIZE_MAX if there is none */
+static size_t
+find_digit_run4 (const uint64_t *bits, size_t limit, size_t from)
+{
+    /* four digits in a row start at i when bits i..i+3 are all set. the 
+     * window is 64 bits, but only its first 61 starts can be judged */
+    for (size_t i = from; i + 4 <= limit; i += 61)
+    {
+        size_t word = i / 64;
+        unsigned shift = (unsigned)(i % 64);
+        uint64_t w = bits[word] >> shift;
+        uint64_t runs;
+
+        /* the next word only matters if some of it is before limit, and
+         * only those words are cleared by digit_bitmap() */
+        if ((shift != 0) && ((word + 1) * 64 < limit))
+        {
+            w |= bits[word + 1] << (64 - shift);
+        }
+
+        runs = w & (w >> 1) & (w >> 2) & (w >> 3);
+        runs &= ((uint64_t)1 << 61) - 1;
+        if (runs)
+        {
+            size_t found = i + (size_t)count_trailing_zeros (runs);
+            return (found + 4 <= limit) ? found : SIZE_MAX;
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+
+static int
+count_trailing_zeros (uint64_t x)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    (void)_BitScanForward64 (&index, x);
+    return (int)index;
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll (x);
+#else
+    int n = 0;
+    while ((x & 1) == 0) { x >>= 1; n++; }
+    return n;
+#endif
+}
+
+
+/* not reentrant, the result is only valid until the next call */
+parsed_t *
+parse_path (char *filepath)
+{
+    return parser_ctx_parse (s_default_ctx, filepath);
+}
+
+
+/* copy a parse result somewhere longer lived, keeping name valid */
+void
+parsed_copy (parsed_t *dst, const parsed_t *src)
+{
+    *dst = *src;
+    dst->name = dst->name_raw + (src->name - src->name_raw);
+
+    return;
+}
+
+
+/* reentrant, the result belongs to ctx and is valid until the next call 
+ * with the same ctx */
+parsed_t *
+parser_ctx_parse (parser_ctx_t *ctx, char *filepath)
+{
+    char *filename = NULL;
+    size_t length = 0;
+    uint64_t hash = 0;
+    uint64_t start = 0;
+    parsed_t *parsed = NULL;
+
+    /* null guard */
+    if ((ctx == NULL) || (filepath == NULL)) return NULL;
+
+    /* cache hits count as parses too */
+    start = STATS_BEGIN ();
+
+    /* the result only depends on the filename, which many paths share */
+    filename = basename (filepath);
+    if (s_cache)
+    {
+        length = strlen (filename);
+        hash = parse_cache_hash (filename, length);
+
+        switch (parse_cache_lookup (s_cache, filename, length, hash, 
+                                    &ctx->result))
+        {
+        case PARSE_CACHE_HIT:
+            /* only the match is remembered. the date is judged again, as
+             * today may have moved on since it was stored */
+            parse_date (&ctx->result);
+            ctx->result.filepath = filepath;
+            STATS_END (s_stage_parse, start);
+            return &ctx->result;
+
+        case PARSE_CACHE_HIT_NO_MATCH:
+            log_warning ("PCRE2: no matches found\n");
+            STATS_END (s_stage_parse, start);
+            return NULL;
+
+        case PARSE_CACHE_MISS:
+        default:
+            break;
+        }
+    }
+
+    parsed = parse_filename (ctx, filename);
+    STATS_END (s_stage_parse, start);
+
+    if (s_cache) parse_cache_store (s_cache, filename, length, hash, parsed);
+    if (parsed == NULL) return NULL;
+
+    /* get filepath */
+    parsed->filepath = filepath;
+
+    return parsed;
+}
+
+
+/* search the filename for information */
+static parsed_t *
+parse_filename (parser_ctx_t *ctx, char *filename)
+{
+    parsed_t *parsed = ((s_matcher == PARSER_MATCHER_SCAN) 
+                        ? preform_scan_match (ctx, filename)
+                        : preform_regex_match (ctx, filename));
+    if (parsed == NULL) return NULL;
+
+    /* get customer name */
+    (void)find_replace_char (parsed->name_raw, '_', ' ');
+    parsed->name = trim_whitespace (parsed->name_raw);
+
+    parse_date (parsed);
+
+    return parsed;
+}
+
+
+/* the date from the digit groups, all zeros if none is valid today */
+static void
+parse_date (parsed_t *parsed)
+{
+    uint64_t start = STATS_BEGIN ();
+    date_tuple_t date = guess_date_format (parsed->group_a, parsed->group_b, 
+                                           parsed->group_c, parsed->group_d);
+    STATS_END (s_stage_date, start);
+
+    parsed->year  = date.year;
+    parsed->month = date.month;
+    parsed->day   = date.day;
+
+    return;
+}
+
+
+static void
+re_group (char *dst, size_t n, PCRE2_SPTR subject, PCRE2_SIZE *ovector, int i)
+{
+    PCRE2_SPTR substring_start = subject + ovector[2*i];
+    PCRE2_SIZE substring_length = ovector[2*i+1] - ovector[2*i];
+
+    size_t min_length = (substring_length < n ? substring_length : n);
+
+    memcpy (dst, (char *)substring_start, (size_t)min_length);
+    dst[min_length] = '\0';
+
+    return;
+}
+
+/* the first layout, in order of preference, that gives a valid date from
+ * the four two digit groups. all zeros if none do. parser_init() must 
+ * have been called */
+date_tuple_t
+guess_date_format (char *a, char *b, char *c, char *d)
+{
+    int ia = atoi (a);
+    int ib = atoi (b);
+    int ic = atoi (c);
+    int id = atoi (d);
+
+    /* in order of preference */
+    date_tuple_t candidates[] = {
+        date_yyyy_mmdd (ia, ib, ic, id),
+        date_mmdd_yyyy (ia, ib, ic, id),
+        /* date_ddmm_yyyy (ia, ib, ic, id), */
+    };
+    int valid[LEN (candidates)];
+
+    if (date_validate_n (candidates, valid, LEN (candidates)) > 0)
+    {
+        for (size_t i = 0; i < LEN (candidates); i++)
+        {
+            if (valid[i]) return candidates[i];
+        }
+    }
+
+    return (date_tuple_t){ .year = 0, .month = 0, .day = 0 };
+}
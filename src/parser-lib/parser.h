@@ -0,0 +1,65 @@
+
+#ifndef INVOICE_PARSER_HEADER
+#define INVOICE_PARSER_HEADER
+
+#include <date-lib/date.h>
+#include <stddef.h>
+
+
+#define MAX_PARSED_NAME  256
+#define MAX_PARSED_GROUP 2
+#define MAX_PARSED_YEAR  4
+#define MAX_PARSED_MONTH 2 
+#define MAX_PARSED_DAY   2 
+
+typedef struct
+{
+    char *filepath;
+    char name_raw[MAX_PARSED_NAME + 1];
+    char *name;
+
+    char group_a[MAX_PARSED_GROUP + 1];
+    char group_b[MAX_PARSED_GROUP + 1];
+    char group_c[MAX_PARSED_GROUP + 1];
+    char group_d[MAX_PARSED_GROUP + 1];
+
+    int year;
+    int month;
+    int day;
+
+    int convention;     /* which naming convention matched */
+} parsed_t;
+
+typedef struct parser_ctx parser_ctx_t;
+
+typedef enum
+{
+    PARSER_MATCHER_REGEX,   /* PCRE2 for every name */
+    PARSER_MATCHER_SCAN,    /* hand written scanner, PCRE2 as a fallback */
+} parser_matcher_t;
+
+
+void parser_set_jit (int enabled);
+void parser_set_matcher (parser_matcher_t matcher);
+int  parser_add_convention (const char *name, const char *pattern);
+int  parser_load_patterns (const char *filepath);
+const char *parser_convention_name (int convention);
+void parser_set_cache_size (size_t n);
+void parser_cache_stats (size_t *hits, size_t *misses);
+int  parser_jit_enabled (void);
+
+int parser_init (void);
+void parser_quit (void);
+
+parser_ctx_t *parser_ctx_create (void);
+void          parser_ctx_destroy (parser_ctx_t *ctx);
+
+parsed_t *parse_path (char *filepath);
+parsed_t *parser_ctx_parse (parser_ctx_t *ctx, char *filepath);
+void      parsed_copy (parsed_t *dst, const parsed_t *src);
+
+date_tuple_t guess_date_format (char *a, char *b, char *c, char *d);
+
+
+#endif /* header guard */
+/* end of file */
\ No newline at end of file
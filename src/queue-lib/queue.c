@@ -0,0 +1,203 @@
+#include "queue.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+
+
+/* each cell carries a sequence number telling producers and consumers 
+ * whose turn it is, see Dmitry Vyukov's bounded MPMC queue */
+typedef struct
+{
+    atomic_size_t sequence;
+    void *item;
+} cell_t;
+
+struct queue
+{
+    cell_t *cells;
+    size_t mask;
+
+    /* keep the two hot counters on separate cache lines */
+    char pad0[64];
+    atomic_size_t head;     /* next cell to push */
+    char pad1[64];
+    atomic_size_t tail;     /* next cell to pop */
+    char pad2[64];
+};
+
+
+queue_t *
+queue_create (size_t capacity)
+{
+    queue_t *q = NULL;
+    size_t size = 2;
+
+    /* round up to a power of two */
+    while (size < capacity)
+    {
+        if (size > (SIZE_MAX / 2)) return NULL;
+        size *= 2;
+    }
+
+    q = calloc (1, sizeof (queue_t));
+    if (q == NULL) return NULL;
+
+    q->cells = calloc (size, sizeof (cell_t));
+    if (q->cells == NULL)
+    {
+        free (q);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+        atomic_init (&q->cells[i].sequence, i);
+    }
+
+    q->mask = size - 1;
+    atomic_init (&q->head, 0);
+    atomic_init (&q->tail, 0);
+
+    return q;
+}
+
+
+void
+queue_destroy (queue_t *q)
+{
+    if (q == NULL) return;
+
+    free (q->cells);
+    q->cells = NULL;
+    free (q);
+
+    return;
+}
+
+
+/* return 0 on success, 1 if the queue is full */
+int
+queue_try_push (queue_t *q, void *item)
+{
+    cell_t *cell;
+    size_t pos = atomic_load_explicit (&q->head, memory_order_relaxed);
+
+    for (;;)
+    {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit (&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            /* cell is free, try to claim it */
+            if (atomic_compare_exchange_weak_explicit (&q->head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return 1;   /* full */
+        }
+        else
+        {
+            pos = atomic_load_explicit (&q->head, memory_order_relaxed);
+        }
+    }
+
+    cell->item = item;
+    atomic_store_explicit (&cell->sequence, pos + 1, memory_order_release);
+
+    return 0;
+}
+
+
+/* return 0 on success, 1 if the queue is empty */
+int
+queue_try_pop (queue_t *q, void **item_out)
+{
+    cell_t *cell;
+    size_t pos = atomic_load_explicit (&q->tail, memory_order_relaxed);
+
+    for (;;)
+    {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit (&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0)
+        {
+            /* cell is filled, try to claim it */
+            if (atomic_compare_exchange_weak_explicit (&q->tail, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return 1;   /* empty */
+        }
+        else
+        {
+            pos = atomic_load_explicit (&q->tail, memory_order_relaxed);
+        }
+    }
+
+    if (item_out) *item_out = cell->item;
+    atomic_store_explicit (&cell->sequence, pos + q->mask + 1, 
+                           memory_order_release);
+
+    return 0;
+}
+
+
+/* blocking variants, these spin then yield until they succeed */
+void
+queue_push (queue_t *q, void *item)
+{
+    unsigned spins = 0;
+
+    while (queue_try_push (q, item)) queue_backoff (&spins);
+
+    return;
+}
+
+
+void *
+queue_pop (queue_t *q)
+{
+    unsigned spins = 0;
+    void *item = NULL;
+
+    while (queue_try_pop (q, &item)) queue_backoff (&spins);
+
+    return item;
+}
+
+
+/* wait a little longer each time a caller fails to make progress */
+void
+queue_backoff (unsigned *spins)
+{
+    const unsigned SPIN_LIMIT = 64;
+    const struct timespec NAP = { .tv_sec = 0, .tv_nsec = 50000 };
+
+    if (*spins < SPIN_LIMIT)
+    {
+        (*spins)++;
+        thrd_yield ();
+        return;
+    }
+
+    (void)thrd_sleep (&NAP, NULL);
+
+    return;
+}
+
+
+/* end of file */
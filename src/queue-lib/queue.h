@@ -0,0 +1,24 @@
+#ifndef INVOICE_QUEUE_HEADER
+#define INVOICE_QUEUE_HEADER
+
+#include <stddef.h>
+
+/* bounded lock-free multi-producer/multi-consumer queue of pointers.
+ * capacity is rounded up to the next power of two. */
+typedef struct queue queue_t;
+
+
+queue_t *queue_create (size_t capacity);
+void     queue_destroy (queue_t *q);
+
+int queue_try_push (queue_t *q, void *item);
+int queue_try_pop  (queue_t *q, void **item_out);
+
+void  queue_push (queue_t *q, void *item);
+void *queue_pop  (queue_t *q);
+
+void queue_backoff (unsigned *spins);
+
+
+#endif /* header guard */
+/* end of file */
@@ -0,0 +1,373 @@
+#include "stats.h"
+
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+
+/* latencies are kept in HDR style log buckets: values under 8ns get a 
+ * bucket each, above that every power of two is split into 8 linear sub
+ * buckets. any value up to 2^64 is then within 12.5% of its bucket. */
+#define STATS_SUB_BITS  3
+#define STATS_SUB_COUNT (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS   ((64 - STATS_SUB_BITS + 1) * STATS_SUB_COUNT)
+
+#define STATS_MAX_NAME  31
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[STATS_BUCKETS];
+} stats_stage_data_t;
+
+/* every thread records into a block of its own, so recording never 
+ * shares a cache line. blocks are only summed up by the report, once the
+ * threads are done */
+typedef struct stats_block
+{
+    struct stats_block *next;
+    stats_stage_data_t stages[STATS_MAX_STAGES];
+} stats_block_t;
+
+typedef struct
+{
+    const char *name;
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+} stats_summary_t;
+
+
+int g_stats_enabled = 0;
+
+static char s_names[STATS_MAX_STAGES][STATS_MAX_NAME + 1];
+static int  s_stage_count = 0;
+
+static stats_block_t *s_blocks = NULL;
+static mtx_t s_lock;
+static once_flag s_lock_once = ONCE_FLAG_INIT;
+static _Thread_local stats_block_t *t_block = NULL;
+
+
+static void   init_lock (void);
+static stats_block_t *thread_block (void);
+static void   merge_stage (int stage, stats_stage_data_t *out);
+static void   summarize (int stage, const stats_stage_data_t *data, stats_summary_t *out);
+static uint64_t percentile (const stats_stage_data_t *data, double fraction);
+static size_t   bucket_of (uint64_t value);
+static uint64_t bucket_low (size_t bucket);
+static int      highest_bit (uint64_t x);
+
+
+/* turn recording on or off, before any threads start */
+void
+stats_enable (int enabled)
+{
+    if (enabled) g_stats_enabled |= STATS_COUNT;
+    else         g_stats_enabled &= ~STATS_COUNT;
+
+    return;
+}
+
+
+/* returns the id of the stage called name, adding it if it is new. call 
+ * before any threads start. returns -1 once there are STATS_MAX_STAGES */
+int
+stats_register (const char *name)
+{
+    for (int i = 0; i < s_stage_count; i++)
+    {
+        if (strcmp (s_names[i], name) == 0) return i;
+    }
+
+    if (s_stage_count == STATS_MAX_STAGES) return -1;
+
+    (void)strncpy (s_names[s_stage_count], name, STATS_MAX_NAME);
+    return s_stage_count++;
+}
+
+
+/* a monotonic clock in nanoseconds */
+uint64_t
+stats_now (void)
+{
+    struct timespec ts;
+
+#if defined(CLOCK_MONOTONIC)
+    (void)clock_gettime (CLOCK_MONOTONIC, &ts);
+#else
+    (void)timespec_get (&ts, TIME_UTC);
+#endif
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+
+/* stage ran from start until now */
+void
+stats_record (int stage, uint64_t start)
+{
+    uint64_t end = stats_now ();
+    uint64_t nanoseconds = end - start;
+    stats_block_t *block = NULL;
+    stats_stage_data_t *data = NULL;
+
+    if ((stage < 0) || (stage >= s_stage_count)) return;
+
+    if (g_stats_enabled & STATS_TRACE)
+    {
+        trace_span ("stage", s_names[stage], start, end);
+    }
+    if (!(g_stats_enabled & STATS_COUNT)) return;
+
+    block = thread_block ();
+    if (block == NULL) return;
+
+    data = &block->stages[stage];
+    data->count++;
+    data->total += nanoseconds;
+    if (nanoseconds > data->max) data->max = nanoseconds;
+    data->buckets[bucket_of (nanoseconds)]++;
+
+    return;
+}
+
+
+/* a table of every stage that recorded anything */
+void
+stats_report (FILE *stream)
+{
+    stats_stage_data_t data;
+    stats_summary_t sum;
+
+    (void)fprintf (stream, "%-12s %10s %12s %10s %10s %10s %10s %10s\n",
+                   "stage", "count", "total ms", "mean us", 
+                   "p50 us", "p90 us", "p99 us", "max us");
+
+    for (int i = 0; i < s_stage_count; i++)
+    {
+        merge_stage (i, &data);
+        if (data.count == 0) continue;
+        summarize (i, &data, &sum);
+
+        (void)fprintf (stream, 
+                "%-12s %10llu %12.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+                sum.name, (unsigned long long)sum.count, 
+                (double)sum.total / 1e6,
+                (double)sum.total / (double)sum.count / 1e3,
+                (double)sum.p50 / 1e3, (double)sum.p90 / 1e3,
+                (double)sum.p99 / 1e3, (double)sum.max / 1e3);
+    }
+
+    return;
+}
+
+
+/* every stage as JSON, times in nanoseconds. the histogram lists the 
+ * lower bound and count of each bucket in use. returns non zero on 
+ * error */
+int
+stats_write_json (const char *filepath)
+{
+    stats_stage_data_t data;
+    stats_summary_t sum;
+    FILE *fp = NULL;
+    int retcode = 0;
+
+    fp = fopen (filepath, "w");
+    if (fp == NULL) return 1;
+
+    (void)fprintf (fp, "{\n  \"stages\": [");
+    for (int i = 0; i < s_stage_count; i++)
+    {
+        int first = 1;
+
+        merge_stage (i, &data);
+        summarize (i, &data, &sum);
+
+        (void)fprintf (fp, "%s\n    {\"name\": \"%s\", \"count\": %llu, "
+                "\"total_ns\": %llu, \"p50_ns\": %llu, \"p90_ns\": %llu, "
+                "\"p99_ns\": %llu, \"max_ns\": %llu, \"histogram\": [",
+                (i ? "," : ""), sum.name, 
+                (unsigned long long)sum.count, (unsigned long long)sum.total, 
+                (unsigned long long)sum.p50, (unsigned long long)sum.p90,
+                (unsigned long long)sum.p99, (unsigned long long)sum.max);
+
+        for (size_t j = 0; j < STATS_BUCKETS; j++)
+        {
+            if (data.buckets[j] == 0) continue;
+            (void)fprintf (fp, "%s[%llu, %llu]", (first ? "" : ", "),
+                           (unsigned long long)bucket_low (j),
+                           (unsigned long long)data.buckets[j]);
+            first = 0;
+        }
+        (void)fprintf (fp, "]}");
+    }
+    (void)fprintf (fp, "\n  ]\n}\n");
+
+    if (ferror (fp)) retcode = 1;
+    if (fclose (fp) != 0) retcode = 1;
+
+    return retcode;
+}
+
+
+/* free every thread's counters, no thread may be recording */
+void
+stats_quit (void)
+{
+    stats_block_t *iter = s_blocks;
+
+    while (iter != NULL)
+    {
+        stats_block_t *next = iter->next;
+        free (iter);
+        iter = next;
+    }
+    s_blocks = NULL;
+    t_block = NULL;
+
+    return;
+}
+
+
+static void
+init_lock (void)
+{
+    (void)mtx_init (&s_lock, mtx_plain);
+
+    return;
+}
+
+
+static stats_block_t *
+thread_block (void)
+{
+    if (t_block != NULL) return t_block;
+
+    t_block = calloc (1, sizeof (stats_block_t));
+    if (t_block == NULL) return NULL;
+
+    call_once (&s_lock_once, init_lock);
+    (void)mtx_lock (&s_lock);
+    t_block->next = s_blocks;
+    s_blocks = t_block;
+    (void)mtx_unlock (&s_lock);
+
+    return t_block;
+}
+
+
+static void
+merge_stage (int stage, stats_stage_data_t *out)
+{
+    (void)memset (out, 0, sizeof (*out));
+
+    for (stats_block_t *iter = s_blocks; iter != NULL; iter = iter->next)
+    {
+        const stats_stage_data_t *data = &iter->stages[stage];
+
+        out->count += data->count;
+        out->total += data->total;
+        if (data->max > out->max) out->max = data->max;
+        for (size_t i = 0; i < STATS_BUCKETS; i++)
+        {
+            out->buckets[i] += data->buckets[i];
+        }
+    }
+
+    return;
+}
+
+
+static void
+summarize (int stage, const stats_stage_data_t *data, stats_summary_t *out)
+{
+    out->name  = s_names[stage];
+    out->count = data->count;
+    out->total = data->total;
+    out->max   = data->max;
+    out->p50   = percentile (data, 0.50);
+    out->p90   = percentile (data, 0.90);
+    out->p99   = percentile (data, 0.99);
+
+    return;
+}
+
+
+/* the middle of the bucket holding the given fraction of values */
+static uint64_t
+percentile (const stats_stage_data_t *data, double fraction)
+{
+    uint64_t target = (uint64_t)((double)data->count * fraction);
+    uint64_t seen = 0;
+
+    if (data->count == 0) return 0;
+    if (target >= data->count) target = data->count - 1;
+
+    for (size_t i = 0; i < STATS_BUCKETS; i++)
+    {
+        seen += data->buckets[i];
+        if (seen > target)
+        {
+            uint64_t low = bucket_low (i);
+            uint64_t high = ((i + 1 < STATS_BUCKETS) ? bucket_low (i + 1) - 1 : UINT64_MAX);
+            uint64_t middle = low + (high - low) / 2;
+
+            return (middle < data->max ? middle : data->max);
+        }
+    }
+
+    return data->max;
+}
+
+
+static size_t
+bucket_of (uint64_t value)
+{
+    int exponent;
+
+    if (value < STATS_SUB_COUNT) return (size_t)value;
+
+    exponent = highest_bit (value);
+    return ((size_t)(exponent - STATS_SUB_BITS + 1) * STATS_SUB_COUNT) +
+           (size_t)((value >> (exponent - STATS_SUB_BITS)) & (STATS_SUB_COUNT - 1));
+}
+
+
+static uint64_t
+bucket_low (size_t bucket)
+{
+    int exponent;
+    uint64_t sub;
+
+    if (bucket < STATS_SUB_COUNT) return (uint64_t)bucket;
+
+    exponent = (int)(bucket / STATS_SUB_COUNT) + STATS_SUB_BITS - 1;
+    sub = (uint64_t)(bucket % STATS_SUB_COUNT);
+
+    return (STATS_SUB_COUNT + sub) << (exponent - STATS_SUB_BITS);
+}
+
+
+static int
+highest_bit (uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll (x);
+#else
+    int n = 0;
+    while (x >>= 1) n++;
+    return n;
+#endif
+}
+
+
+/* end of file */
@@ -0,0 +1,45 @@
+#ifndef INVOICE_STATS_HEADER
+#define INVOICE_STATS_HEADER
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+/* per stage counters and latency histograms. 
+ *
+ *   static int s_stage_parse = -1;
+ *   s_stage_parse = stats_register ("parse");     (once, before threads)
+ *
+ *   uint64_t start = STATS_BEGIN ();
+ *   ...
+ *   STATS_END (s_stage_parse, start);
+ *
+ * while stats are disabled both macros are a single branch. when tracing
+ * is on (see trace.h) every stage is also written out as a span. */
+
+#define STATS_MAX_STAGES 16
+
+/* bits of g_stats_enabled */
+#define STATS_COUNT 0x01
+#define STATS_TRACE 0x02
+
+extern int g_stats_enabled;
+
+#define STATS_BEGIN() (g_stats_enabled ? stats_now () : 0)
+#define STATS_END(stage, start) \
+    (void)((!g_stats_enabled) || (stats_record ((stage), (start)), 1))
+
+
+void stats_enable (int enabled);
+int  stats_register (const char *name);
+
+uint64_t stats_now (void);
+void stats_record (int stage, uint64_t start);
+
+void stats_report (FILE *stream);
+int  stats_write_json (const char *filepath);
+void stats_quit (void);
+
+
+#endif /* header guard */
+/* end of file */
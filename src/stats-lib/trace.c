@@ -0,0 +1,377 @@
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+
+#define TRACE_CHUNK_EVENTS 4096
+#define TRACE_MAX_INTERNED 64
+#define TRACE_MAX_NAME     63
+
+typedef struct
+{
+    const char *category;
+    const char *name;
+    uint64_t start;
+    uint64_t duration;
+} trace_event_t;
+
+typedef struct trace_chunk
+{
+    struct trace_chunk *next;
+    size_t count;
+    trace_event_t events[TRACE_CHUNK_EVENTS];
+} trace_chunk_t;
+
+typedef struct
+{
+    uint64_t hash;
+    char *text;
+} trace_interned_t;
+
+/* every thread appends to a buffer of its own, blocks are only linked
+ * together, under the lock, when a thread records its first span */
+typedef struct trace_block
+{
+    struct trace_block *next;
+    int tid;
+    char thread_name[32];
+    trace_chunk_t *head;
+    trace_chunk_t *tail;
+    trace_interned_t interned[TRACE_MAX_INTERNED];
+    size_t interned_count;
+} trace_block_t;
+
+
+static char *s_filepath = NULL;
+static int s_started = 0;
+static uint64_t s_origin = 0;
+static trace_block_t *s_blocks = NULL;
+static int s_next_tid = 1;
+static mtx_t s_lock;
+static _Thread_local trace_block_t *t_block = NULL;
+
+
+static trace_block_t *thread_block (void);
+static uint64_t hash_text (const char *text);
+static void compact_copy (char *dst, const char *src, size_t size);
+static void write_string (FILE *fp, const char *text);
+static void free_blocks (void);
+static void quit_at_exit (void);
+
+
+/* start buffering spans, written to filepath at trace_quit() or at exit.
+ * call before any threads start. returns non zero on error */
+int
+trace_start (const char *filepath)
+{
+    size_t length = strlen (filepath);
+
+    /* threads keep pointers to their buffers, so only ever start once */
+    if (s_started) return 1;
+
+    s_filepath = malloc (length + 1);
+    if (s_filepath == NULL) return 1;
+    (void)memcpy (s_filepath, filepath, length + 1);
+
+    if (mtx_init (&s_lock, mtx_plain) != thrd_success)
+    {
+        free (s_filepath); s_filepath = NULL;
+        return 1;
+    }
+
+    s_started = 1;
+    s_origin = stats_now ();
+    g_stats_enabled |= STATS_TRACE;
+    trace_thread_name ("main");
+
+    (void)atexit (quit_at_exit);
+
+    return 0;
+}
+
+
+/* label the calling thread in the trace viewer */
+void
+trace_thread_name (const char *name)
+{
+    trace_block_t *block = NULL;
+
+    if (!(g_stats_enabled & STATS_TRACE)) return;
+
+    block = thread_block ();
+    if (block == NULL) return;
+
+    (void)strncpy (block->thread_name, name, sizeof (block->thread_name) - 1);
+
+    return;
+}
+
+
+void
+trace_span (const char *category, const char *name, uint64_t start,
+            uint64_t end)
+{
+    trace_block_t *block = thread_block ();
+    trace_chunk_t *chunk = NULL;
+    trace_event_t *event = NULL;
+
+    if (block == NULL) return;
+
+    chunk = block->tail;
+    if ((chunk == NULL) || (chunk->count == TRACE_CHUNK_EVENTS))
+    {
+        chunk = malloc (sizeof (trace_chunk_t));
+        if (chunk == NULL) return;
+        chunk->next = NULL;
+        chunk->count = 0;
+
+        if (block->tail) block->tail->next = chunk;
+        else             block->head = chunk;
+        block->tail = chunk;
+    }
+
+    event = &chunk->events[chunk->count++];
+    event->category = category;
+    event->name     = name;
+    event->start    = start;
+    event->duration = end - start;
+
+    return;
+}
+
+
+/* a copy of text, with whitespace squeezed and cut short, that lives as
+ * long as the trace. copies are kept per thread, so the same text is only
+ * copied once per thread. past TRACE_MAX_INTERNED texts "(other)" is
+ * returned instead */
+const char *
+trace_intern (const char *text)
+{
+    trace_block_t *block = thread_block ();
+    trace_interned_t *entry = NULL;
+    uint64_t hash;
+
+    if ((block == NULL) || (text == NULL)) return "";
+
+    hash = hash_text (text);
+    for (size_t i = 0; i < block->interned_count; i++)
+    {
+        if (block->interned[i].hash == hash) return block->interned[i].text;
+    }
+
+    if (block->interned_count == TRACE_MAX_INTERNED) return "(other)";
+
+    entry = &block->interned[block->interned_count];
+    entry->text = malloc (TRACE_MAX_NAME + 1);
+    if (entry->text == NULL) return "(other)";
+
+    compact_copy (entry->text, text, TRACE_MAX_NAME + 1);
+    entry->hash = hash;
+    block->interned_count++;
+
+    return entry->text;
+}
+
+
+/* write every buffered span, then stop tracing. no other thread may still
+ * be recording. returns non zero if the file could not be written */
+int
+trace_quit (void)
+{
+    FILE *fp = NULL;
+    int retcode = 0;
+    int first = 1;
+
+    if (s_filepath == NULL) return 0;
+    g_stats_enabled &= ~STATS_TRACE;
+
+    fp = fopen (s_filepath, "w");
+    if (fp == NULL)
+    {
+        retcode = 1;
+        goto trace_quit_exit;
+    }
+
+    (void)fprintf (fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+
+    for (trace_block_t *block = s_blocks; block != NULL; block = block->next)
+    {
+        if (block->thread_name[0] != '\0')
+        {
+            (void)fprintf (fp, "%s\n{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                           "\"name\": \"thread_name\", \"args\": {\"name\": ",
+                           (first ? "" : ","), block->tid);
+            write_string (fp, block->thread_name);
+            (void)fprintf (fp, "}}");
+            first = 0;
+        }
+
+        for (trace_chunk_t *chunk = block->head; chunk; chunk = chunk->next)
+        {
+            for (size_t i = 0; i < chunk->count; i++)
+            {
+                const trace_event_t *event = &chunk->events[i];
+                uint64_t ts = event->start - s_origin;
+
+                /* timestamps are in microseconds */
+                (void)fprintf (fp, "%s\n{\"ph\": \"X\", \"pid\": 1, "
+                               "\"tid\": %d, \"ts\": %llu.%03u, "
+                               "\"dur\": %llu.%03u, \"cat\": ",
+                               (first ? "" : ","), block->tid,
+                               (unsigned long long)(ts / 1000),
+                               (unsigned)(ts % 1000),
+                               (unsigned long long)(event->duration / 1000),
+                               (unsigned)(event->duration % 1000));
+                write_string (fp, event->category);
+                (void)fprintf (fp, ", \"name\": ");
+                write_string (fp, event->name);
+                (void)fprintf (fp, "}");
+                first = 0;
+            }
+        }
+    }
+    (void)fprintf (fp, "\n]}\n");
+
+    if (ferror (fp)) retcode = 1;
+    if (fclose (fp) != 0) retcode = 1;
+
+trace_quit_exit:
+    free_blocks ();
+    mtx_destroy (&s_lock);
+    free (s_filepath); s_filepath = NULL;
+
+    return retcode;
+}
+
+
+static trace_block_t *
+thread_block (void)
+{
+    if (t_block != NULL) return t_block;
+    if (s_filepath == NULL) return NULL;
+
+    t_block = calloc (1, sizeof (trace_block_t));
+    if (t_block == NULL) return NULL;
+
+    (void)mtx_lock (&s_lock);
+    t_block->tid = s_next_tid++;
+    t_block->next = s_blocks;
+    s_blocks = t_block;
+    (void)mtx_unlock (&s_lock);
+
+    return t_block;
+}
+
+
+/* FNV-1a */
+static uint64_t
+hash_text (const char *text)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+    {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+/* copy src into dst, squeezing every run of whitespace into one space */
+static void
+compact_copy (char *dst, const char *src, size_t size)
+{
+    size_t n = 0;
+    int space = 1;      /* drops leading whitespace */
+
+    for (const char *p = src; (*p != '\0') && (n + 1 < size); p++)
+    {
+        if ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n'))
+        {
+            if (!space) dst[n++] = ' ';
+            space = 1;
+            continue;
+        }
+
+        dst[n++] = *p;
+        space = 0;
+    }
+    if ((n > 0) && (dst[n - 1] == ' ')) n--;
+    dst[n] = '\0';
+
+    return;
+}
+
+
+static void
+write_string (FILE *fp, const char *text)
+{
+    (void)fputc ('"', fp);
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+    {
+        if ((*p == '"') || (*p == '\\'))
+        {
+            (void)fputc ('\\', fp);
+            (void)fputc (*p, fp);
+        }
+        else if (*p < 0x20)
+        {
+            (void)fprintf (fp, "\\u%04x", *p);
+        }
+        else
+        {
+            (void)fputc (*p, fp);
+        }
+    }
+    (void)fputc ('"', fp);
+
+    return;
+}
+
+
+static void
+free_blocks (void)
+{
+    trace_block_t *block = s_blocks;
+
+    while (block != NULL)
+    {
+        trace_block_t *next = block->next;
+        trace_chunk_t *chunk = block->head;
+
+        while (chunk != NULL)
+        {
+            trace_chunk_t *next_chunk = chunk->next;
+            free (chunk);
+            chunk = next_chunk;
+        }
+        for (size_t i = 0; i < block->interned_count; i++)
+        {
+            free (block->interned[i].text);
+        }
+
+        free (block);
+        block = next;
+    }
+    s_blocks = NULL;
+    t_block = NULL;
+
+    return;
+}
+
+
+static void
+quit_at_exit (void)
+{
+    (void)trace_quit ();
+
+    return;
+}
+
+
+/* end of file */
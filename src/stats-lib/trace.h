@@ -0,0 +1,40 @@
+#ifndef INVOICE_TRACE_HEADER
+#define INVOICE_TRACE_HEADER
+
+#include "stats.h"
+#include <stdint.h>
+
+
+/* Chrome trace event output, readable by chrome://tracing and Perfetto.
+ *
+ *   trace_start ("trace.json");                   (once, before threads)
+ *
+ *   uint64_t start = TRACE_BEGIN ();
+ *   ...
+ *   TRACE_END ("wait", "queue pop", start);
+ *
+ *   trace_quit ();                                (once threads are done)
+ *
+ * every thread buffers its own spans, nothing is shared until the file is
+ * written by trace_quit(), or at exit. category and name must outlive the
+ * trace, use trace_intern() for anything else. stages timed with
+ * STATS_BEGIN()/STATS_END() are traced as well. */
+
+#define TRACE_BEGIN() ((g_stats_enabled & STATS_TRACE) ? stats_now () : 0)
+#define TRACE_END(category, name, start) \
+    (void)((!(g_stats_enabled & STATS_TRACE)) || \
+           (trace_span ((category), (name), (start), stats_now ()), 1))
+
+
+int  trace_start (const char *filepath);
+void trace_thread_name (const char *name);
+
+void trace_span (const char *category, const char *name,
+                 uint64_t start, uint64_t end);
+const char *trace_intern (const char *text);
+
+int  trace_quit (void);
+
+
+#endif /* header guard */
+/* end of file */
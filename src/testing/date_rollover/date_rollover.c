@@ -0,0 +1,104 @@
+
+#include <date-lib/date.h>
+#include <logging-lib/logging.h>
+#include <parser-lib/parser.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* an invoice dated tomorrow is rejected, and parses once the day moves
+ * on. --watch runs across midnight, so neither the date nor the parse
+ * cache may hold on to the first day. */
+
+static int check_rollover (size_t cache_size);
+static int expect_date (const char *filepath, int year, int month, int day);
+
+
+int
+main (void)
+{
+    int failures = 0;
+
+    logging_init (LOG_SILENT, NULL);
+
+    /* without the cache, then with it */
+    failures += check_rollover (0);
+    failures += check_rollover (64);
+
+    (void)printf ("%d failures\n", failures);
+
+    return (failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+static int
+check_rollover (size_t cache_size)
+{
+    const char *TOMORROW = "/tmp/Acme_Corp 2024 0315.pdf";
+    const char *TODAY    = "/tmp/Acme_Corp 2024 0314.pdf";
+    int failures = 0;
+
+    parser_set_cache_size (cache_size);
+    if (parser_init () != 0)
+    {
+        (void)fprintf (stderr, "error: failed to initialize the parser\n");
+        return 1;
+    }
+
+    date_set_today (2024, 3, 14);
+    failures += expect_date (TODAY, 2024, 3, 14);
+    failures += expect_date (TOMORROW, 0, 0, 0);
+    failures += expect_date (TOMORROW, 0, 0, 0);
+
+    /* the clock does not override an explicit date */
+    if (date_refresh_today () != 0)
+    {
+        (void)printf ("cache %zu: date_refresh_today replaced the set date\n",
+                      cache_size);
+        failures++;
+    }
+
+    date_set_today (2024, 3, 15);
+    failures += expect_date (TOMORROW, 2024, 3, 15);
+    failures += expect_date (TODAY, 2024, 3, 14);
+
+    parser_quit ();
+
+    if (failures != 0) (void)printf ("cache %zu: %d failures\n", cache_size, failures);
+
+    return failures;
+}
+
+
+/* parse filepath, year 0 meaning the date should be rejected */
+static int
+expect_date (const char *filepath, int year, int month, int day)
+{
+    char buffer[256];
+    parsed_t *parsed = NULL;
+
+    /* parsing may write into the path */
+    (void)snprintf (buffer, sizeof (buffer), "%s", filepath);
+    parsed = parse_path (buffer);
+
+    if (parsed == NULL)
+    {
+        (void)printf ("'%s': no match\n", filepath);
+        return 1;
+    }
+
+    if ((parsed->year != year) || (parsed->month != month) ||
+        (parsed->day != day))
+    {
+        (void)printf ("'%s': got %04d-%02d-%02d, expected %04d-%02d-%02d\n",
+                      filepath, parsed->year, parsed->month, parsed->day,
+                      year, month, day);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/* end of file */
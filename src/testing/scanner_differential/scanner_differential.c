@@ -0,0 +1,320 @@
+
+#include <logging-lib/logging.h>
+#include <parser-lib/parser.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* run names that are hard on the hand written scanner through it and
+ * through PCRE2, and fail on any difference.
+ *
+ * the scanner keeps a bitmap of digit positions, 64 to a word, so the
+ * corpus is built around word edges: names a few bytes either side of a
+ * multiple of 64, digit runs straddling two words, names with more than
+ * one ".pdf", and names either side of the longest the scanner takes. */
+
+#define MAX_CASE_LENGTH  1100   /* past the scanner's limit of 1024 */
+#define RANDOM_CASES     20000
+#define MAX_REPORTED     20
+
+static const size_t WORD_EDGES[] = { 64, 128, 192, 1024 };
+
+static size_t s_cases = 0;
+static size_t s_matches = 0;
+static size_t s_mismatches = 0;
+
+static parser_ctx_t *s_regex_ctx = NULL;
+static parser_ctx_t *s_scan_ctx = NULL;
+
+
+static void check (const char *name, size_t length);
+static int  same_result (const parsed_t *a, const parsed_t *b);
+static void placement_cases (void);
+static void suffix_cases (void);
+static void random_cases (void);
+static int  place (char *buf, size_t length, size_t at, const char *text);
+static uint64_t next_random (uint64_t *state);
+
+
+int
+main (void)
+{
+    int exitcode = EXIT_SUCCESS;
+
+    logging_init (LOG_SILENT, NULL);
+
+    if (parser_init () != 0)
+    {
+        (void)fprintf (stderr, "error: failed to initialize the parser\n");
+        return EXIT_FAILURE;
+    }
+
+    s_regex_ctx = parser_ctx_create ();
+    s_scan_ctx = parser_ctx_create ();
+    if ((s_regex_ctx == NULL) || (s_scan_ctx == NULL))
+    {
+        (void)fprintf (stderr, "error: failed to create a parser context\n");
+        exitcode = EXIT_FAILURE;
+        goto main_exit;
+    }
+
+    placement_cases ();
+    suffix_cases ();
+    random_cases ();
+
+    (void)printf ("%zu names, %zu matches, %zu mismatches\n",
+                  s_cases, s_matches, s_mismatches);
+    if (s_mismatches != 0) exitcode = EXIT_FAILURE;
+
+main_exit:
+    parser_ctx_destroy (s_regex_ctx);
+    parser_ctx_destroy (s_scan_ctx);
+    parser_quit ();
+
+    return exitcode;
+}
+
+
+/* parse name with both matchers. the matcher is read on every parse, so
+ * the two can take turns */
+static void
+check (const char *name, size_t length)
+{
+    char regex_copy[MAX_CASE_LENGTH + 1];
+    char scan_copy[MAX_CASE_LENGTH + 1];
+    parsed_t *expected = NULL;
+    parsed_t *actual = NULL;
+
+    /* parsing may write into the path */
+    memcpy (regex_copy, name, length);
+    regex_copy[length] = '\0';
+    memcpy (scan_copy, name, length);
+    scan_copy[length] = '\0';
+
+    parser_set_matcher (PARSER_MATCHER_REGEX);
+    expected = parser_ctx_parse (s_regex_ctx, regex_copy);
+    parser_set_matcher (PARSER_MATCHER_SCAN);
+    actual = parser_ctx_parse (s_scan_ctx, scan_copy);
+
+    s_cases++;
+    if (expected) s_matches++;
+    if (same_result (expected, actual)) return;
+
+    if (s_mismatches++ < MAX_REPORTED)
+    {
+        (void)printf ("mismatch, %zu bytes: '%.*s'\n", length, (int)length, name);
+        (void)printf ("  regex: %s\n", expected ? expected->name_raw : "(no match)");
+        (void)printf ("  scan:  %s\n", actual ? actual->name_raw : "(no match)");
+    }
+}
+
+
+static int
+same_result (const parsed_t *a, const parsed_t *b)
+{
+    if ((a == NULL) || (b == NULL)) return (a == b);
+
+    return ((strcmp (a->name_raw, b->name_raw) == 0) &&
+            (strcmp (a->name, b->name) == 0) &&
+            (strcmp (a->group_a, b->group_a) == 0) &&
+            (strcmp (a->group_b, b->group_b) == 0) &&
+            (strcmp (a->group_c, b->group_c) == 0) &&
+            (strcmp (a->group_d, b->group_d) == 0) &&
+            (a->year  == b->year) &&
+            (a->month == b->month) &&
+            (a->day   == b->day) &&
+            (a->convention == b->convention));
+}
+
+
+/* two runs of four digits and a ".pdf", each placed on and around the
+ * word edges, in names of every length near an edge */
+static void
+placement_cases (void)
+{
+    char buf[MAX_CASE_LENGTH];
+
+    for (size_t e = 0; e < sizeof (WORD_EDGES) / sizeof (WORD_EDGES[0]); e++)
+    {
+        for (size_t length = WORD_EDGES[e] - 6; length <= WORD_EDGES[e] + 6; length++)
+        {
+            size_t offsets[64];
+            size_t count = 0;
+
+            /* starts that put a run across, against, or just clear of
+             * an edge */
+            offsets[count++] = 0;
+            offsets[count++] = length / 2;
+            for (size_t k = 0; k <= e; k++)
+            {
+                for (size_t d = 0; d <= 6; d++)
+                {
+                    if (WORD_EDGES[k] + d >= 5) offsets[count++] = WORD_EDGES[k] + d - 5;
+                }
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                for (size_t j = 0; j < count; j++)
+                {
+                    /* the runs in order, and as a single run of eight */
+                    size_t seconds[2] = { offsets[j], offsets[i] + 4 };
+
+                    for (size_t s = 0; s < 2; s++)
+                    {
+                        if (seconds[s] < offsets[i] + 4) continue;
+
+                        memset (buf, 'x', length);
+                        if (place (buf, length, offsets[i], "2010") ||
+                            place (buf, length, seconds[s], "0401") ||
+                            place (buf, length, length - 4, ".pdf"))
+                        {
+                            continue;
+                        }
+                        check (buf, length);
+
+                        /* three digits are not a run */
+                        buf[offsets[i] + 3] = '_';
+                        check (buf, length);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/* more than one ".pdf", digits after the last one, and runs that only
+ * fit before an earlier ".pdf" */
+static void
+suffix_cases (void)
+{
+    static const char *NAMES[] = {
+        "Acme 2010 0401.pdf",
+        "Acme 2010.pdf 0401.pdf",
+        "Acme 20100401.pdf.pdf",
+        "Acme 2010 0401.pdf 1234",
+        "Acme 2010 0401.pdf1234.pdf",
+        "Acme 2010.pdf0401",
+        "Acme .pdf 2010 0401",
+        "Acme 2010 0401.pd",
+        "Acme 2010 040.pdf",
+        "20100401.pdf",
+        "2010401.pdf",
+        "1234.pdf",
+        ".pdf",
+        "",
+        "Acme 2010\n0401.pdf",
+        "Acme 2010\r0401.pdf",
+    };
+    char buf[MAX_CASE_LENGTH];
+
+    for (size_t i = 0; i < sizeof (NAMES) / sizeof (NAMES[0]); i++)
+    {
+        check (NAMES[i], strlen (NAMES[i]));
+    }
+
+    /* a ".pdf" on every position around an edge, with a second one at
+     * the end and the digits on either side of the first */
+    for (size_t e = 0; e < sizeof (WORD_EDGES) / sizeof (WORD_EDGES[0]); e++)
+    {
+        size_t length = WORD_EDGES[e] + 16;
+
+        for (size_t at = WORD_EDGES[e] - 8; at <= WORD_EDGES[e] + 4; at++)
+        {
+            memset (buf, 'x', length);
+            (void)place (buf, length, at, ".pdf");
+            (void)place (buf, length, length - 4, ".pdf");
+
+            (void)place (buf, length, at - 8, "20100401");
+            check (buf, length);
+
+            (void)place (buf, length, at + 4, "1999");
+            check (buf, length);
+
+            memset (buf, 'x', at);
+            check (buf, length);
+        }
+    }
+}
+
+
+/* names made mostly of digits and pieces of ".pdf", at lengths that
+ * favour the word edges */
+static void
+random_cases (void)
+{
+    static const char *PIECES[] = { "0", "1", "9", "x", " ", ".", "p", "d", "f", ".pdf" };
+    const size_t PIECE_COUNT = sizeof (PIECES) / sizeof (PIECES[0]);
+    const size_t EDGE_COUNT = sizeof (WORD_EDGES) / sizeof (WORD_EDGES[0]);
+
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    char buf[MAX_CASE_LENGTH];
+
+    for (size_t n = 0; n < RANDOM_CASES; n++)
+    {
+        size_t length = 0;
+        size_t target;
+
+        if (n % 2)
+        {
+            target = (size_t)(next_random (&state) % MAX_CASE_LENGTH);
+        }
+        else
+        {
+            size_t edge = WORD_EDGES[next_random (&state) % EDGE_COUNT];
+            target = edge - 8 + (size_t)(next_random (&state) % 16);
+        }
+
+        while (length < target)
+        {
+            const char *piece = PIECES[next_random (&state) % PIECE_COUNT];
+            size_t piece_length = strlen (piece);
+
+            if (length + piece_length > target) break;
+            memcpy (buf + length, piece, piece_length);
+            length += piece_length;
+        }
+
+        /* most names should match */
+        if ((length >= 4) && (next_random (&state) % 4 != 0))
+        {
+            memcpy (buf + length - 4, ".pdf", 4);
+        }
+
+        check (buf, length);
+    }
+}
+
+
+/* copy text into buf at at, unless it does not fit */
+static int
+place (char *buf, size_t length, size_t at, const char *text)
+{
+    size_t text_length = strlen (text);
+
+    if ((at > length) || (text_length > length - at)) return 1;
+
+    memcpy (buf + at, text, text_length);
+    return 0;
+}
+
+
+/* xorshift64, the same seed gives the same names on every run */
+static uint64_t
+next_random (uint64_t *state)
+{
+    uint64_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+
+    return x;
+}
+
+
+/* end of file */
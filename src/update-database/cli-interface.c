@@ -5,13 +5,18 @@
 #include <hemlock-argparser-lib/arguement.h>
 #include <logging-lib/logging.h>
 #include <mystring-lib/mystring.h>
+#include <parser-lib/parser.h>
 #include "settings.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 static void help_page (FILE *stream);
 static void version_page (FILE *stream);
+static long param_to_long (char *param, long min);
+static int  param_to_matcher (char *param);
+static int  param_to_overflow (char *param);
 
 
 void
@@ -22,8 +27,22 @@ cli_parse_arguements (int argc, char **argv)
         DISABLE_CACHE = CONARG_ID_CUSTOM,
         ENABLE_CACHE,
         DRYRUN,
+        NULL_DELIMITED,
         DATABASE,
         BADFILELOG,
+        BATCH_SIZE,
+        BATCH_LATENCY,
+        JOBS,
+        SCAN,
+        WATCH,
+        MATCHER,
+        PATTERNS,
+        PARSE_CACHE,
+        LOG_BUFFER,
+        LOG_OVERFLOW,
+        STATS,
+        STATS_JSON,
+        TRACE,
         DEBUG,
         VERBOSE,
         TERSE,
@@ -34,10 +53,24 @@ cli_parse_arguements (int argc, char **argv)
 
         { DATABASE,      "-d", "--database",    CONARG_PARAM_REQUIRED },
         { BADFILELOG,    "-l", "--badfilelog",  CONARG_PARAM_REQUIRED },
+        { BATCH_SIZE,    "-b", "--batch-size",    CONARG_PARAM_REQUIRED },
+        { BATCH_LATENCY, NULL, "--batch-latency", CONARG_PARAM_REQUIRED },
+        { JOBS,          "-j", "--jobs",          CONARG_PARAM_REQUIRED },
+        { SCAN,          "-s", "--scan",          CONARG_PARAM_REQUIRED },
+        { WATCH,         "-w", "--watch",         CONARG_PARAM_REQUIRED },
+        { MATCHER,       NULL, "--matcher",       CONARG_PARAM_REQUIRED },
+        { PATTERNS,      "-p", "--patterns",      CONARG_PARAM_REQUIRED },
+        { PARSE_CACHE,   NULL, "--parse-cache",   CONARG_PARAM_REQUIRED },
+        { LOG_BUFFER,    NULL, "--log-buffer",    CONARG_PARAM_REQUIRED },
+        { LOG_OVERFLOW,  NULL, "--log-overflow",  CONARG_PARAM_REQUIRED },
+        { STATS_JSON,    NULL, "--stats-json",    CONARG_PARAM_REQUIRED },
+        { TRACE,         NULL, "--trace",         CONARG_PARAM_REQUIRED },
         
         { DISABLE_CACHE, NULL, "--disable-cache", CONARG_PARAM_NONE },
         { ENABLE_CACHE,  NULL, "--enable-cache",  CONARG_PARAM_NONE },
         { DRYRUN,        NULL, "--dryrun",        CONARG_PARAM_NONE },
+        { NULL_DELIMITED, "-0", "--null",         CONARG_PARAM_NONE },
+        { STATS,         NULL, "--stats",         CONARG_PARAM_NONE },
 
         { DEBUG,         NULL, "--debug",       CONARG_PARAM_NONE },
         { VERBOSE,       "-v", "--verbose",     CONARG_PARAM_NONE },
@@ -77,10 +110,89 @@ cli_parse_arguements (int argc, char **argv)
             g_set_database = conarg_get_param (argc, argv);
             break;
 
+        case BATCH_SIZE:
+            CONARG_STEP (argc, argv);
+            g_set_batch_size = param_to_long (conarg_get_param (argc, argv), 0);
+            break;
+
+        case BATCH_LATENCY:
+            CONARG_STEP (argc, argv);
+            g_set_batch_latency = param_to_long (conarg_get_param (argc, argv), 0);
+            break;
+
+        case JOBS:
+            CONARG_STEP (argc, argv);
+            g_set_jobs = param_to_long (conarg_get_param (argc, argv), 1);
+            break;
+
+        case SCAN:
+            CONARG_STEP (argc, argv);
+            /* there can never be more roots than arguements */
+            if (g_set_scan_roots == NULL)
+            {
+                g_set_scan_roots = calloc ((size_t)argc, sizeof (char *));
+                if (g_set_scan_roots == NULL) exit (EXIT_FAILURE);
+            }
+            g_set_scan_roots[g_set_scan_count++] = conarg_get_param (argc, argv);
+            break;
+
+        case WATCH:
+            CONARG_STEP (argc, argv);
+            if (g_set_watch_roots == NULL)
+            {
+                g_set_watch_roots = calloc ((size_t)argc, sizeof (char *));
+                if (g_set_watch_roots == NULL) exit (EXIT_FAILURE);
+            }
+            g_set_watch_roots[g_set_watch_count++] = conarg_get_param (argc, argv);
+            break;
+
+        case MATCHER:
+            CONARG_STEP (argc, argv);
+            g_set_matcher = param_to_matcher (conarg_get_param (argc, argv));
+            break;
+
+        case PATTERNS:
+            CONARG_STEP (argc, argv);
+            g_set_patterns = conarg_get_param (argc, argv);
+            break;
+
+        case PARSE_CACHE:
+            CONARG_STEP (argc, argv);
+            g_set_parse_cache = param_to_long (conarg_get_param (argc, argv), 0);
+            break;
+
+        case LOG_BUFFER:
+            CONARG_STEP (argc, argv);
+            g_set_log_buffer = param_to_long (conarg_get_param (argc, argv), 0);
+            break;
+
+        case LOG_OVERFLOW:
+            CONARG_STEP (argc, argv);
+            g_set_log_overflow = param_to_overflow (conarg_get_param (argc, argv));
+            break;
+
+        case STATS:
+            g_set_stats = 1;
+            break;
+
+        case STATS_JSON:
+            CONARG_STEP (argc, argv);
+            g_set_stats_json = conarg_get_param (argc, argv);
+            break;
+
+        case TRACE:
+            CONARG_STEP (argc, argv);
+            g_set_trace = conarg_get_param (argc, argv);
+            break;
+
         case DRYRUN:
             g_set_dryrun = 1;
             break;
 
+        case NULL_DELIMITED:
+            g_set_null_delimited = 1;
+            break;
+
         case DEBUG:
             g_set_logging_mode = LOG_DEBUG; 
             break;
@@ -116,6 +228,52 @@ cli_parse_arguements (int argc, char **argv)
 }
 
 
+/* convert a numeric parameter, exiting on bad input */
+static long
+param_to_long (char *param, long min)
+{
+    char *end = NULL;
+    long value;
+
+    errno = 0;
+    value = strtol (param, &end, 10);
+    if ((errno != 0) || (end == param) || (*end != '\0') || (value < min))
+    {
+        (void)fprintf (stderr, "error: invalid numeric parameter: '%s'\n", param);
+        help_page (stderr);
+        exit (EXIT_FAILURE);
+    }
+
+    return value;
+}
+
+
+/* convert a matcher name, exiting on bad input */
+static int
+param_to_matcher (char *param)
+{
+    if (strcmp (param, "scan") == 0)  return PARSER_MATCHER_SCAN;
+    if (strcmp (param, "regex") == 0) return PARSER_MATCHER_REGEX;
+
+    (void)fprintf (stderr, "error: unknown matcher: '%s'\n", param);
+    help_page (stderr);
+    exit (EXIT_FAILURE);
+}
+
+
+/* convert a log overflow policy, exiting on bad input */
+static int
+param_to_overflow (char *param)
+{
+    if (strcmp (param, "block") == 0) return LOG_OVERFLOW_BLOCK;
+    if (strcmp (param, "drop") == 0)  return LOG_OVERFLOW_DROP;
+
+    (void)fprintf (stderr, "error: unknown log overflow policy: '%s'\n", param);
+    help_page (stderr);
+    exit (EXIT_FAILURE);
+}
+
+
 static void
 version_page (FILE *stream)
 {
@@ -138,13 +296,49 @@ help_page (FILE *stream)
 {
     const char *HELP_MSG = {
         "Usage: " PROJECT_NAME "[OPTIONS...]\n"
-        "Analize a list of filenames piped from stdin, uploading each into a database\n"
+        "Analize a list of filenames piped from stdin, or found with --scan, uploading\n"
+        "each into a database\n"
         "\n"
         "Mandatory arguements to long options are mandatory for short options too\n"
         "  -d, --database FILEPATH     use an alternative database file\n"
         "  -l, --badfilelog FILEPATH   output bad files to an alternate file\n"
+        "  -b, --batch-size N          commit every N writes in one transaction\n"
+        "                                (0 commits every write on its own)\n"
+        "      --batch-latency MS      commit a batch once its oldest write is\n"
+        "                                MS milliseconds old\n"
+        "  -j, --jobs N                parse with N threads, reading and database\n"
+        "                                writes each get a thread of their own\n"
+        "  -s, --scan DIRECTORY        walk DIRECTORY for files instead of reading\n"
+        "                                stdin, may be given more than once\n"
+        "  -w, --watch DIRECTORY       keep running, and follow changes made under\n"
+        "                                DIRECTORY as they happen (linux only). any\n"
+        "                                --scan runs once the watches are in place,\n"
+        "                                to catch up\n"
+        "      --matcher NAME          match filenames with NAME, either 'scan' (a\n"
+        "                                fast hand written matcher, the default) or\n"
+        "                                'regex' (PCRE2 for every file)\n"
+        "  -p, --patterns FILEPATH     match filenames against the naming\n"
+        "                                conventions in FILEPATH, one\n"
+        "                                'name = regex' per line\n"
+        "      --parse-cache N         remember the last N filenames parsed, so\n"
+        "                                files sharing a name are parsed once\n"
+        "                                (0 disables the cache)\n"
+        "      --log-buffer N          buffer up to N pieces of log output,\n"
+        "                                written out by a thread of its own\n"
+        "                                (0 writes each message at once)\n"
+        "      --log-overflow POLICY   when the log buffer is full, either 'block'\n"
+        "                                until there is room (the default) or\n"
+        "                                'drop' the message\n"
+        "  -0, --null                  filenames on stdin end in a null character\n"
+        "                                instead of a newline, as from find -print0\n"
+        "      --stats                 print how long each stage took once done\n"
+        "      --stats-json FILEPATH   write the same, with latency histograms,\n"
+        "                                to FILEPATH as JSON\n"
+        "      --trace FILEPATH        write a Chrome trace of each stage and\n"
+        "                                SQLite statement to FILEPATH\n"
         "      --dryrun                dont update the database\n"
-        "      --enable-cache          skip files already cached in the database\n"
+        "      --enable-cache          skip files already cached in the database,\n"
+        "                                with --scan only unchanged files are skipped\n"
         "      --disable-cache         update all files, ignoring weather they are\n"
         "                                cached or not (verry slow)\n"
         "  -t, --terse                 show minimal output/information\n"
@@ -0,0 +1,181 @@
+#include "ingest.h"
+
+#include <database-lib/database.h>
+#include <logging-lib/logging.h>
+#include <parser-lib/parser.h>
+#include "settings.h"
+#include <stats-lib/stats.h>
+#include <stdlib.h>
+
+
+static int bad_date (int year, int month, int day);
+static int update_database_with_file (sqlite3 *db, char *filepath, char *name, 
+                                      int year, int month, int day,
+                                      const file_stat_t *stat);
+
+
+int g_stage_read = -1;
+int g_stage_stat = -1;
+static int s_stage_upsert = -1;
+static int s_stage_commit = -1;
+
+
+/* per run tally of database writes */
+static struct
+{
+    size_t inserted;
+    size_t updated;
+    size_t unchanged;
+    size_t deleted;
+    size_t failed;
+} s_counts;
+
+
+/* name the stages timed by --stats, before any threads start */
+void
+ingest_init (void)
+{
+    g_stage_read   = stats_register ("read");
+    g_stage_stat   = stats_register ("stat");
+    s_stage_upsert = stats_register ("upsert");
+    s_stage_commit = stats_register ("commit");
+
+    return;
+}
+
+
+/* write one parsed file to the database. invoice may be NULL if the file 
+ * could not be parsed. stat is the file's metadata, or NULL if unknown.
+ * this must only ever be called from one thread. */
+int
+ingest_file (sqlite3 *db, char *filepath, parsed_t *invoice, 
+             const file_stat_t *stat)
+{
+    /* if there is an issue with the parse */
+    if ((invoice == NULL) ||
+        (bad_date (invoice->year, invoice->month, invoice->day)))
+    {
+        log_error ("Skipping Bad File: '%s'\n", filepath);
+        log_file (filepath);
+        return EXIT_ERROR;
+    }
+
+    log_debug ("matched '%s' convention: '%s'\n", 
+               parser_convention_name (invoice->convention), filepath);
+
+    /* update the database */
+    uint64_t start = STATS_BEGIN ();
+    (void)db_batch_begin (db);
+    (void)update_database_with_file (db, filepath, invoice->name, 
+            invoice->year, invoice->month, invoice->day, stat);
+    STATS_END (s_stage_upsert, start);
+
+    /* commits once the batch is full */
+    start = STATS_BEGIN ();
+    (void)db_batch_step (db);
+    STATS_END (s_stage_commit, start);
+
+    return EXIT_OK;
+}
+
+
+/* remove a file, or with is_directory everything under it, from the 
+ * database. this must only ever be called from one thread. */
+int
+ingest_remove (sqlite3 *db, char *filepath, int is_directory, char seperator)
+{
+    int deleted;
+
+    (void)db_batch_begin (db);
+    deleted = (is_directory ? db_delete_by_directory (db, filepath, seperator)
+                            : db_delete_by_file (db, filepath));
+    (void)db_batch_step (db);
+
+    if (deleted < 0)
+    {
+        log_verbose ("Failed to remove from the database: '%s'\n", filepath);
+        s_counts.failed++;
+        return EXIT_ERROR;
+    }
+
+    if (deleted > 0) log_debug ("removed %d invoices: '%s'\n", deleted, filepath);
+    s_counts.deleted += (size_t)deleted;
+
+    return EXIT_OK;
+}
+
+
+/* commit whatever is left of the last batch, and report on the run */
+int
+ingest_finish (sqlite3 *db)
+{
+    int exitcode = EXIT_OK;
+
+    if (db_batch_flush (db)) exitcode = EXIT_ERROR;
+    db_batch_report ();
+
+    log_info ("%zu inserted, %zu updated, %zu unchanged, %zu deleted, "
+              "%zu failed\n",
+              s_counts.inserted, s_counts.updated, s_counts.unchanged, 
+              s_counts.deleted, s_counts.failed);
+
+    return exitcode;
+}
+
+
+static int
+bad_date (int year, int month, int day)
+{
+    return ((year  == 0) || 
+            (month == 0) || 
+            (day   == 0));
+}
+
+
+static int
+update_database_with_file (sqlite3 *db, char *filepath, char *name, int year, 
+                           int month, int day, const file_stat_t *stat)
+{
+    /* a file with known metadata only gets here if it is new or changed on
+     * disk, so its row is always brought up to date */
+    int keep_existing = ((stat == NULL) && g_set_ignore_cached);
+
+    db_upsert_t result = db_upsert (db, filepath, name, year, month, day, 
+                                    stat, keep_existing);
+
+    switch (result)
+    {
+    case DB_UPSERT_INSERTED:
+        log_debug ("inserted new invoice: '%s'\n", filepath);
+        s_counts.inserted++;
+        break;
+
+    case DB_UPSERT_UPDATED:
+        log_debug ("updated cached invoice: '%s'\n", filepath);
+        s_counts.updated++;
+        break;
+
+    case DB_UPSERT_UNCHANGED:
+        if (keep_existing)
+        {
+            log_warning ("File already cached: '%s'\n", filepath);
+        }
+        else
+        {
+            log_debug ("cached invoice unchanged: '%s'\n", filepath);
+        }
+        s_counts.unchanged++;
+        break;
+
+    case DB_UPSERT_ERROR:
+    default:
+        log_verbose ("Failed to update the database: '%s'\n", filepath);
+        s_counts.failed++;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/* end of file */
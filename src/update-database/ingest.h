@@ -0,0 +1,27 @@
+#ifndef INVOICE_UPDATE_INGEST_HEADER
+#define INVOICE_UPDATE_INGEST_HEADER
+
+#include <database-lib/database.h>
+#include <parser-lib/parser.h>
+#include <sqlite3.h>
+
+enum
+{
+    EXIT_OK,
+    EXIT_ERROR,
+    EXIT_FATAL,
+};
+
+
+/* --stats stages, registered by ingest_init () */
+extern int g_stage_read;
+extern int g_stage_stat;
+
+void ingest_init (void);
+int  ingest_file (sqlite3 *db, char *filepath, parsed_t *invoice, const file_stat_t *stat);
+int  ingest_remove (sqlite3 *db, char *filepath, int is_directory, char seperator);
+int  ingest_finish (sqlite3 *db);
+
+
+#endif /* header guard */
+/* end of file */
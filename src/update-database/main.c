@@ -2,53 +2,125 @@
 #include <assert.h>
 #include "cli-interface.h"
 #include <database-lib/database.h>
+#include "ingest.h"
 #include <logging-lib/logging.h>
 #include <myfileio-lib/myfileio.h>
 #include <mystring-lib/mystring.h>
-#include "parser.h"
+#include <parser-lib/parser.h>
+#include "pipeline.h"
 #include "settings.h"
+#include <stats-lib/stats.h>
+#include <stats-lib/trace.h>
 #include <stdlib.h>
-
-enum
-{
-    EXIT_OK,
-    EXIT_ERROR,
-    EXIT_FATAL,
-};
+#include "watch.h"
 
 static int main_init (sqlite3 **pdb);
 static void main_quit (sqlite3 *db);
 static int update_database (sqlite3 *db, FILE *input);
 
-static int bad_date (int year, int month, int day);
-static int update_database_with_file (sqlite3 *db, char *filepath, char *name, 
-                                      int year, int month, int day);
-
 int
 main (int argc, char **argv)
 {
     int exitcode = EXIT_OK;
     sqlite3 *db = NULL;
 
+    /* load default settings, then commandline options */
+    settings_load_defaults ();
+    (void)cli_parse_arguements (argc, argv);
+
     /* initialize all modules */
-    if (main_init (&db) == EXIT_FATAL) goto main_exit;
+    if (main_init (&db) == EXIT_FATAL) 
+    {
+        exitcode = EXIT_FATAL;
+        goto main_exit;
+    }
 
-    /* load commandline options */
-    (void)cli_parse_arguements (argc, argv);
     log_debug ("logging mode: %d\n",  g_set_logging_mode);
     log_debug ("cache: %s\n",         (g_set_ignore_cached ? "enabled" : "disabled"));
     log_debug ("dryrun: %s\n",        (g_set_dryrun ? "true" : "false"));
     log_debug ("database: '%s'\n",    g_set_database);
     log_debug ("badfilelog: '%s'\n",  g_set_badfilelog);
+    log_debug ("batch size: %ld\n",   g_set_batch_size);
+    log_debug ("batch latency: %ldms\n", g_set_batch_latency);
+    log_debug ("jobs: %ld\n",         g_set_jobs);
+    log_debug ("parse cache: %ld\n",  g_set_parse_cache);
+    log_debug ("log buffer: %ld, %s when full\n", g_set_log_buffer,
+               (g_set_log_overflow == LOG_OVERFLOW_DROP ? "drop" : "block"));
+    log_debug ("matcher: %s\n",       (g_set_matcher == PARSER_MATCHER_SCAN ? "scan" : "regex"));
+    log_debug ("patterns: '%s'\n",    (g_set_patterns ? g_set_patterns : "(built in)"));
+    log_debug ("trace: '%s'\n",       (g_set_trace ? g_set_trace : "(none)"));
+    for (size_t i = 0; i < g_set_scan_count; i++)
+    {
+        log_debug ("scan: '%s'\n",    g_set_scan_roots[i]);
+    }
+    for (size_t i = 0; i < g_set_watch_count; i++)
+    {
+        log_debug ("watch: '%s'\n",   g_set_watch_roots[i]);
+    }
 
     /* iterate through each file updating the database */
-    int tmp = update_database (db, stdin);
+    int tmp = EXIT_OK;
+    if ((g_set_scan_count > 0) || (g_set_watch_count > 0))
+    {
+        /* watch before scanning, so nothing changes unseen in between. a
+         * file seen by both is just written twice */
+        if (g_set_watch_count > 0)
+        {
+            tmp = watch_start (db, g_set_watch_roots, g_set_watch_count);
+        }
+        if ((g_set_scan_count > 0) && (tmp != EXIT_FATAL))
+        {
+            tmp = pipeline_scan (db, g_set_scan_roots, g_set_scan_count, 
+                                 (int)g_set_jobs);
+            if ((tmp == EXIT_FATAL) && (g_set_watch_count > 0)) watch_stop ();
+        }
+        if ((g_set_watch_count > 0) && (tmp != EXIT_FATAL))
+        {
+            if (tmp != EXIT_OK) exitcode = tmp;
+            tmp = watch_run ();
+        }
+    }
+    else if (g_set_jobs > 1)
+    {
+        tmp = pipeline_run (db, stdin, (int)g_set_jobs);
+    }
+    else
+    {
+        tmp = update_database (db, stdin);
+    }
     if (tmp != EXIT_OK) exitcode = tmp;
 
+    /* the work is done, let queued messages out ahead of the report */
+    logging_stop_async ();
+
+    if (g_set_stats) stats_report (stdout);
+    if ((g_set_stats_json != NULL) && stats_write_json (g_set_stats_json))
+    {
+        log_error ("Failed to write stats to '%s'\n", g_set_stats_json);
+        exitcode = EXIT_ERROR;
+    }
+    if ((g_set_trace != NULL) && trace_quit ())
+    {
+        log_error ("Failed to write trace to '%s'\n", g_set_trace);
+        exitcode = EXIT_ERROR;
+    }
+
+    if (g_set_parse_cache > 0)
+    {
+        size_t hits, misses;
+        parser_cache_stats (&hits, &misses);
+        log_verbose ("parse cache: %zu hits, %zu misses\n", hits, misses);
+    }
+
 main_exit:
     main_quit (db); 
     db = NULL;
 
+    free (g_set_scan_roots); 
+    g_set_scan_roots = NULL;
+    free (g_set_watch_roots); 
+    g_set_watch_roots = NULL;
+
     exit (exitcode);
 }
 
@@ -60,13 +132,33 @@ main_init (sqlite3 **pdb)
 
     assert (pdb != NULL);
 
-    /* init default settings module */ 
-    settings_load_defaults ();
+    /* time each stage with --stats */
+    stats_enable (g_set_stats || (g_set_stats_json != NULL));
+    ingest_init ();
 
     /* initialize our logging system */
     logging_init (g_set_logging_mode, g_set_badfilelog);
+    if (logging_start_async ((size_t)g_set_log_buffer, 
+                             (logging_overflow_t)g_set_log_overflow))
+    {
+        log_warning ("Failed to start async logging, logging directly\n");
+    }
+
+    /* spans are buffered per thread, and written once done */
+    if ((g_set_trace != NULL) && trace_start (g_set_trace))
+    {
+        log_error ("Failed to start tracing\n");
+        return EXIT_FATAL;
+    }
 
     /* and the local parser */ 
+    parser_set_matcher ((parser_matcher_t)g_set_matcher);
+    parser_set_cache_size ((size_t)g_set_parse_cache);
+    if ((g_set_patterns != NULL) && (parser_load_patterns (g_set_patterns) != 0))
+    {
+        log_error ("Failed to load naming conventions\n");
+        return EXIT_FATAL;
+    }
     if (parser_init () != 0)
     {
         log_error ("Failed to initialize parser\n");
@@ -81,6 +173,9 @@ main_init (sqlite3 **pdb)
         return EXIT_FATAL;
     }
 
+    /* group writes into batched transactions */
+    db_batch_init ((size_t)g_set_batch_size, (int)g_set_batch_latency);
+
     /* and to return the database we get */
     if (pdb) *pdb = db;
     return EXIT_OK;
@@ -93,6 +188,7 @@ main_quit (sqlite3 *db)
     db_quit (db); db = NULL;
     parser_quit ();
     logging_quit ();
+    stats_quit ();
 
     return;
 }
@@ -102,80 +198,38 @@ static int
 update_database (sqlite3 *db, FILE *input)
 {
     int exitcode = EXIT_OK;
+    linereader_t reader;
     char *filepath = NULL;
     parsed_t *invoice;
 
-    while ((filepath = readline (input)))
+    linereader_init (&reader, input);
+    if (g_set_null_delimited) linereader_set_delimiter (&reader, '\0');
+
+    /* the read is timed from the top of the condition */
+    uint64_t start;
+    while ((start = STATS_BEGIN (), filepath = linereader_next (&reader)))
     {
-        if (filepath == NULL) continue;
+        STATS_END (g_stage_read, start);
 
-        /* skip empty lines */
-        filepath = trim_whitespace (filepath);
+        /* skip empty lines, null delimited names are taken as is */
+        if (!g_set_null_delimited) filepath = trim_whitespace (filepath);
         if (is_empty (filepath)) continue;
 
         /* parse the line as a filepath */
         invoice = parse_path (filepath);
 
-        /* if there is an issue with the parse */
-        if ((invoice == NULL) ||
-            (bad_date (invoice->year, invoice->month, invoice->day)))
+        /* and store it */
+        if (ingest_file (db, filepath, invoice, NULL) != EXIT_OK) 
         {
-            log_error ("Skipping Bad File: '%s'\n", filepath);
-            log_file (filepath);
             exitcode = EXIT_ERROR;
-            continue;
         }
-
-        /* update the database */
-        (void)update_database_with_file (db, filepath, invoice->name, 
-                invoice->year, invoice->month, invoice->day);
     }
+    linereader_free (&reader);
 
-    return exitcode;
-}
-
+    if (ingest_finish (db) != EXIT_OK) exitcode = EXIT_ERROR;
 
-static int
-bad_date (int year, int month, int day)
-{
-    return ((year  == 0) || 
-            (month == 0) || 
-            (day   == 0));
+    return exitcode;
 }
 
 
-static int
-update_database_with_file (sqlite3 *db, char *filepath, char *name, int year, 
-                           int month, int day)
-{
-    int file_cached = db_search_by_file (db, filepath, NULL);
-    int retcode;
-
-    if ((file_cached) && (g_set_ignore_cached))
-    {
-        log_warning ("File already cached: '%s'\n", filepath);
-        return 0;
-    }
-
-    if (file_cached) 
-    {
-        log_debug ("updating cached invoice: '%s'\n", filepath);
-        retcode = db_update_by_file (db, filepath, name, year, month, 
-                                           day);
-    }
-    else
-    {
-        log_debug ("inserting new invoice: '%s'\n", filepath);
-        retcode = db_insert (db, filepath, name, year, month, 
-                                           day);
-    }
-
-    if (retcode)
-    {
-        log_verbose ("Failed to update the database: '%s'\n", filepath);
-        return 1;
-    }
-
-    return 0;
-}
-
+/* end of file */
@@ -0,0 +1,629 @@
+#include "pipeline.h"
+
+#include <arena-lib/arena.h>
+#include <database-lib/database.h>
+#include <dirwalk-lib/dirwalk.h>
+#include "ingest.h"
+#include <logging-lib/logging.h>
+#include <myfileio-lib/myfileio.h>
+#include <mystring-lib/mystring.h>
+#include <parser-lib/parser.h>
+#include <queue-lib/queue.h>
+#include "settings.h"
+#include <stats-lib/stats.h>
+#include <stats-lib/trace.h>
+#include <stdatomic.h>
+#include "statcache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+
+/* the pipeline has three stages:
+ *
+ *   reader (calling thread) -> parser pool -> writer
+ *
+ * lines are stored in a ring of slots, one per line in flight. the reader
+ * fills slots in input order and hands them to the parsers through a
+ * lock-free queue. the writer walks the ring in the same order, waiting on
+ * each slot until it is parsed, so the database sees exactly the sequence 
+ * of writes a serial run would make. */
+
+#define PIPELINE_WINDOW 4096    /* lines in flight, must be a power of two */
+
+enum
+{
+    SLOT_FREE,          /* owned by the reader */
+    SLOT_QUEUED,        /* waiting for, or owned by, a parser */
+    SLOT_PARSED,        /* waiting for the writer */
+};
+
+typedef struct
+{
+    atomic_int state;
+
+    char *filepath;     /* trimmed line, owned by the slot */
+    size_t alloc;
+
+    parsed_t parsed;
+    parsed_t *result;   /* &parsed, or NULL if the parse failed */
+} slot_t;
+
+typedef struct
+{
+    sqlite3 *db;
+    slot_t *slots;
+    queue_t *work;
+
+    atomic_int done;            /* reader has seen the end of input */
+    atomic_size_t total;        /* lines read, valid once done is set */
+
+    int exitcode;               /* written by the writer only */
+} pipeline_t;
+
+typedef struct
+{
+    pipeline_t *p;
+    parser_ctx_t *ctx;
+    thrd_t thread;
+} parser_stage_t;
+
+
+/* --scan mode: the walker threads parse what they find and hand it to the 
+ * writer directly, there is no input order to keep. files whose metadata
+ * matches what the database already holds are skipped before parsing. 
+ *
+ * files are handed over in batches. each batch has an arena the walker
+ * fills, the writer resets it once the batch is written and puts it back
+ * in the pool for any walker to take. a walker waits for a batch when the
+ * pool is empty, which bounds the memory in flight. */
+
+#define SCAN_BATCH_FILES 256    /* files per batch */
+#define SCAN_BATCHES_PER_JOB 4  /* batches in the pool, per walker */
+
+typedef struct
+{
+    char *filepath;     /* stored right after the struct */
+    parsed_t parsed;
+    parsed_t *result;   /* &parsed, or NULL if the parse failed */
+    file_stat_t stat;
+    int has_stat;
+} scanned_t;
+
+typedef struct
+{
+    arena_t *arena;     /* the items, and their filepaths */
+    scanned_t *items[SCAN_BATCH_FILES];
+    size_t count;
+} scan_batch_t;
+
+typedef struct
+{
+    sqlite3 *db;
+    queue_t *found;             /* full batches, for the writer */
+    queue_t *pool;              /* empty batches, for the walkers */
+    scan_batch_t *batches;      /* every batch */
+    size_t batch_count;
+    scan_batch_t **filling;     /* the batch each walker is filling */
+    parser_ctx_t **ctxs;        /* one per walker thread */
+    statcache_t *cache;         /* NULL when every file is re-parsed */
+    size_t high_water;          /* most bytes one batch used, writer only */
+
+    atomic_size_t new_files;
+    atomic_size_t changed_files;
+    atomic_size_t skipped_files;
+
+    int exitcode;               /* written by the writer only */
+} scan_t;
+
+
+static int parser_thread (void *arg);
+static int writer_thread (void *arg);
+static int slot_store (slot_t *slot, const char *line, size_t length);
+
+static int scan_on_file (const dirwalk_entry_t *entry, int worker, void *user);
+static int scan_writer_thread (void *arg);
+
+
+int
+pipeline_run (sqlite3 *db, FILE *input, int jobs)
+{
+    int exitcode = EXIT_OK;
+    pipeline_t p = { 0 };
+
+    thrd_t writer;
+    parser_stage_t *parsers = NULL;
+    int parser_count = 0;
+    int writer_started = 0;
+
+    linereader_t reader;
+    char *line = NULL;
+    size_t length = 0;
+    size_t seq = 0;
+
+    linereader_init (&reader, input);
+    if (g_set_null_delimited) linereader_set_delimiter (&reader, '\0');
+
+    p.db = db;
+    p.exitcode = EXIT_OK;
+    atomic_init (&p.done, 0);
+    atomic_init (&p.total, 0);
+
+    p.slots = calloc (PIPELINE_WINDOW, sizeof (slot_t));
+    p.work  = queue_create (PIPELINE_WINDOW);
+    parsers = calloc ((size_t)jobs, sizeof (parser_stage_t));
+    if ((p.slots == NULL) || (p.work == NULL) || (parsers == NULL))
+    {
+        log_error ("Failed to allocate the ingest pipeline\n");
+        exitcode = EXIT_FATAL;
+        goto pipeline_run_exit;
+    }
+
+    for (size_t i = 0; i < PIPELINE_WINDOW; i++)
+    {
+        atomic_init (&p.slots[i].state, SLOT_FREE);
+    }
+
+    /* each parser gets a context of its own */
+    for (int i = 0; i < jobs; i++)
+    {
+        parsers[i].p = &p;
+        parsers[i].ctx = parser_ctx_create ();
+        if (parsers[i].ctx == NULL)
+        {
+            log_error ("Failed to create parser context %d\n", i);
+            exitcode = EXIT_FATAL;
+            goto pipeline_run_exit;
+        }
+    }
+
+    /* start the writer and parser stages */
+    if (thrd_create (&writer, writer_thread, &p) != thrd_success)
+    {
+        log_error ("Failed to start the writer thread\n");
+        exitcode = EXIT_FATAL;
+        goto pipeline_run_exit;
+    }
+    writer_started = 1;
+
+    for (; parser_count < jobs; parser_count++)
+    {
+        if (thrd_create (&parsers[parser_count].thread, parser_thread, 
+                         &parsers[parser_count]) != thrd_success)
+        {
+            log_error ("Failed to start parser thread %d\n", parser_count);
+            break;
+        }
+    }
+    if (parser_count == 0) 
+    {
+        exitcode = EXIT_FATAL;
+        goto pipeline_run_stop;
+    }
+
+    log_verbose ("ingest pipeline running with %d parser threads\n", 
+                 parser_count);
+
+    /* reader stage, the read is timed from the top of the condition */
+    uint64_t start;
+    while ((start = STATS_BEGIN (), 
+            line = linereader_next_n (&reader, &length)))
+    {
+        unsigned spins = 0;
+        slot_t *slot = &p.slots[seq & (PIPELINE_WINDOW - 1)];
+
+        STATS_END (g_stage_read, start);
+
+        /* skip empty lines, null delimited names are taken as is */
+        if (!g_set_null_delimited)
+        {
+            line = trim_whitespace (line);
+            length = strlen (line);
+        }
+        if (is_empty (line)) continue;
+
+        /* wait for the writer to hand the slot back */
+        start = TRACE_BEGIN ();
+        while (atomic_load_explicit (&slot->state, memory_order_acquire) 
+                != SLOT_FREE)
+        {
+            queue_backoff (&spins);
+        }
+        if (spins) TRACE_END ("wait", "reader slot", start);
+
+        if (slot_store (slot, line, length))
+        {
+            log_error ("Failed to buffer line: '%s'\n", line);
+            exitcode = EXIT_ERROR;
+            continue;
+        }
+
+        atomic_store_explicit (&slot->state, SLOT_QUEUED, memory_order_relaxed);
+        queue_push (p.work, slot);
+        seq++;
+    }
+
+pipeline_run_stop:
+    /* tell the writer how many lines to expect */
+    atomic_store_explicit (&p.total, seq, memory_order_relaxed);
+    atomic_store_explicit (&p.done, 1, memory_order_release);
+
+    /* one stop marker per parser */
+    for (int i = 0; i < parser_count; i++) queue_push (p.work, NULL);
+    for (int i = 0; i < parser_count; i++) 
+    {
+        (void)thrd_join (parsers[i].thread, NULL);
+    }
+    if (writer_started) (void)thrd_join (writer, NULL);
+
+    if (p.exitcode != EXIT_OK) exitcode = p.exitcode;
+
+pipeline_run_exit:
+    linereader_free (&reader);
+    if (p.slots)
+    {
+        for (size_t i = 0; i < PIPELINE_WINDOW; i++) free (p.slots[i].filepath);
+    }
+    if (parsers)
+    {
+        for (int i = 0; i < jobs; i++) parser_ctx_destroy (parsers[i].ctx);
+    }
+    free (p.slots);     p.slots = NULL;
+    queue_destroy (p.work); p.work = NULL;
+    free (parsers);     parsers = NULL;
+
+    return exitcode;
+}
+
+
+static int
+slot_store (slot_t *slot, const char *line, size_t length)
+{
+    char *tmp = NULL;
+
+    if (length + 1 > slot->alloc)
+    {
+        tmp = realloc (slot->filepath, length + 1);
+        if (tmp == NULL) return 1;
+
+        slot->filepath = tmp;
+        slot->alloc = length + 1;
+    }
+
+    memcpy (slot->filepath, line, length + 1);
+
+    return 0;
+}
+
+
+static int
+parser_thread (void *arg)
+{
+    parser_stage_t *stage = arg;
+    slot_t *slot = NULL;
+    parsed_t *parsed = NULL;
+    uint64_t start;
+
+    trace_thread_name ("parser");
+
+    while ((start = TRACE_BEGIN (), 
+            slot = queue_pop (stage->p->work)) != NULL)
+    {
+        TRACE_END ("wait", "parser queue", start);
+
+        parsed = parser_ctx_parse (stage->ctx, slot->filepath);
+
+        slot->result = NULL;
+        if (parsed)
+        {
+            parsed_copy (&slot->parsed, parsed);
+            slot->result = &slot->parsed;
+        }
+
+        atomic_store_explicit (&slot->state, SLOT_PARSED, memory_order_release);
+    }
+
+    return 0;
+}
+
+
+static int
+writer_thread (void *arg)
+{
+    pipeline_t *p = arg;
+    size_t seq = 0;
+
+    trace_thread_name ("writer");
+
+    for (;; seq++)
+    {
+        unsigned spins = 0;
+        slot_t *slot = &p->slots[seq & (PIPELINE_WINDOW - 1)];
+        uint64_t start = TRACE_BEGIN ();
+
+        /* wait for the next line in input order */
+        while (atomic_load_explicit (&slot->state, memory_order_acquire) 
+                != SLOT_PARSED)
+        {
+            if (atomic_load_explicit (&p->done, memory_order_acquire) &&
+                (seq >= atomic_load_explicit (&p->total, memory_order_relaxed)))
+            {
+                goto writer_thread_exit;
+            }
+
+            /* keep the batch latency promise while the input is idle */
+            (void)db_batch_poll (p->db);
+            queue_backoff (&spins);
+        }
+        if (spins) TRACE_END ("wait", "writer slot", start);
+
+        if (ingest_file (p->db, slot->filepath, slot->result, NULL) != EXIT_OK)
+        {
+            p->exitcode = EXIT_ERROR;
+        }
+
+        atomic_store_explicit (&slot->state, SLOT_FREE, memory_order_release);
+    }
+
+writer_thread_exit:
+    if (ingest_finish (p->db) != EXIT_OK) p->exitcode = EXIT_ERROR;
+
+    return 0;
+}
+
+
+int
+pipeline_scan (sqlite3 *db, char **roots, size_t n, int jobs)
+{
+    int exitcode = EXIT_OK;
+    scan_t scan = { 0 };
+    thrd_t writer;
+
+    if (jobs < 1) jobs = 1;
+
+    scan.db = db;
+    scan.exitcode = EXIT_OK;
+    scan.batch_count = (size_t)jobs * SCAN_BATCHES_PER_JOB;
+    /* room for every batch and the stop marker */
+    scan.found = queue_create (scan.batch_count + 1);
+    scan.pool = queue_create (scan.batch_count);
+    scan.batches = calloc (scan.batch_count, sizeof (scan_batch_t));
+    scan.filling = calloc ((size_t)jobs, sizeof (scan_batch_t *));
+    scan.ctxs = calloc ((size_t)jobs, sizeof (parser_ctx_t *));
+    if ((scan.found == NULL) || (scan.pool == NULL) || 
+        (scan.batches == NULL) || (scan.filling == NULL) || 
+        (scan.ctxs == NULL))
+    {
+        log_error ("Failed to allocate the scan pipeline\n");
+        exitcode = EXIT_FATAL;
+        goto pipeline_scan_exit;
+    }
+
+    for (size_t i = 0; i < scan.batch_count; i++)
+    {
+        scan.batches[i].arena = arena_create (0);
+        if (scan.batches[i].arena == NULL)
+        {
+            log_error ("Failed to allocate the scan pipeline\n");
+            exitcode = EXIT_FATAL;
+            goto pipeline_scan_exit;
+        }
+        queue_push (scan.pool, &scan.batches[i]);
+    }
+
+    for (int i = 0; i < jobs; i++)
+    {
+        scan.ctxs[i] = parser_ctx_create ();
+        if (scan.ctxs[i] == NULL)
+        {
+            log_error ("Failed to create parser context %d\n", i);
+            exitcode = EXIT_FATAL;
+            goto pipeline_scan_exit;
+        }
+    }
+
+    /* with the cache disabled every file is parsed and written again */
+    if (g_set_ignore_cached)
+    {
+        scan.cache = statcache_load (db);
+        if (scan.cache == NULL)
+        {
+            exitcode = EXIT_FATAL;
+            goto pipeline_scan_exit;
+        }
+    }
+
+    if (thrd_create (&writer, scan_writer_thread, &scan) != thrd_success)
+    {
+        log_error ("Failed to start the writer thread\n");
+        exitcode = EXIT_FATAL;
+        goto pipeline_scan_exit;
+    }
+
+    log_verbose ("scanning with %d walker threads\n", jobs);
+    if (dirwalk_run (roots, n, jobs, scan_on_file, &scan))
+    {
+        log_error ("Failed to scan every directory\n");
+        exitcode = EXIT_ERROR;
+    }
+
+    /* the walkers are done, hand over what they were still filling */
+    for (int i = 0; i < jobs; i++)
+    {
+        if (scan.filling[i] != NULL) queue_push (scan.found, scan.filling[i]);
+        scan.filling[i] = NULL;
+    }
+
+    /* stop marker for the writer */
+    queue_push (scan.found, NULL);
+    (void)thrd_join (writer, NULL);
+
+    if (scan.exitcode != EXIT_OK) exitcode = scan.exitcode;
+
+    log_info ("%zu new, %zu changed, %zu skipped files\n",
+              atomic_load (&scan.new_files), 
+              atomic_load (&scan.changed_files),
+              atomic_load (&scan.skipped_files));
+    log_verbose ("%zu batches of %d files, at most %zu KiB each\n",
+                 scan.batch_count, SCAN_BATCH_FILES, scan.high_water / 1024);
+
+pipeline_scan_exit:
+    if (scan.ctxs)
+    {
+        for (int i = 0; i < jobs; i++) parser_ctx_destroy (scan.ctxs[i]);
+    }
+    if (scan.batches)
+    {
+        for (size_t i = 0; i < scan.batch_count; i++) 
+        {
+            arena_destroy (scan.batches[i].arena);
+        }
+    }
+    free (scan.ctxs);           scan.ctxs = NULL;
+    free (scan.filling);        scan.filling = NULL;
+    free (scan.batches);        scan.batches = NULL;
+    queue_destroy (scan.pool);  scan.pool = NULL;
+    queue_destroy (scan.found); scan.found = NULL;
+    statcache_free (scan.cache); scan.cache = NULL;
+
+    return exitcode;
+}
+
+
+static int
+scan_on_file (const dirwalk_entry_t *entry, int worker, void *user)
+{
+    scan_t *scan = user;
+    scan_batch_t *batch = NULL;
+    scanned_t *item = NULL;
+    parsed_t *parsed = NULL;
+    /* zeroed, so a failed stat leaves nothing indeterminate behind */
+    dirwalk_stat_t st = { 0 };
+    file_stat_t stat;
+    uint64_t start = STATS_BEGIN ();
+    int has_stat = (dirwalk_stat (entry, &st) == 0);
+
+    STATS_END (g_stage_stat, start);
+
+    stat.dev   = st.dev;
+    stat.ino   = st.ino;
+    stat.size  = st.size;
+    stat.mtime = st.mtime;
+
+    if (scan->cache == NULL)
+    {
+        atomic_fetch_add (&scan->new_files, 1);
+    }
+    else switch (statcache_check (scan->cache, entry->path, 
+                                  (has_stat ? &stat : NULL)))
+    {
+    case STATCACHE_SAME:
+        /* nothing to parse or write */
+        atomic_fetch_add (&scan->skipped_files, 1);
+        return 0;
+
+    case STATCACHE_CHANGED:
+        atomic_fetch_add (&scan->changed_files, 1);
+        break;
+
+    case STATCACHE_NEW:
+    default:
+        atomic_fetch_add (&scan->new_files, 1);
+        break;
+    }
+
+    /* wait for an empty batch if there are none to fill */
+    batch = scan->filling[worker];
+    if (batch == NULL)
+    {
+        uint64_t wait = TRACE_BEGIN ();
+        batch = scan->filling[worker] = queue_pop (scan->pool);
+        TRACE_END ("wait", "scan batch", wait);
+    }
+
+    item = arena_alloc (batch->arena, sizeof (scanned_t) + entry->path_len + 1);
+    if (item == NULL)
+    {
+        log_error ("out of memory at '%s'\n", entry->path);
+        return 1;
+    }
+
+    item->filepath = (char *)(item + 1);
+    memcpy (item->filepath, entry->path, entry->path_len + 1);
+    item->stat = stat;
+    item->has_stat = has_stat;
+
+    parsed = parser_ctx_parse (scan->ctxs[worker], item->filepath);
+
+    item->result = NULL;
+    if (parsed)
+    {
+        parsed_copy (&item->parsed, parsed);
+        item->result = &item->parsed;
+    }
+
+    batch->items[batch->count++] = item;
+    if (batch->count == SCAN_BATCH_FILES)
+    {
+        queue_push (scan->found, batch);
+        scan->filling[worker] = NULL;
+    }
+
+    return 0;
+}
+
+
+static int
+scan_writer_thread (void *arg)
+{
+    scan_t *scan = arg;
+    scan_batch_t *batch = NULL;
+    unsigned spins = 0;
+    uint64_t start = TRACE_BEGIN ();
+
+    trace_thread_name ("writer");
+
+    for (;;)
+    {
+        if (queue_try_pop (scan->found, (void **)&batch))
+        {
+            /* keep the batch latency promise while the walkers are busy */
+            (void)db_batch_poll (scan->db);
+            queue_backoff (&spins);
+            continue;
+        }
+
+        if (spins) TRACE_END ("wait", "writer queue", start);
+        spins = 0;
+        if (batch == NULL) break;   /* stop marker */
+
+        for (size_t i = 0; i < batch->count; i++)
+        {
+            scanned_t *item = batch->items[i];
+
+            if (ingest_file (scan->db, item->filepath, item->result, 
+                             (item->has_stat ? &item->stat : NULL)) != EXIT_OK)
+            {
+                scan->exitcode = EXIT_ERROR;
+            }
+        }
+
+        /* back to the pool, empty */
+        if (arena_high_water (batch->arena) > scan->high_water)
+        {
+            scan->high_water = arena_high_water (batch->arena);
+        }
+        arena_reset (batch->arena);
+        batch->count = 0;
+        queue_push (scan->pool, batch);
+
+        start = TRACE_BEGIN ();
+    }
+
+    if (ingest_finish (scan->db) != EXIT_OK) scan->exitcode = EXIT_ERROR;
+
+    return 0;
+}
+
+
+/* end of file */
@@ -0,0 +1,14 @@
+#ifndef INVOICE_UPDATE_PIPELINE_HEADER
+#define INVOICE_UPDATE_PIPELINE_HEADER
+
+#include <sqlite3.h>
+#include <stddef.h>
+#include <stdio.h>
+
+
+int pipeline_run (sqlite3 *db, FILE *input, int jobs);
+int pipeline_scan (sqlite3 *db, char **roots, size_t n, int jobs);
+
+
+#endif /* header guard */
+/* end of file */
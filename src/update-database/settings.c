@@ -1,6 +1,7 @@
 #include "settings.h"
 
 #include <logging-lib/logging.h>
+#include <parser-lib/parser.h>
 #include "config.h"
 
 
@@ -8,9 +9,28 @@
 int g_set_logging_mode;
 int g_set_ignore_cached;
 int g_set_dryrun;
+int g_set_null_delimited;
+int g_set_matcher;
+int g_set_log_overflow;
+int g_set_stats;
 
 char *g_set_database;
 char *g_set_badfilelog;
+char *g_set_patterns;
+char *g_set_stats_json;
+char *g_set_trace;
+
+long g_set_batch_size;
+long g_set_batch_latency;
+long g_set_jobs;
+long g_set_parse_cache;
+long g_set_log_buffer;
+
+char **g_set_scan_roots;
+size_t g_set_scan_count;
+
+char **g_set_watch_roots;
+size_t g_set_watch_count;
 
 
 void
@@ -19,8 +39,24 @@ settings_load_defaults (void)
     g_set_logging_mode  = DEFAULT_LOGGING_MODE;
     g_set_ignore_cached = DEFAULT_IGNORE_CACHED;
     g_set_dryrun        = DEFAULT_DRYRUN;
+    g_set_null_delimited = DEFAULT_NULL_DELIMITED;
+    g_set_matcher       = DEFAULT_MATCHER;
+    g_set_log_overflow  = DEFAULT_LOG_OVERFLOW;
+    g_set_stats         = DEFAULT_STATS;
     g_set_database      = DEFAULT_DATABASE;
     g_set_badfilelog    = DEFAULT_BADFILELOG;
+    g_set_patterns      = DEFAULT_PATTERNS;
+    g_set_stats_json    = DEFAULT_STATS_JSON;
+    g_set_trace         = DEFAULT_TRACE;
+    g_set_batch_size    = DEFAULT_BATCH_SIZE;
+    g_set_batch_latency = DEFAULT_BATCH_LATENCY;
+    g_set_jobs          = DEFAULT_JOBS;
+    g_set_parse_cache   = DEFAULT_PARSE_CACHE;
+    g_set_log_buffer    = DEFAULT_LOG_BUFFER;
+    g_set_scan_roots    = NULL;
+    g_set_scan_count    = 0;
+    g_set_watch_roots   = NULL;
+    g_set_watch_count   = 0;
 
     return;
 }
\ No newline at end of file
@@ -1,13 +1,34 @@
 #ifndef INVOICE_UPDATE_SETTINGS_HEADER
 #define INVOICE_UPDATE_SETTINGS_HEADER
 
+#include <stddef.h>
+
 
 extern int g_set_logging_mode;
 extern int g_set_ignore_cached;
 extern int g_set_dryrun;
+extern int g_set_null_delimited;
+extern int g_set_matcher;
+extern int g_set_log_overflow;
+extern int g_set_stats;
 
 extern char *g_set_database;
 extern char *g_set_badfilelog;
+extern char *g_set_patterns;
+extern char *g_set_stats_json;
+extern char *g_set_trace;
+
+extern long g_set_batch_size;
+extern long g_set_batch_latency;
+extern long g_set_jobs;
+extern long g_set_parse_cache;
+extern long g_set_log_buffer;
+
+extern char **g_set_scan_roots;
+extern size_t g_set_scan_count;
+
+extern char **g_set_watch_roots;
+extern size_t g_set_watch_count;
 
 
 void settings_load_defaults (void);
@@ -0,0 +1,201 @@
+#include "statcache.h"
+
+#include <arena-lib/arena.h>
+#include <logging-lib/logging.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* a snapshot of the file metadata stored in the database, taken before a
+ * scan. an open addressing hash table keyed on the filepath. */
+typedef struct
+{
+    uint64_t hash;
+    char *filepath;         /* in the arena, NULL marks an empty bucket */
+    file_stat_t stat;
+    int has_stat;
+} statcache_entry_t;
+
+struct statcache
+{
+    statcache_entry_t *buckets;
+    size_t capacity;        /* always a power of two */
+    size_t count;
+    arena_t *arena;         /* every filepath, freed together */
+};
+
+
+static uint64_t hash_path (const char *filepath);
+static int insert_entry (statcache_t *cache, const char *filepath,
+                         const file_stat_t *stat);
+static int load_callback (const char *filepath, const file_stat_t *stat,
+                          void *user);
+static int grow (statcache_t *cache);
+
+
+statcache_t *
+statcache_load (sqlite3 *db)
+{
+    statcache_t *cache = calloc (1, sizeof (statcache_t));
+    if (cache == NULL) goto statcache_load_error;
+
+    cache->capacity = 1024;
+    cache->buckets = calloc (cache->capacity, sizeof (statcache_entry_t));
+    cache->arena = arena_create (0);
+    if ((cache->buckets == NULL) || (cache->arena == NULL)) 
+    {
+        goto statcache_load_error;
+    }
+
+    if (db_foreach_file_stat (db, load_callback, cache))
+    {
+        goto statcache_load_error;
+    }
+
+    log_verbose ("loaded metadata for %zu cached files, %zu KiB of paths\n", 
+                 cache->count, arena_high_water (cache->arena) / 1024);
+    return cache;
+
+statcache_load_error:
+    log_error ("Failed to load cached file metadata\n");
+    statcache_free (cache);
+    return NULL;
+}
+
+
+void
+statcache_free (statcache_t *cache)
+{
+    if (cache == NULL) return;
+
+    arena_destroy (cache->arena);
+    free (cache->buckets);
+    free (cache);
+}
+
+
+statcache_result_t
+statcache_check (const statcache_t *cache, const char *filepath,
+                 const file_stat_t *stat)
+{
+    uint64_t hash = hash_path (filepath);
+    size_t mask = cache->capacity - 1;
+    const statcache_entry_t *entry = NULL;
+
+    for (size_t i = (size_t)hash & mask; ; i = (i + 1) & mask)
+    {
+        entry = &cache->buckets[i];
+
+        if (entry->filepath == NULL) return STATCACHE_NEW;
+        if ((entry->hash == hash) && (strcmp (entry->filepath, filepath) == 0))
+        {
+            break;
+        }
+    }
+
+    if ((stat == NULL) || (!entry->has_stat)) return STATCACHE_CHANGED;
+
+    if ((entry->stat.dev   != stat->dev)  ||
+        (entry->stat.ino   != stat->ino)  ||
+        (entry->stat.size  != stat->size) ||
+        (entry->stat.mtime != stat->mtime))
+    {
+        return STATCACHE_CHANGED;
+    }
+
+    return STATCACHE_SAME;
+}
+
+
+static int
+load_callback (const char *filepath, const file_stat_t *stat, void *user)
+{
+    return insert_entry (user, filepath, stat);
+}
+
+
+static int
+insert_entry (statcache_t *cache, const char *filepath, const file_stat_t *stat)
+{
+    uint64_t hash = hash_path (filepath);
+    size_t length = strlen (filepath);
+    size_t mask;
+    statcache_entry_t *entry = NULL;
+
+    /* keep the load factor under 3/4 */
+    if ((cache->count + 1) * 4 > cache->capacity * 3)
+    {
+        if (grow (cache)) return 1;
+    }
+    mask = cache->capacity - 1;
+
+    for (size_t i = (size_t)hash & mask; ; i = (i + 1) & mask)
+    {
+        entry = &cache->buckets[i];
+        if (entry->filepath == NULL) break;
+
+        /* filepath is unique in the table, but be safe */
+        if ((entry->hash == hash) && (strcmp (entry->filepath, filepath) == 0))
+        {
+            return 0;
+        }
+    }
+
+    entry->filepath = arena_strndup (cache->arena, filepath, length);
+    if (entry->filepath == NULL) return 1;
+
+    entry->hash = hash;
+    entry->has_stat = (stat != NULL);
+    if (stat) entry->stat = *stat;
+
+    cache->count++;
+    return 0;
+}
+
+
+static int
+grow (statcache_t *cache)
+{
+    size_t capacity = cache->capacity * 2;
+    size_t mask = capacity - 1;
+    statcache_entry_t *buckets = calloc (capacity, sizeof (statcache_entry_t));
+    if (buckets == NULL) return 1;
+
+    for (size_t i = 0; i < cache->capacity; i++)
+    {
+        statcache_entry_t *old = &cache->buckets[i];
+        size_t j;
+
+        if (old->filepath == NULL) continue;
+
+        for (j = (size_t)old->hash & mask; buckets[j].filepath; j = (j + 1) & mask)
+            ;
+        buckets[j] = *old;
+    }
+
+    free (cache->buckets);
+    cache->buckets = buckets;
+    cache->capacity = capacity;
+
+    return 0;
+}
+
+
+/* FNV-1a */
+static uint64_t
+hash_path (const char *filepath)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (const unsigned char *p = (const unsigned char *)filepath; *p; p++)
+    {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+/* end of file */
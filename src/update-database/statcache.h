@@ -0,0 +1,28 @@
+#ifndef INVOICE_UPDATE_STATCACHE_HEADER
+#define INVOICE_UPDATE_STATCACHE_HEADER
+
+#include <database-lib/database.h>
+#include <sqlite3.h>
+
+typedef struct statcache statcache_t;
+
+typedef enum
+{
+    STATCACHE_NEW,          /* no row for this file */
+    STATCACHE_CHANGED,      /* row exists, but the metadata differs */
+    STATCACHE_SAME,         /* row exists with identical metadata */
+} statcache_result_t;
+
+
+statcache_t *statcache_load (sqlite3 *db);
+void statcache_free (statcache_t *cache);
+
+/* safe to call from many threads at once, the cache is never modified
+ * after it is loaded */
+statcache_result_t statcache_check (const statcache_t *cache,
+                                    const char *filepath,
+                                    const file_stat_t *stat);
+
+
+#endif /* header guard */
+/* end of file */
@@ -0,0 +1,624 @@
+#include "watch.h"
+
+#include "ingest.h"
+#include <logging-lib/logging.h>
+
+
+#if defined(__linux__)
+
+#include <database-lib/database.h>
+#include <date-lib/date.h>
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <parser-lib/parser.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/* --watch mode: keep the database open and follow changes to the watched
+ * trees through inotify.
+ *
+ * events are not written as they arrive. the paths they name are collected
+ * and written together once the tree has been quiet for WATCH_QUIET_MS, or
+ * the oldest of them has waited WATCH_MAX_DELAY_MS. a file that is created,
+ * written and renamed in one burst is then only parsed once. each path is
+ * stat'ed when it is written, so only its final state matters.
+ *
+ * watch_start() installs the watches and watch_run() follows them, so a
+ * --scan run in between misses nothing: whatever changes during the scan
+ * is queued by the kernel and written again once the loop starts. */
+
+#define WATCH_QUIET_MS      100
+#define WATCH_MAX_DELAY_MS  500
+
+#define WATCH_DIR_MASK  (IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | \
+                         IN_MOVED_FROM | IN_MOVED_TO | \
+                         IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+typedef struct
+{
+    char *path;
+    int remove_tree;    /* everything under path is gone */
+} pending_t;
+
+typedef struct
+{
+    sqlite3 *db;
+    int fd;
+
+    char **dirs;        /* watched directory, indexed by watch descriptor */
+    size_t dirs_alloc;
+    size_t dirs_count;
+
+    pending_t *pending;
+    size_t pending_alloc;
+    size_t pending_count;
+
+    int exitcode;
+} watch_t;
+
+
+static watch_t s_watch;
+static volatile sig_atomic_t s_stop;
+
+
+static void on_signal (int signum);
+static long long now_ms (void);
+
+static int  add_tree (watch_t *w, const char *root, int queue_files);
+static int  add_directory (watch_t *w, const char *path);
+static void forget_tree (watch_t *w, const char *path);
+static void handle_event (watch_t *w, const struct inotify_event *event);
+
+static int  queue_path (watch_t *w, const char *path, int remove_tree);
+static void flush_pending (watch_t *w);
+static int  compare_pending (const void *a, const void *b);
+static char *join_path (const char *dir, const char *name);
+
+
+int
+watch_start (sqlite3 *db, char **roots, size_t n)
+{
+    watch_t *w = &s_watch;
+
+    memset (w, 0, sizeof (*w));
+    w->db = db;
+    w->exitcode = EXIT_OK;
+    w->fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    if (w->fd < 0)
+    {
+        log_error ("Failed to initialize inotify: %s\n", strerror (errno));
+        return EXIT_FATAL;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (add_tree (w, roots[i], 0))
+        {
+            log_error ("Failed to watch '%s'\n", roots[i]);
+            watch_stop ();
+            return EXIT_FATAL;
+        }
+    }
+    log_info ("watching %zu directories\n", w->dirs_count);
+
+    return EXIT_OK;
+}
+
+
+/* follow the watches set up by watch_start () until SIGINT or SIGTERM */
+int
+watch_run (void)
+{
+    watch_t *w = &s_watch;
+    struct pollfd pfd;
+    char buffer[64 * 1024]
+        __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    long long first_event = 0;
+    long long last_event = 0;
+    int exitcode;
+
+    s_stop = 0;
+    (void)signal (SIGINT, on_signal);
+    (void)signal (SIGTERM, on_signal);
+
+    pfd.fd = w->fd;
+    pfd.events = POLLIN;
+
+    while (!s_stop)
+    {
+        int timeout = -1;
+        long long now;
+        ssize_t length;
+
+        /* wake up in time for whichever flush deadline comes first */
+        if (w->pending_count > 0)
+        {
+            long long deadline = last_event + WATCH_QUIET_MS;
+            if (first_event + WATCH_MAX_DELAY_MS < deadline)
+            {
+                deadline = first_event + WATCH_MAX_DELAY_MS;
+            }
+
+            now = now_ms ();
+            timeout = (deadline > now) ? (int)(deadline - now) : 0;
+        }
+
+        if (poll (&pfd, 1, timeout) < 0)
+        {
+            if (errno == EINTR) continue;
+            log_error ("Failed to wait for events: %s\n", strerror (errno));
+            w->exitcode = EXIT_FATAL;
+            break;
+        }
+
+        /* drain everything the kernel has queued */
+        while ((length = read (w->fd, buffer, sizeof (buffer))) > 0)
+        {
+            size_t before = w->pending_count;
+
+            for (char *p = buffer; p < buffer + length; )
+            {
+                const struct inotify_event *event = (void *)p;
+                handle_event (w, event);
+                p += sizeof (struct inotify_event) + event->len;
+            }
+
+            now = now_ms ();
+            if ((before == 0) && (w->pending_count > 0)) first_event = now;
+            last_event = now;
+        }
+        if ((length < 0) && (errno != EAGAIN) && (errno != EINTR))
+        {
+            log_error ("Failed to read events: %s\n", strerror (errno));
+            w->exitcode = EXIT_FATAL;
+            break;
+        }
+
+        if (w->pending_count == 0) continue;
+
+        now = now_ms ();
+        if ((now - last_event >= WATCH_QUIET_MS) ||
+            (now - first_event >= WATCH_MAX_DELAY_MS))
+        {
+            flush_pending (w);
+        }
+    }
+
+    log_verbose ("stopped watching\n");
+    flush_pending (w);
+
+    if (ingest_finish (w->db) != EXIT_OK && w->exitcode == EXIT_OK)
+    {
+        w->exitcode = EXIT_ERROR;
+    }
+
+    exitcode = w->exitcode;
+    watch_stop ();
+
+    return exitcode;
+}
+
+
+/* drop the watches, and anything still pending, without writing it */
+void
+watch_stop (void)
+{
+    watch_t *w = &s_watch;
+
+    for (size_t i = 0; i < w->dirs_alloc; i++) free (w->dirs[i]);
+    for (size_t i = 0; i < w->pending_count; i++) free (w->pending[i].path);
+    free (w->dirs);    w->dirs = NULL;
+    free (w->pending); w->pending = NULL;
+    if (w->fd >= 0) (void)close (w->fd);
+
+    memset (w, 0, sizeof (*w));
+    w->fd = -1;
+}
+
+
+static void
+on_signal (int signum)
+{
+    (void)signum;
+    s_stop = 1;
+}
+
+
+static long long
+now_ms (void)
+{
+    struct timespec ts;
+    (void)clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+static void
+handle_event (watch_t *w, const struct inotify_event *event)
+{
+    const char *dir = NULL;
+    char *path = NULL;
+
+    if (event->mask & IN_Q_OVERFLOW)
+    {
+        log_warning ("inotify queue overflowed, some changes were missed. "
+                     "run with --scan to catch up\n");
+        return;
+    }
+
+    if ((event->wd < 0) || ((size_t)event->wd >= w->dirs_alloc)) return;
+    dir = w->dirs[event->wd];
+
+    /* the directory is gone, or was moved out from under us */
+    if (event->mask & IN_IGNORED)
+    {
+        if (dir) w->dirs_count--;
+        free (w->dirs[event->wd]);
+        w->dirs[event->wd] = NULL;
+        return;
+    }
+
+    if ((dir == NULL) || (event->len == 0)) return;
+
+    path = join_path (dir, event->name);
+    if (path == NULL)
+    {
+        log_error ("out of memory\n");
+        w->exitcode = EXIT_ERROR;
+        return;
+    }
+
+    if (event->mask & IN_ISDIR)
+    {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO))
+        {
+            /* files may land before the watch is in place, so pick up
+             * whatever is already inside */
+            (void)add_tree (w, path, 1);
+        }
+        else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+        {
+            forget_tree (w, path);
+            (void)queue_path (w, path, 1);
+        }
+    }
+    else
+    {
+        (void)queue_path (w, path, 0);
+    }
+
+    free (path);
+}
+
+
+/* watch root and every directory below it. if queue_files is set, regular
+ * files found along the way are queued for writing. */
+static int
+add_tree (watch_t *w, const char *root, int queue_files)
+{
+    char **stack = NULL;
+    size_t stack_count = 0;
+    size_t stack_alloc = 0;
+    int retcode = 0;
+    char *dir = NULL;
+
+    stack = malloc (16 * sizeof (char *));
+    if (stack == NULL) return 1;
+    stack_alloc = 16;
+
+    stack[stack_count] = join_path (root, NULL);
+    if (stack[stack_count] == NULL) { free (stack); return 1; }
+    stack_count++;
+
+    while (stack_count > 0)
+    {
+        DIR *dp = NULL;
+        struct dirent *de = NULL;
+
+        dir = stack[--stack_count];
+
+        /* watch before reading, so nothing falls between the two */
+        if (add_directory (w, dir))
+        {
+            retcode = 1;
+            free (dir);
+            continue;
+        }
+
+        dp = opendir (dir);
+        if (dp == NULL)
+        {
+            log_warning ("Failed to open directory '%s': %s\n",
+                         dir, strerror (errno));
+            free (dir);
+            continue;
+        }
+
+        while ((de = readdir (dp)) != NULL)
+        {
+            struct stat st;
+            char *path = NULL;
+
+            if ((strcmp (de->d_name, ".") == 0) ||
+                (strcmp (de->d_name, "..") == 0))
+            {
+                continue;
+            }
+
+            path = join_path (dir, de->d_name);
+            if (path == NULL) { retcode = 1; break; }
+
+            if (lstat (path, &st) != 0)
+            {
+                free (path);
+                continue;
+            }
+
+            if (S_ISDIR (st.st_mode))
+            {
+                if (stack_count == stack_alloc)
+                {
+                    char **tmp = realloc (stack, stack_alloc * 2 * sizeof (char *));
+                    if (tmp == NULL) { free (path); retcode = 1; break; }
+                    stack = tmp;
+                    stack_alloc *= 2;
+                }
+                stack[stack_count++] = path;
+                continue;
+            }
+
+            if (queue_files && S_ISREG (st.st_mode)) (void)queue_path (w, path, 0);
+            free (path);
+        }
+
+        (void)closedir (dp);
+        free (dir);
+    }
+
+    while (stack_count > 0) free (stack[--stack_count]);
+    free (stack);
+
+    return retcode;
+}
+
+
+static int
+add_directory (watch_t *w, const char *path)
+{
+    int wd = inotify_add_watch (w->fd, path, WATCH_DIR_MASK);
+    char *copy = NULL;
+
+    if (wd < 0)
+    {
+        log_error ("Failed to watch '%s': %s\n", path, strerror (errno));
+        if (errno == ENOSPC)
+        {
+            log_error ("raise fs.inotify.max_user_watches to watch more "
+                       "directories\n");
+        }
+        return 1;
+    }
+
+    if ((size_t)wd >= w->dirs_alloc)
+    {
+        size_t alloc = (w->dirs_alloc ? w->dirs_alloc : 64);
+        char **tmp = NULL;
+
+        while (alloc <= (size_t)wd) alloc *= 2;
+
+        tmp = realloc (w->dirs, alloc * sizeof (char *));
+        if (tmp == NULL) return 1;
+        memset (tmp + w->dirs_alloc, 0, (alloc - w->dirs_alloc) * sizeof (char *));
+
+        w->dirs = tmp;
+        w->dirs_alloc = alloc;
+    }
+
+    copy = join_path (path, NULL);
+    if (copy == NULL) return 1;
+
+    /* a directory moved within the tree keeps its watch descriptor */
+    if (w->dirs[wd] == NULL) w->dirs_count++;
+    free (w->dirs[wd]);
+    w->dirs[wd] = copy;
+
+    return 0;
+}
+
+
+/* stop watching a directory that was moved away. its watches would
+ * otherwise report events under the old path. */
+static void
+forget_tree (watch_t *w, const char *path)
+{
+    size_t length = strlen (path);
+
+    for (size_t wd = 0; wd < w->dirs_alloc; wd++)
+    {
+        const char *dir = w->dirs[wd];
+        if (dir == NULL) continue;
+
+        if ((strncmp (dir, path, length) == 0) &&
+            ((dir[length] == '\0') || (dir[length] == '/')))
+        {
+            /* the IN_IGNORED event that follows clears the entry */
+            (void)inotify_rm_watch (w->fd, (int)wd);
+        }
+    }
+}
+
+
+static int
+queue_path (watch_t *w, const char *path, int remove_tree)
+{
+    pending_t *entry = NULL;
+    size_t length = strlen (path);
+
+    if (w->pending_count == w->pending_alloc)
+    {
+        size_t alloc = (w->pending_alloc ? w->pending_alloc * 2 : 256);
+        pending_t *tmp = realloc (w->pending, alloc * sizeof (pending_t));
+        if (tmp == NULL)
+        {
+            log_error ("out of memory\n");
+            return 1;
+        }
+
+        w->pending = tmp;
+        w->pending_alloc = alloc;
+    }
+
+    entry = &w->pending[w->pending_count];
+    entry->path = malloc (length + 1);
+    if (entry->path == NULL)
+    {
+        log_error ("out of memory\n");
+        return 1;
+    }
+    memcpy (entry->path, path, length + 1);
+    entry->remove_tree = remove_tree;
+
+    w->pending_count++;
+    return 0;
+}
+
+
+/* write every pending path in one transaction */
+static void
+flush_pending (watch_t *w)
+{
+    size_t written = 0;
+
+    if (w->pending_count == 0) return;
+
+    /* running across midnight makes the new day's invoices valid */
+    if (date_refresh_today ()) log_verbose ("the date changed\n");
+
+    /* sorting puts duplicates side by side, and a removed directory ahead
+     * of anything that has since been created inside it */
+    qsort (w->pending, w->pending_count, sizeof (pending_t), compare_pending);
+
+    for (size_t i = 0; i < w->pending_count; i++)
+    {
+        pending_t *entry = &w->pending[i];
+        struct stat st;
+        int rc;
+
+        if ((i > 0) && (compare_pending (entry, entry - 1) == 0)) continue;
+        written++;
+
+        if (entry->remove_tree)
+        {
+            rc = ingest_remove (w->db, entry->path, 1, '/');
+        }
+        else if ((lstat (entry->path, &st) == 0) && S_ISREG (st.st_mode))
+        {
+            file_stat_t stat;
+
+            stat.dev   = (long long)st.st_dev;
+            stat.ino   = (long long)st.st_ino;
+            stat.size  = (long long)st.st_size;
+            stat.mtime = (long long)st.st_mtim.tv_sec * 1000000000LL
+                       + (long long)st.st_mtim.tv_nsec;
+
+            rc = ingest_file (w->db, entry->path, parse_path (entry->path),
+                              &stat);
+        }
+        else
+        {
+            /* deleted, moved away, or no longer a regular file */
+            rc = ingest_remove (w->db, entry->path, 0, '/');
+        }
+
+        if (rc != EXIT_OK) w->exitcode = EXIT_ERROR;
+    }
+
+    if (db_batch_flush (w->db)) w->exitcode = EXIT_ERROR;
+    log_verbose ("wrote %zu changed paths\n", written);
+
+    for (size_t i = 0; i < w->pending_count; i++) free (w->pending[i].path);
+    w->pending_count = 0;
+}
+
+
+static int
+compare_pending (const void *a, const void *b)
+{
+    const pending_t *lhs = a;
+    const pending_t *rhs = b;
+
+    int cmp = strcmp (lhs->path, rhs->path);
+    if (cmp != 0) return cmp;
+
+    return rhs->remove_tree - lhs->remove_tree;
+}
+
+
+/* dir + '/' + name in a new allocation, or a copy of dir if name is NULL */
+static char *
+join_path (const char *dir, const char *name)
+{
+    size_t dir_len = strlen (dir);
+    size_t name_len = (name ? strlen (name) : 0);
+    char *path = NULL;
+
+    /* dont double up on seperators */
+    while ((dir_len > 1) && (dir[dir_len - 1] == '/')) dir_len--;
+
+    path = malloc (dir_len + name_len + 2);
+    if (path == NULL) return NULL;
+
+    memcpy (path, dir, dir_len);
+    if (name)
+    {
+        if (dir[dir_len - 1] != '/') path[dir_len++] = '/';
+        memcpy (path + dir_len, name, name_len + 1);
+    }
+    else
+    {
+        path[dir_len] = '\0';
+    }
+
+    return path;
+}
+
+
+#else /* not linux */
+
+
+int
+watch_start (sqlite3 *db, char **roots, size_t n)
+{
+    (void)db;
+    (void)roots;
+    (void)n;
+
+    log_error ("--watch is not supported on this platform\n");
+    return EXIT_FATAL;
+}
+
+
+int
+watch_run (void)
+{
+    return EXIT_FATAL;
+}
+
+
+void
+watch_stop (void)
+{
+}
+
+
+#endif
+
+
+/* end of file */
@@ -0,0 +1,14 @@
+#ifndef INVOICE_UPDATE_WATCH_HEADER
+#define INVOICE_UPDATE_WATCH_HEADER
+
+#include <sqlite3.h>
+#include <stddef.h>
+
+
+int  watch_start (sqlite3 *db, char **roots, size_t n);
+int  watch_run (void);
+void watch_stop (void);
+
+
+#endif /* header guard */
+/* end of file */